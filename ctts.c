@@ -4,6 +4,7 @@
  */
 
 #define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE             /* memfd_create and file sealing on Linux */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,7 +15,31 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include <regex.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
 
 #include "ctts.h"
 
@@ -34,6 +59,17 @@ typedef struct {
 static NormRule norm_rules[MAX_NORM_RULES];
 static size_t norm_rule_count = 0;
 static int norm_rules_loaded = 0;
+static size_t norm_regex_heap_bytes = 0;   /* Heap held by compiled rules, if measurable */
+
+/* Bytes currently allocated from the heap, or 0 where the libc cannot say */
+static size_t heap_in_use(void) {
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 33)
+    return mallinfo2().uordblks;
+#endif
+#endif
+    return 0;
+}
 
 /* ============================================================================
  * Internal Constants
@@ -42,6 +78,7 @@ static int norm_rules_loaded = 0;
 #define FNV_OFFSET_BASIS    2166136261U
 #define FNV_PRIME           16777619U
 #define HASH_TABLE_LOAD     0.7
+#define DB_AUDIO_ALIGN      64      /* Audio section alignment in the database file */
 #define PI                  3.14159265358979323846
 #define OVERLAP_SAMPLES(ms) ((int)((ms) * CTTS_SAMPLE_RATE / 1000.0f))
 
@@ -155,7 +192,8 @@ static const char* error_messages[] = {
     "Invalid format",
     "Out of memory",
     "Invalid WAV file",
-    "Version mismatch"
+    "Version mismatch",
+    "Not supported on this platform"
 };
 
 const char* ctts_strerror(int error_code) {
@@ -286,6 +324,224 @@ char* ctts_normalize(const char* text) {
     return result;
 }
 
+/* Growable output text; each append is amortized O(length appended) */
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+    int failed;
+} TextBuilder;
+
+static void tb_append(TextBuilder* tb, const char* s, size_t n) {
+    if (tb->failed) return;
+    if (tb->len + n + 1 > tb->cap) {
+        size_t cap = tb->cap ? tb->cap : 64;
+        while (cap < tb->len + n + 1) cap *= 2;
+        char* grown = realloc(tb->data, cap);
+        if (!grown) {
+            tb->failed = 1;
+            return;
+        }
+        tb->data = grown;
+        tb->cap = cap;
+    }
+    memcpy(tb->data + tb->len, s, n);
+    tb->len += n;
+    tb->data[tb->len] = '\0';
+}
+
+/* ============================================================================
+ * Pronunciation Lexicon
+ * ============================================================================ */
+
+/*
+ * Whole-word corrections and abbreviations. Entries live in an open-addressing
+ * table keyed by the lowercased word, so the frontend pays one probe per token
+ * however large the lexicon grows; regex rules are left for real patterns.
+ * Keys and values share one string pool and are referenced by offset.
+ */
+
+#define LEXICON_MAX_WORD  64
+#define LEXICON_MIN_SLOTS 256
+
+typedef struct {
+    uint32_t hash;
+    uint32_t key_offset;
+    uint32_t value_offset;
+    uint16_t key_len;       /* 0 marks an empty slot */
+    uint16_t value_len;
+} LexiconEntry;
+
+static LexiconEntry* lexicon_slots = NULL;
+static size_t lexicon_capacity = 0;         /* power of two, load <= 0.5 */
+static size_t lexicon_count = 0;
+static TextBuilder lexicon_pool = {0};
+static int lexicon_loaded = 0;
+
+static int lexicon_is_word_byte(unsigned char c) {
+    return isalnum(c) || c >= 0x80;
+}
+
+/* Lowercase a word into out; returns its length, or 0 if it does not fit */
+static size_t lexicon_fold(const char* word, size_t len, char* out) {
+    const char* src = word;
+    const char* end = word + len;
+    size_t n = 0;
+
+    while (src < end && *src) {
+        char enc[4];
+        int k = utf8_encode(unicode_tolower(ctts_utf8_next(&src)), enc);
+        if (n + (size_t)k > LEXICON_MAX_WORD) return 0;
+        memcpy(out + n, enc, (size_t)k);
+        n += (size_t)k;
+    }
+    return n;
+}
+
+static LexiconEntry* lexicon_probe(LexiconEntry* slots, size_t capacity, uint32_t hash,
+                                   const char* key, size_t len) {
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+
+    for (;;) {
+        LexiconEntry* e = &slots[i];
+        if (e->key_len == 0) return e;
+        if (e->hash == hash && e->key_len == len &&
+            memcmp(lexicon_pool.data + e->key_offset, key, len) == 0) {
+            return e;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static int lexicon_grow(void) {
+    size_t capacity = lexicon_capacity ? lexicon_capacity * 2 : LEXICON_MIN_SLOTS;
+    LexiconEntry* slots = calloc(capacity, sizeof(LexiconEntry));
+    if (!slots) return CTTS_ERR_OUT_OF_MEMORY;
+
+    for (size_t i = 0; i < lexicon_capacity; i++) {
+        const LexiconEntry* e = &lexicon_slots[i];
+        if (e->key_len == 0) continue;
+        *lexicon_probe(slots, capacity, e->hash,
+                       lexicon_pool.data + e->key_offset, e->key_len) = *e;
+    }
+
+    free(lexicon_slots);
+    lexicon_slots = slots;
+    lexicon_capacity = capacity;
+    return CTTS_OK;
+}
+
+/* Add or replace an entry; a later definition of a word overrides earlier ones */
+static int lexicon_add(const char* word, size_t word_len, const char* value, size_t value_len) {
+    char key[LEXICON_MAX_WORD];
+    size_t key_len = lexicon_fold(word, word_len, key);
+    if (key_len == 0 || value_len > UINT16_MAX) return CTTS_ERR_INVALID_ARG;
+
+    if ((lexicon_count + 1) * 2 > lexicon_capacity) {
+        int err = lexicon_grow();
+        if (err != CTTS_OK) return err;
+    }
+
+    uint32_t hash = ctts_hash(key, key_len);
+    LexiconEntry* e = lexicon_probe(lexicon_slots, lexicon_capacity, hash, key, key_len);
+    int is_new = (e->key_len == 0);
+
+    size_t key_offset = lexicon_pool.len;
+    if (is_new) tb_append(&lexicon_pool, key, key_len);
+    size_t value_offset = lexicon_pool.len;
+    tb_append(&lexicon_pool, value, value_len);
+    if (lexicon_pool.failed || lexicon_pool.len > UINT32_MAX) return CTTS_ERR_OUT_OF_MEMORY;
+
+    if (is_new) {
+        e->hash = hash;
+        e->key_offset = (uint32_t)key_offset;
+        e->key_len = (uint16_t)key_len;
+        lexicon_count++;
+    }
+    e->value_offset = (uint32_t)value_offset;
+    e->value_len = (uint16_t)value_len;
+    return CTTS_OK;
+}
+
+static const LexiconEntry* lexicon_lookup(const char* word, size_t len) {
+    if (lexicon_count == 0 || len > LEXICON_MAX_WORD) return NULL;
+
+    char key[LEXICON_MAX_WORD];
+    size_t key_len = lexicon_fold(word, len, key);
+    if (key_len == 0) return NULL;
+
+    const LexiconEntry* e = lexicon_probe(lexicon_slots, lexicon_capacity,
+                                          ctts_hash(key, key_len), key, key_len);
+    return e->key_len ? e : NULL;
+}
+
+/*
+ * Literal whole-word regex rule (\bword\b or \bword\.) with a plain
+ * replacement: writes the equivalent lexicon key and returns its length,
+ * or 0 if the rule needs the regex engine.
+ */
+static size_t lexicon_key_from_rule(const char* pattern, const char* replace, char* key) {
+    if (strncmp(pattern, "\\b", 2) != 0 || strchr(replace, '\\')) return 0;
+
+    const char* body = pattern + 2;
+    size_t n = 0;
+    while (lexicon_is_word_byte((unsigned char)body[n])) n++;
+    if (n == 0 || n + 1 > LEXICON_MAX_WORD) return 0;
+
+    memcpy(key, body, n);
+    if (strcmp(body + n, "\\b") == 0) return n;
+    if (strcmp(body + n, "\\.") == 0) {
+        key[n] = '.';
+        return n + 1;
+    }
+    return 0;
+}
+
+/* Load word,replacement entries from CSV (merged into the current lexicon) */
+int ctts_load_lexicon(const char* csv_file) {
+    if (!csv_file) return CTTS_ERR_INVALID_ARG;
+
+    FILE* f = fopen(csv_file, "r");
+    if (!f) return CTTS_ERR_FILE_NOT_FOUND;
+
+    char* line = NULL;
+    size_t line_cap = 0;
+    ssize_t got;
+    size_t added = 0;
+    int err = CTTS_OK;
+
+    while (err == CTTS_OK && (got = getline(&line, &line_cap, f)) != -1) {
+        size_t len = (size_t)got;
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len == 0 || line[0] == '#') continue;
+
+        char* comma = strchr(line, ',');
+        if (!comma || comma == line) continue;
+
+        size_t word_len = (size_t)(comma - line);
+        const char* value = comma + 1;
+        err = lexicon_add(line, word_len, value, strlen(value));
+        if (err == CTTS_ERR_INVALID_ARG) {
+            fprintf(stderr, "Warning: Invalid lexicon entry '%.*s'\n", (int)word_len, line);
+            err = CTTS_OK;
+            continue;
+        }
+        if (err == CTTS_OK) added++;
+    }
+
+    free(line);
+    fclose(f);
+    lexicon_loaded = 1;
+
+    if (added > 0) {
+        fprintf(stderr, "Loaded %zu lexicon entries\n", added);
+    }
+    return err;
+}
+
 /* ============================================================================
  * Normalization Rules from CSV
  * ============================================================================ */
@@ -355,6 +611,7 @@ int ctts_load_normalization(const char* csv_file) {
 
     char line[512];
     norm_rule_count = 0;
+    size_t promoted = 0;
 
     while (fgets(line, sizeof(line), f) && norm_rule_count < MAX_NORM_RULES) {
         /* Remove trailing newline */
@@ -376,13 +633,26 @@ int ctts_load_normalization(const char* csv_file) {
         const char* pattern = line;
         const char* replace = comma + 1;
 
+        /* Literal whole-word rules go to the lexicon: one probe per token */
+        char key[LEXICON_MAX_WORD];
+        size_t key_len = lexicon_key_from_rule(pattern, replace, key);
+        if (key_len > 0 && lexicon_add(key, key_len, replace, strlen(replace)) == CTTS_OK) {
+            promoted++;
+            continue;
+        }
+
         /* Convert portable \b to platform-specific word boundaries */
         char* converted_pattern = convert_word_boundaries(pattern);
         if (!converted_pattern) continue;
 
         /* Compile the regex */
         NormRule* rule = &norm_rules[norm_rule_count];
+        size_t heap_before = heap_in_use();
         int err = regcomp(&rule->regex, converted_pattern, REG_EXTENDED);
+        size_t heap_after = heap_in_use();
+        if (err == 0 && heap_after > heap_before) {
+            norm_regex_heap_bytes += heap_after - heap_before;
+        }
         if (err != 0) {
             fprintf(stderr, "Warning: Invalid regex pattern '%s' (converted from '%s')\n",
                     converted_pattern, pattern);
@@ -403,6 +673,9 @@ int ctts_load_normalization(const char* csv_file) {
     if (norm_rule_count > 0) {
         fprintf(stderr, "Loaded %zu normalization rules\n", norm_rule_count);
     }
+    if (promoted > 0) {
+        fprintf(stderr, "Moved %zu whole-word rules to the lexicon\n", promoted);
+    }
 
     return CTTS_OK;
 }
@@ -435,8 +708,8 @@ static size_t apply_replacement(char* dst, size_t dst_remaining,
     return written;
 }
 
-/* Apply normalization rules to text */
-char* ctts_apply_normalization(const char* text) {
+/* Run every compiled regex rule over text, in file order */
+static char* apply_regex_rules(const char* text) {
     if (norm_rule_count == 0) {
         return strdup(text);
     }
@@ -504,7 +777,98 @@ char* ctts_apply_normalization(const char* text) {
     return current;
 }
 
-/* Free normalization rules */
+/* Stands in for a lexicon hit while the regex rules run: not a word byte */
+static const char lexicon_hit_mark = '\x1f';
+
+/* Append text[0..len), turning stray hit marks in the input into spaces */
+static void append_unmarked(TextBuilder* out, const char* text, size_t len) {
+    const char* end = text + len;
+    while (text < end) {
+        const char* mark = memchr(text, lexicon_hit_mark, (size_t)(end - text));
+        size_t run = mark ? (size_t)(mark - text) : (size_t)(end - text);
+        tb_append(out, text, run);
+        if (!mark) break;
+        tb_append(out, " ", 1);
+        text = mark + 1;
+    }
+}
+
+/*
+ * Apply normalization to text. Each token of the original text is looked
+ * up in the lexicon once (with a trailing '.' first, for abbreviations);
+ * lexicon output is final. The regex rules then run once over the whole
+ * string with every hit masked by a single non-word byte, so \b anchors
+ * see the real word edges and never touch a lexicon word.
+ */
+char* ctts_apply_normalization(const char* text) {
+    if (lexicon_count == 0) {
+        return apply_regex_rules(text);
+    }
+
+    TextBuilder masked = {0};
+    TextBuilder values = {0};   /* Replacements in order, NUL-separated */
+    tb_append(&masked, "", 0);
+    tb_append(&values, "", 0);
+
+    const char* plain = text;   /* start of text not yet copied */
+    const char* p = text;
+    while (*p) {
+        if (!lexicon_is_word_byte((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+
+        const char* word = p;
+        while (lexicon_is_word_byte((unsigned char)*p)) p++;
+        size_t word_len = (size_t)(p - word);
+
+        const LexiconEntry* e = NULL;
+        if (*p == '.') e = lexicon_lookup(word, word_len + 1);
+        if (e) {
+            p++;
+        } else {
+            e = lexicon_lookup(word, word_len);
+            if (!e) continue;
+        }
+
+        append_unmarked(&masked, plain, (size_t)(word - plain));
+        tb_append(&masked, &lexicon_hit_mark, 1);
+        tb_append(&values, lexicon_pool.data + e->value_offset, e->value_len);
+        tb_append(&values, "", 1);
+        plain = p;
+    }
+    append_unmarked(&masked, plain, (size_t)(p - plain));
+
+    char* rewritten = masked.failed ? NULL : apply_regex_rules(masked.data);
+    TextBuilder out = {0};
+    tb_append(&out, "", 0);
+    const char* value = values.data;
+    const char* values_end = values.data ? values.data + values.len : NULL;
+    for (const char* r = rewritten; r && *r; ) {
+        const char* mark = strchr(r, lexicon_hit_mark);
+        size_t run = mark ? (size_t)(mark - r) : strlen(r);
+        tb_append(&out, r, run);
+        if (!mark) break;
+        if (value && value < values_end) {
+            size_t value_len = strlen(value);
+            tb_append(&out, value, value_len);
+            value += value_len + 1;
+        }
+        r = mark + 1;
+    }
+
+    int failed = !rewritten || values.failed || out.failed;
+    free(rewritten);
+    free(masked.data);
+    free(values.data);
+    if (failed) {
+        free(out.data);
+        return NULL;
+    }
+    return out.data;
+}
+
+/* Free normalization rules and the lexicon */
 void ctts_free_normalization(void) {
     for (size_t i = 0; i < norm_rule_count; i++) {
         if (norm_rules[i].compiled) {
@@ -514,6 +878,24 @@ void ctts_free_normalization(void) {
     }
     norm_rule_count = 0;
     norm_rules_loaded = 0;
+    norm_regex_heap_bytes = 0;
+
+    free(lexicon_slots);
+    free(lexicon_pool.data);
+    lexicon_slots = NULL;
+    lexicon_capacity = 0;
+    lexicon_count = 0;
+    memset(&lexicon_pool, 0, sizeof(lexicon_pool));
+    lexicon_loaded = 0;
+}
+
+/* Default frontend rules from the working directory, loaded on first use */
+static void load_frontend_rules(void) {
+    ctts_load_normalization("normalization.csv");
+    if (!lexicon_loaded) {
+        ctts_load_lexicon("lexicon.csv");
+        lexicon_loaded = 1;
+    }
 }
 
 /* ============================================================================
@@ -537,150 +919,467 @@ static const char* hundreds_pt[] = {
     "seiscentos", "setecentos", "oitocentos", "novecentos"
 };
 
-/* Convert number 0-999 to Portuguese words */
-static void number_to_words_pt(int n, char* buf, size_t buf_size) {
-    if (n == 0) {
-        strncpy(buf, "zero", buf_size);
-        return;
+/* Feminine forms (uma hora, duas mil pessoas, duzentas) */
+static const char* hundreds_fem_pt[] = {
+    "", "cento", "duzentas", "trezentas", "quatrocentas", "quinhentas",
+    "seiscentas", "setecentas", "oitocentas", "novecentas"
+};
+
+/* Scale words for groups of three digits */
+static const char* scale_singular_pt[] = {
+    "", "mil", "milhão", "bilhão", "trilhão", "quatrilhão", "quintilhão"
+};
+static const char* scale_plural_pt[] = {
+    "", "mil", "milhões", "bilhões", "trilhões", "quatrilhões", "quintilhões"
+};
+#define NUMBER_MAX_GROUPS (sizeof(scale_singular_pt) / sizeof(scale_singular_pt[0]))
+
+static const char* digits_pt[] = {
+    "zero", "um", "dois", "três", "quatro", "cinco", "seis", "sete", "oito", "nove"
+};
+
+/* Masculine ordinals; the feminine replaces each word's final 'o' with 'a' */
+static const char* ordinal_units_pt[] = {
+    "", "primeiro", "segundo", "terceiro", "quarto", "quinto",
+    "sexto", "sétimo", "oitavo", "nono"
+};
+static const char* ordinal_tens_pt[] = {
+    "", "décimo", "vigésimo", "trigésimo", "quadragésimo", "quinquagésimo",
+    "sexagésimo", "septuagésimo", "octogésimo", "nonagésimo"
+};
+static const char* ordinal_hundreds_pt[] = {
+    "", "centésimo", "ducentésimo", "trecentésimo", "quadringentésimo",
+    "quingentésimo", "sexcentésimo", "septingentésimo", "octingentésimo",
+    "nongentésimo"
+};
+
+static const char* months_pt[] = {
+    "", "janeiro", "fevereiro", "março", "abril", "maio", "junho",
+    "julho", "agosto", "setembro", "outubro", "novembro", "dezembro"
+};
+
+/*
+ * Precomputed words for 0-999, masculine and feminine.
+ * Built once (thread-safe) from the tables above.
+ */
+#define NUMBER_WORD_MAX 48
+
+static char number_words[2][1000][NUMBER_WORD_MAX];
+static uint8_t number_words_len[2][1000];
+static pthread_once_t number_words_once = PTHREAD_ONCE_INIT;
+static int number_words_ready = 0;
+
+static void init_number_words(void) {
+    for (int fem = 0; fem < 2; fem++) {
+        for (int n = 0; n < 1000; n++) {
+            char* w = number_words[fem][n];
+            int h = n / 100, rest = n % 100;
+            const char* unit_words[20];
+            memcpy(unit_words, units_pt, sizeof(unit_words));
+            if (fem) {
+                unit_words[1] = "uma";
+                unit_words[2] = "duas";
+            }
+
+            char rest_words[32] = "";
+            if (rest > 0 && rest < 20) {
+                snprintf(rest_words, sizeof(rest_words), "%s", unit_words[rest]);
+            } else if (rest >= 20) {
+                snprintf(rest_words, sizeof(rest_words), rest % 10 ? "%s e %s" : "%s",
+                         tens_pt[rest / 10], unit_words[rest % 10]);
+            }
+
+            if (n == 0) {
+                snprintf(w, NUMBER_WORD_MAX, "zero");
+            } else if (n == 100) {
+                snprintf(w, NUMBER_WORD_MAX, "cem");
+            } else if (h == 0) {
+                snprintf(w, NUMBER_WORD_MAX, "%s", rest_words);
+            } else if (rest == 0) {
+                snprintf(w, NUMBER_WORD_MAX, "%s", fem ? hundreds_fem_pt[h] : hundreds_pt[h]);
+            } else {
+                snprintf(w, NUMBER_WORD_MAX, "%s e %s",
+                         fem ? hundreds_fem_pt[h] : hundreds_pt[h], rest_words);
+            }
+            number_words_len[fem][n] = (uint8_t)strlen(w);
+        }
+    }
+    number_words_ready = 1;
+}
+
+/* Append a word, separated by a space from a preceding word or number */
+static void tb_word(TextBuilder* tb, const char* w, size_t n) {
+    if (tb->len > 0) {
+        unsigned char last = (unsigned char)tb->data[tb->len - 1];
+        if (isalnum(last) || last >= 0x80) tb_append(tb, " ", 1);
+    }
+    tb_append(tb, w, n);
+}
+
+static void tb_words(TextBuilder* tb, const char* w) {
+    tb_word(tb, w, strlen(w));
+}
+
+static void verbalize_digits(TextBuilder* tb, const char* digits, size_t n) {
+    for (size_t i = 0; i < n; i++) tb_words(tb, digits_pt[digits[i] - '0']);
+}
+
+/*
+ * Verbalize a digit string of any length as a cardinal.
+ * Groups of three use the precomputed words; "e" joins the last group when
+ * it is below 100 or a round hundred (mil e duzentos, mil duzentos e trinta).
+ * Beyond the largest scale the digits are read one by one.
+ */
+static void verbalize_cardinal(TextBuilder* tb, const char* digits, size_t n, int feminine) {
+    while (n > 1 && *digits == '0') {
+        digits++;
+        n--;
     }
 
-    buf[0] = '\0';
+    size_t groups = (n + 2) / 3;
+    if (groups > NUMBER_MAX_GROUPS) {
+        verbalize_digits(tb, digits, n);
+        return;
+    }
 
-    if (n == 100) {
-        strncpy(buf, "cem", buf_size);
+    int values[NUMBER_MAX_GROUPS];
+    size_t first_len = n - (groups - 1) * 3;
+    size_t pos = 0;
+    int last_nonzero = -1;
+    for (size_t g = 0; g < groups; g++) {
+        size_t len = (g == 0) ? first_len : 3;
+        int v = 0;
+        for (size_t i = 0; i < len; i++) v = v * 10 + (digits[pos + i] - '0');
+        pos += len;
+        values[g] = v;
+        if (v) last_nonzero = (int)g;
+    }
+
+    if (last_nonzero < 0) {
+        tb_words(tb, "zero");
         return;
     }
 
-    int h = n / 100;
-    int t = (n % 100) / 10;
-    int u = n % 10;
+    int emitted = 0;
+    for (size_t g = 0; g < groups; g++) {
+        int v = values[g];
+        if (v == 0) continue;
+        size_t scale = groups - 1 - g;
+
+        if (emitted && (int)g == last_nonzero && (v < 100 || v % 100 == 0)) {
+            tb_word(tb, "e", 1);
+        }
+        /* "mil", not "um mil"; units and thousands agree in gender */
+        if (!(scale == 1 && v == 1)) {
+            int fem = feminine && scale <= 1;
+            tb_word(tb, number_words[fem][v], number_words_len[fem][v]);
+        }
+        if (scale > 0) {
+            tb_words(tb, v == 1 ? scale_singular_pt[scale] : scale_plural_pt[scale]);
+        }
+        emitted = 1;
+    }
+}
 
-    if (h > 0) {
-        strncat(buf, hundreds_pt[h], buf_size - strlen(buf) - 1);
+static void verbalize_ordinal(TextBuilder* tb, int n, int feminine) {
+    const char* const* tables[3] = { ordinal_hundreds_pt, ordinal_tens_pt, ordinal_units_pt };
+    int parts[3] = { n / 100, (n / 10) % 10, n % 10 };
+    for (int i = 0; i < 3; i++) {
+        if (parts[i] == 0) continue;
+        tb_words(tb, tables[i][parts[i]]);
+        if (feminine && !tb->failed) tb->data[tb->len - 1] = 'a';
     }
+}
 
-    if (n % 100 > 0) {
-        if (h > 0) strncat(buf, " e ", buf_size - strlen(buf) - 1);
+static size_t count_digits(const char* p) {
+    size_t n = 0;
+    while (p[n] >= '0' && p[n] <= '9') n++;
+    return n;
+}
 
-        if (n % 100 < 20) {
-            strncat(buf, units_pt[n % 100], buf_size - strlen(buf) - 1);
-        } else {
-            strncat(buf, tens_pt[t], buf_size - strlen(buf) - 1);
-            if (u > 0) {
-                strncat(buf, " e ", buf_size - strlen(buf) - 1);
-                strncat(buf, units_pt[u], buf_size - strlen(buf) - 1);
-            }
+static int digits_value(const char* p, size_t n) {
+    int v = 0;
+    for (size_t i = 0; i < n; i++) v = v * 10 + (p[i] - '0');
+    return v;
+}
+
+/* Longest digit string kept for cardinal reading (scales run out before) */
+#define NUMBER_MAX_DIGITS 64
+
+/*
+ * Parse "1.234.567,89": integer digits (dots as thousands separators, each
+ * group exactly three digits) into int_digits, and the fraction after a
+ * comma. Returns the end of the number.
+ */
+static const char* parse_decimal(const char* p, char* int_digits, size_t* int_len,
+                                 const char** frac, size_t* frac_len) {
+    size_t n = count_digits(p);
+    size_t len = 0;
+    if (n > NUMBER_MAX_DIGITS) n = NUMBER_MAX_DIGITS;
+    memcpy(int_digits, p, n);
+    len = n;
+    p += n;
+
+    if (n <= 3) {
+        while (p[0] == '.' && count_digits(p + 1) == 3 && len + 3 <= NUMBER_MAX_DIGITS) {
+            memcpy(int_digits + len, p + 1, 3);
+            len += 3;
+            p += 4;
         }
     }
+    *int_len = len;
+
+    *frac = NULL;
+    *frac_len = 0;
+    if (p[0] == ',' && p[1] >= '0' && p[1] <= '9') {
+        *frac = p + 1;
+        *frac_len = count_digits(p + 1);
+        p += 1 + *frac_len;
+    }
+    return p;
 }
 
-/* Convert full number to Portuguese words */
-static void full_number_to_words_pt(long n, char* buf, size_t buf_size) {
-    if (n == 0) {
-        strncpy(buf, "zero", buf_size);
-        return;
+/* Decimal fraction: leading zeros read as "zero", the rest as a number */
+static void verbalize_fraction(TextBuilder* tb, const char* frac, size_t n) {
+    tb_words(tb, "vírgula");
+    while (n > 1 && *frac == '0') {
+        tb_words(tb, "zero");
+        frac++;
+        n--;
     }
+    verbalize_cardinal(tb, frac, n, 0);
+}
 
-    if (n < 0) {
-        strncpy(buf, "menos ", buf_size);
-        n = -n;
-    } else {
-        buf[0] = '\0';
-    }
-
-    if (n >= 1000000000) {
-        /* Billions */
-        int billions = n / 1000000000;
-        char temp[64];
-        number_to_words_pt(billions, temp, sizeof(temp));
-        strncat(buf, temp, buf_size - strlen(buf) - 1);
-        strncat(buf, billions == 1 ? " bilhão" : " bilhões", buf_size - strlen(buf) - 1);
-        n %= 1000000000;
-        if (n > 0) strncat(buf, " e ", buf_size - strlen(buf) - 1);
-    }
-
-    if (n >= 1000000) {
-        /* Millions */
-        int millions = n / 1000000;
-        char temp[64];
-        number_to_words_pt(millions, temp, sizeof(temp));
-        strncat(buf, temp, buf_size - strlen(buf) - 1);
-        strncat(buf, millions == 1 ? " milhão" : " milhões", buf_size - strlen(buf) - 1);
-        n %= 1000000;
-        if (n > 0) strncat(buf, " e ", buf_size - strlen(buf) - 1);
-    }
-
-    if (n >= 1000) {
-        /* Thousands */
-        int thousands = n / 1000;
-        if (thousands == 1) {
-            strncat(buf, "mil", buf_size - strlen(buf) - 1);
-        } else {
-            char temp[64];
-            number_to_words_pt(thousands, temp, sizeof(temp));
-            strncat(buf, temp, buf_size - strlen(buf) - 1);
-            strncat(buf, " mil", buf_size - strlen(buf) - 1);
-        }
-        n %= 1000;
-        if (n > 0) {
-            if (n < 100) {
-                strncat(buf, " e ", buf_size - strlen(buf) - 1);
-            } else {
-                strncat(buf, " ", buf_size - strlen(buf) - 1);
+/* R$ amount: reais and centavos */
+static const char* verbalize_currency(TextBuilder* tb, const char* p) {
+    char int_digits[NUMBER_MAX_DIGITS];
+    size_t int_len;
+    const char* frac;
+    size_t frac_len;
+    const char* end = parse_decimal(p, int_digits, &int_len, &frac, &frac_len);
+
+    size_t sig = 0;
+    while (sig < int_len && int_digits[sig] == '0') sig++;
+    int has_reais = sig < int_len;
+    int cents = 0;
+    if (frac && frac_len <= 2) {
+        cents = digits_value(frac, frac_len) * (frac_len == 1 ? 10 : 1);
+    }
+
+    if (has_reais || cents == 0) {
+        verbalize_cardinal(tb, int_digits, int_len, 0);
+        if (frac && frac_len > 2) verbalize_fraction(tb, frac, frac_len);
+
+        /* Exact millions and above take "de": "um milhão de reais" */
+        int round_millions = (int_len - sig > 6);
+        for (size_t i = int_len - 6; round_millions && i < int_len; i++) {
+            if (int_digits[i] != '0') round_millions = 0;
+        }
+        if (round_millions) tb_words(tb, "de");
+
+        int one = (int_len - sig == 1 && int_digits[int_len - 1] == '1' && !(frac && frac_len > 2));
+        tb_words(tb, one ? "real" : "reais");
+    }
+    if (cents > 0) {
+        if (has_reais) tb_words(tb, "e");
+        tb_word(tb, number_words[0][cents], number_words_len[0][cents]);
+        tb_words(tb, cents == 1 ? "centavo" : "centavos");
+    }
+    return end;
+}
+
+/* "primeiro de março", "quinze de março" */
+static void verbalize_day_month(TextBuilder* tb, int day, int month) {
+    if (day == 1) tb_words(tb, "primeiro");
+    else tb_word(tb, number_words[0][day], number_words_len[0][day]);
+    tb_words(tb, "de");
+    tb_words(tb, months_pt[month]);
+}
+
+/* Words after which a digit run is a code read digit by digit */
+static const char* code_words_pt[] = {
+    "telefone", "tel", "celular", "fone", "whatsapp", "ramal", "código",
+    "protocolo", "cpf", "cnpj", "cep", "senha", "pin"
+};
+
+/* Words after which an unpadded d/m is read as a date even without a year */
+static const char* date_words_pt[] = {
+    "dia", "em", "até", "desde", "após", "entre", "hoje", "amanhã", "ontem",
+    "vence", "vencimento", "prazo", "validade"
+};
+
+/* Whether the word before p (skipping spaces, ':' and '.') is one of words */
+static int preceded_by_word(const char* text, const char* p,
+                            const char* const* words, size_t count) {
+    const char* end = p;
+    while (end > text && (end[-1] == ' ' || end[-1] == ':' || end[-1] == '.')) end--;
+    const char* start = end;
+    while (start > text && (isalpha((unsigned char)start[-1]) ||
+                            (unsigned char)start[-1] >= 0x80)) start--;
+    size_t len = (size_t)(end - start);
+    if (len == 0) return 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(words[i]) != len) continue;
+        size_t k = 0;
+        while (k < len && tolower((unsigned char)start[k]) == (unsigned char)words[i][k]) k++;
+        if (k == len) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Verbalize the number starting at p (a digit), recognizing phone numbers,
+ * dates, times, ordinals, decimals, thousands separators and percentages.
+ * Returns the end of the consumed text.
+ */
+static const char* verbalize_number(TextBuilder* tb, const char* text, const char* p) {
+    size_t n = count_digits(p);
+    const char* after = p + n;
+
+    /* Phone numbers: 9876-5432, 98765-4321, area code "(11)", country code "+55" */
+    if ((n == 4 || n == 5) && after[0] == '-' && count_digits(after + 1) == 4) {
+        verbalize_digits(tb, p, n);
+        verbalize_digits(tb, after + 1, 4);
+        return after + 5;
+    }
+    if (p > text && ((p[-1] == '(' && after[0] == ')' && n <= 3) || p[-1] == '+')) {
+        verbalize_digits(tb, p, n);
+        return after;
+    }
+
+    /*
+     * Dates: dd/mm/yy(yy), a zero-padded or unambiguous dd/mm ("15/03",
+     * "01/02", "25/12"), or d/m after a word like "dia" or "vence"; a bare
+     * "1/2" is left alone (meia xícara, not primeiro de fevereiro)
+     */
+    if (n <= 2 && after[0] == '/') {
+        size_t m = count_digits(after + 1);
+        int day = digits_value(p, n);
+        int month = (m >= 1 && m <= 2) ? digits_value(after + 1, m) : 0;
+        const char* end = after + 1 + m;
+        size_t y = (end[0] == '/') ? count_digits(end + 1) : 0;
+        int has_year = (y == 2 || y == 4);
+        int padded = (m == 2 || (n == 2 && p[0] == '0') || day > 12);
+        if (day >= 1 && day <= 31 && month >= 1 && month <= 12 &&
+            (has_year || padded ||
+             preceded_by_word(text, p, date_words_pt,
+                              sizeof(date_words_pt) / sizeof(date_words_pt[0])))) {
+            verbalize_day_month(tb, day, month);
+            if (has_year) {
+                tb_words(tb, "de");
+                verbalize_cardinal(tb, end + 1, y, 0);
+                end += 1 + y;
+            }
+            return end;
+        }
+    }
+
+    /* Times: 14:30, 14h30, 9h */
+    if (n <= 2 && (after[0] == ':' || after[0] == 'h')) {
+        size_t m = count_digits(after + 1);
+        int hour = digits_value(p, n);
+        int is_clock = (after[0] == ':') ? (m == 2) :
+                       (m == 2 || (m == 0 && !isalpha((unsigned char)after[1])));
+        int minute = (m == 2) ? digits_value(after + 1, 2) : 0;
+        if (is_clock && hour <= 23 && minute <= 59) {
+            tb_word(tb, number_words[1][hour], number_words_len[1][hour]);
+            tb_words(tb, hour <= 1 ? "hora" : "horas");
+            if (minute > 0) {
+                tb_words(tb, "e");
+                tb_word(tb, number_words[0][minute], number_words_len[0][minute]);
+                tb_words(tb, minute == 1 ? "minuto" : "minutos");
             }
+            return after + 1 + m;
         }
     }
 
-    if (n > 0) {
-        char temp[64];
-        number_to_words_pt(n, temp, sizeof(temp));
-        strncat(buf, temp, buf_size - strlen(buf) - 1);
+    /* Ordinals: 1º, 2ª, 3° */
+    if (n <= 3 && (unsigned char)after[0] == 0xC2 &&
+        ((unsigned char)after[1] == 0xBA || (unsigned char)after[1] == 0xAA ||
+         (unsigned char)after[1] == 0xB0)) {
+        int v = digits_value(p, n);
+        if (v > 0) {
+            verbalize_ordinal(tb, v, (unsigned char)after[1] == 0xAA);
+            return after + 2;
+        }
     }
+
+    /*
+     * Codes with leading zeros (0800, 007), numbers after an area code
+     * "(11) 987654321" and after words like "telefone" or "CPF": digit by
+     * digit. Other long runs are cardinals ("1000000000" is "um bilhão"),
+     * and so is the part after a '/', whatever its zeros.
+     */
+    const char* prev = p;
+    while (prev > text && prev[-1] == ' ') prev--;
+    int after_slash = (p > text && p[-1] == '/');
+    if ((n > 1 && p[0] == '0' && !after_slash) || (n >= 8 && prev > text && prev[-1] == ')') ||
+        preceded_by_word(text, p, code_words_pt, sizeof(code_words_pt) / sizeof(code_words_pt[0]))) {
+        verbalize_digits(tb, p, n);
+        return after;
+    }
+
+    /* Cardinal, with thousands separators, decimal fraction and percent */
+    char int_digits[NUMBER_MAX_DIGITS];
+    size_t int_len;
+    const char* frac;
+    size_t frac_len;
+    const char* end = parse_decimal(p, int_digits, &int_len, &frac, &frac_len);
+    verbalize_cardinal(tb, int_digits, int_len, 0);
+    if (frac) verbalize_fraction(tb, frac, frac_len);
+    if (*end == '%') {
+        tb_words(tb, "por cento");
+        end++;
+    }
+    return end;
 }
 
-/* Expand numbers in text to Portuguese words */
+/*
+ * Expand numbers in text to Portuguese words.
+ * Words are appended straight into one growing output buffer, so expansion
+ * is linear in the input and output length.
+ */
 static char* expand_numbers(const char* text) {
-    size_t len = strlen(text);
-    size_t buf_size = len * 20 + 1024;  /* Numbers can expand significantly */
-    char* result = malloc(buf_size);
-    if (!result) return strdup(text);
+    pthread_once(&number_words_once, init_number_words);
 
-    char* dst = result;
-    const char* src = text;
-    size_t remaining = buf_size - 1;
-
-    while (*src && remaining > 0) {
-        /* Check for number sequence */
-        if (*src >= '0' && *src <= '9') {
-            /* Parse the number */
-            long num = 0;
-            const char* num_start = src;
-            while (*src >= '0' && *src <= '9') {
-                num = num * 10 + (*src - '0');
-                src++;
-            }
-
-            /* Convert to words */
-            char words[256];
-            full_number_to_words_pt(num, words, sizeof(words));
-
-            /* Copy words to result */
-            size_t word_len = strlen(words);
-            if (word_len > remaining) word_len = remaining;
-            memcpy(dst, words, word_len);
-            dst += word_len;
-            remaining -= word_len;
+    TextBuilder tb = { NULL, 0, 0, 0 };
+    tb_append(&tb, "", 0);
+
+    const char* p = text;
+    while (*p && !tb.failed) {
+        const char* end = NULL;
+        if (p[0] == 'R' && p[1] == '$') {
+            const char* q = p + 2;
+            while (*q == ' ') q++;
+            if (*q >= '0' && *q <= '9') end = verbalize_currency(&tb, q);
+        } else if (*p >= '0' && *p <= '9') {
+            end = verbalize_number(&tb, text, p);
+        }
+
+        if (end) {
+            /* Keep words glued to the number apart ("10kg") */
+            p = end;
+            if (isalnum((unsigned char)*p) || (unsigned char)*p >= 0x80) {
+                tb_append(&tb, " ", 1);
+            }
         } else {
-            *dst++ = *src++;
-            remaining--;
+            /* Copy plain text up to the next candidate in one append */
+            const char* q = p + 1;
+            while (*q && !(*q >= '0' && *q <= '9') && !(q[0] == 'R' && q[1] == '$')) q++;
+            tb_append(&tb, p, (size_t)(q - p));
+            p = q;
         }
     }
-    *dst = '\0';
 
-    return result;
+    if (tb.failed) {
+        free(tb.data);
+        return strdup(text);
+    }
+    return tb.data;
 }
 
-/* Note: Abbreviation expansion is handled via normalization.csv for flexibility */
+/* Note: Abbreviation expansion is handled via lexicon.csv (see Pronunciation Lexicon) */
 
 /* ============================================================================
  * Punctuation Pause Durations
@@ -717,113 +1416,347 @@ static int is_sentence_end(char c) {
  * WAV File I/O
  * ============================================================================ */
 
-/* Read WAV file and extract PCM samples */
-static int read_wav(const char* path, int16_t** samples, size_t* sample_count) {
-    FILE* f = fopen(path, "rb");
-    if (!f) return CTTS_ERR_FILE_NOT_FOUND;
+#define WAV_FORMAT_PCM        1
+#define WAV_FORMAT_FLOAT       3
+#define WAV_FORMAT_EXTENSIBLE  0xFFFE
+
+/* Resampler: Kaiser-windowed sinc polyphase filter bank */
+#define RESAMPLE_ZEROS      16      /* Zero crossings per side (at cutoff) */
+#define RESAMPLE_MAX_PHASES 4096    /* Phases beyond this snap to the nearest */
+#define RESAMPLE_BETA       8.6     /* Kaiser window shape (~-90 dB stopband) */
+#define RESAMPLE_ROLLOFF    0.95    /* Cutoff as a fraction of the lower Nyquist */
+
+/* Zeroth-order modified Bessel function (for the Kaiser window) */
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
 
-    WAVRiff riff;
-    if (fread(&riff, sizeof(riff), 1, f) != 1) {
-        fclose(f);
-        return CTTS_ERR_FILE_READ;
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
     }
+    return a;
+}
 
-    if (memcmp(riff.riff, "RIFF", 4) != 0 || memcmp(riff.wave, "WAVE", 4) != 0) {
-        fclose(f);
-        return CTTS_ERR_INVALID_WAV;
+/*
+ * Band-limited resampling of a mono float signal to out_rate.
+ * When downsampling, the cutoff drops to the output Nyquist (anti-aliasing).
+ * Output sample k sits at input position k * in_rate / out_rate; its
+ * fractional part takes one of out_rate / gcd values, so one kernel per
+ * phase is precomputed and each output is a contiguous dot product.
+ */
+static int resample_float(const float* in, size_t in_count, uint32_t in_rate,
+                          uint32_t out_rate, float** out, size_t* out_count) {
+    double fc = RESAMPLE_ROLLOFF * (out_rate < in_rate ? (double)out_rate / in_rate : 1.0);
+    size_t half = (size_t)ceil(RESAMPLE_ZEROS / fc);
+    size_t taps = (2 * half + 7) & ~(size_t)7;  /* Zero-padded to 8 lanes */
+    uint32_t exact_phases = out_rate / gcd_u32(in_rate, out_rate);
+    size_t phases = exact_phases < RESAMPLE_MAX_PHASES ? exact_phases : RESAMPLE_MAX_PHASES;
+
+    float* bank = malloc(phases * taps * sizeof(float));
+    size_t n_out = (size_t)((uint64_t)in_count * out_rate / in_rate);
+    float* result = malloc((n_out ? n_out : 1) * sizeof(float));
+    if (!bank || !result) {
+        free(bank);
+        free(result);
+        return CTTS_ERR_OUT_OF_MEMORY;
     }
 
-    WAVFmt fmt = {0};
-    int found_fmt = 0, found_data = 0;
-    uint32_t data_size = 0;
+    /* Tap t of phase p covers input ip - half + 1 + t, at offset x from the output */
+    double i0_beta = bessel_i0(RESAMPLE_BETA);
+    for (size_t p = 0; p < phases; p++) {
+        double frac = (double)p / phases;
+        for (size_t t = 0; t < taps; t++) {
+            double x = (double)t - (double)half + 1.0 - frac;
+            double r = fabs(x) / (double)half;
+            double h = 0.0;
+            if (r < 1.0) {
+                double sinc = (x == 0.0) ? 1.0 : sin(PI * fc * x) / (PI * fc * x);
+                h = fc * sinc * bessel_i0(RESAMPLE_BETA * sqrt(1.0 - r * r)) / i0_beta;
+            }
+            bank[p * taps + t] = (float)h;
+        }
+    }
 
-    while (!found_data) {
-        WAVChunk chunk;
-        if (fread(&chunk, sizeof(chunk), 1, f) != 1) break;
+    for (size_t k = 0; k < n_out; k++) {
+        uint64_t num = (uint64_t)k * in_rate;
+        size_t ip = (size_t)(num / out_rate);
+        size_t p = (size_t)((num % out_rate) * phases / out_rate);
+        const float* kernel = bank + p * taps;
 
-        if (memcmp(chunk.id, "fmt ", 4) == 0) {
-            if (chunk.size < sizeof(fmt)) {
-                fclose(f);
-                return CTTS_ERR_INVALID_WAV;
-            }
-            if (fread(&fmt, sizeof(fmt), 1, f) != 1) {
-                fclose(f);
-                return CTTS_ERR_FILE_READ;
-            }
-            /* Skip extra bytes in fmt chunk */
-            if (chunk.size > sizeof(fmt)) {
-                fseek(f, chunk.size - sizeof(fmt), SEEK_CUR);
+        float acc = 0.0f;
+        if (ip + 1 >= half && ip + 1 - half + taps <= in_count) {
+            /* Eight independent lane sums let the compiler use SIMD */
+            const float* x = in + ip + 1 - half;
+            float lane[8] = {0.0f};
+            for (size_t t = 0; t < taps; t += 8) {
+                for (int l = 0; l < 8; l++) lane[l] += x[t + l] * kernel[t + l];
             }
-            found_fmt = 1;
-        } else if (memcmp(chunk.id, "data", 4) == 0) {
-            data_size = chunk.size;
-            found_data = 1;
+            acc = ((lane[0] + lane[4]) + (lane[1] + lane[5])) +
+                  ((lane[2] + lane[6]) + (lane[3] + lane[7]));
         } else {
-            /* Skip unknown chunk */
-            fseek(f, chunk.size, SEEK_CUR);
+            /* Edges: skip taps outside the signal */
+            for (size_t t = 0; t < taps; t++) {
+                size_t j = ip + 1 + t;
+                if (j < half || j - half >= in_count) continue;
+                acc += in[j - half] * kernel[t];
+            }
         }
+        result[k] = acc;
     }
 
-    if (!found_fmt || !found_data) {
-        fclose(f);
-        return CTTS_ERR_INVALID_WAV;
-    }
+    free(bank);
+    *out = result;
+    *out_count = n_out;
+    return CTTS_OK;
+}
 
-    if (fmt.audio_format != 1 || fmt.bits_per_sample != 16) {
-        fclose(f);
-        return CTTS_ERR_INVALID_WAV;
-    }
+/*
+ * Decode interleaved PCM/float frames to mono float at int16 scale,
+ * averaging channels. LOAD(p) converts one sample at byte pointer p; each
+ * format expands to a flat loop (a straight copy for mono) that the
+ * compiler can vectorize.
+ */
+#define WAV_DECODE_LOOP(bytes, LOAD)                                        \
+    do {                                                                    \
+        if (channels == 1) {                                                \
+            for (size_t f = 0; f < frames; f++) {                           \
+                const uint8_t* p = data + f * (bytes);                      \
+                out[f] = (LOAD);                                            \
+            }                                                               \
+        } else {                                                            \
+            for (size_t f = 0; f < frames; f++) {                           \
+                float sum = 0.0f;                                           \
+                for (int c = 0; c < channels; c++) {                        \
+                    const uint8_t* p = data + (f * channels + c) * (bytes); \
+                    sum += (LOAD);                                          \
+                }                                                           \
+                out[f] = sum * gain;                                        \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+static inline float wav_load_f32(const uint8_t* p) {
+    float v;
+    memcpy(&v, p, 4);
+    return v * 32768.0f;
+}
 
-    *sample_count = data_size / (fmt.bits_per_sample / 8) / fmt.num_channels;
-    *samples = malloc(*sample_count * sizeof(int16_t));
-    if (!*samples) {
-        fclose(f);
-        return CTTS_ERR_OUT_OF_MEMORY;
+static inline float wav_load_f64(const uint8_t* p) {
+    double v;
+    memcpy(&v, p, 8);
+    return (float)(v * 32768.0);
+}
+
+static inline float wav_load_s16(const uint8_t* p) {
+    int16_t v;
+    memcpy(&v, p, 2);
+    return (float)v;
+}
+
+static inline float wav_load_s24(const uint8_t* p) {
+    int32_t v = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 |
+                          (uint32_t)p[2] << 24) >> 8;
+    return (float)v * (1.0f / 256.0f);
+}
+
+static inline float wav_load_s32(const uint8_t* p) {
+    int32_t v;
+    memcpy(&v, p, 4);
+    return (float)v * (1.0f / 65536.0f);
+}
+
+static void wav_decode_mono(const uint8_t* data, size_t frames, int format,
+                            int bits, int channels, float* out) {
+    float gain = 1.0f / (float)channels;
+
+    if (format == WAV_FORMAT_FLOAT && bits == 32) {
+        WAV_DECODE_LOOP(4, wav_load_f32(p));
+    } else if (format == WAV_FORMAT_FLOAT && bits == 64) {
+        WAV_DECODE_LOOP(8, wav_load_f64(p));
+    } else if (bits == 8) {
+        WAV_DECODE_LOOP(1, ((float)p[0] - 128.0f) * 256.0f);
+    } else if (bits == 16) {
+        WAV_DECODE_LOOP(2, wav_load_s16(p));
+    } else if (bits == 24) {
+        WAV_DECODE_LOOP(3, wav_load_s24(p));
+    } else {    /* 32-bit integer */
+        WAV_DECODE_LOOP(4, wav_load_s32(p));
     }
+}
 
-    /* Read samples (handle mono/stereo) */
-    if (fmt.num_channels == 1) {
-        if (fread(*samples, sizeof(int16_t), *sample_count, f) != *sample_count) {
-            free(*samples);
-            fclose(f);
-            return CTTS_ERR_FILE_READ;
+/*
+ * Read WAV file and extract mono PCM samples at CTTS_SAMPLE_RATE.
+ * Accepts 8/16/24/32-bit integer and 32/64-bit float data (including
+ * WAVE_FORMAT_EXTENSIBLE), any channel count and any sample rate.
+ * The file is mapped once; 16-bit input at the voice rate is copied or
+ * downmixed directly, everything else goes through float and is resampled.
+ */
+static int read_wav(const char* path, int16_t** samples, size_t* sample_count) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return CTTS_ERR_FILE_NOT_FOUND;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return CTTS_ERR_FILE_READ;
+    }
+    size_t file_size = (size_t)st.st_size;
+    if (file_size < sizeof(WAVRiff)) {
+        close(fd);
+        return CTTS_ERR_INVALID_WAV;
+    }
+
+    uint8_t* map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return CTTS_ERR_FILE_READ;
+    posix_madvise(map, file_size, POSIX_MADV_SEQUENTIAL);
+
+    int err = CTTS_OK;
+    WAVRiff riff;
+    memcpy(&riff, map, sizeof(riff));
+
+    WAVFmt fmt = {0};
+    int format = 0;
+    const uint8_t* data = NULL;
+    size_t data_size = 0;
+    int found_fmt = 0;
+
+    if (memcmp(riff.riff, "RIFF", 4) != 0 || memcmp(riff.wave, "WAVE", 4) != 0) {
+        err = CTTS_ERR_INVALID_WAV;
+    }
+
+    /* Walk chunks (word-aligned) */
+    size_t pos = sizeof(WAVRiff);
+    while (err == CTTS_OK && !data && pos + sizeof(WAVChunk) <= file_size) {
+        WAVChunk chunk;
+        memcpy(&chunk, map + pos, sizeof(chunk));
+        pos += sizeof(chunk);
+        size_t avail = file_size - pos;
+
+        if (memcmp(chunk.id, "fmt ", 4) == 0) {
+            if (chunk.size < sizeof(fmt) || chunk.size > avail) {
+                err = CTTS_ERR_INVALID_WAV;
+                break;
+            }
+            memcpy(&fmt, map + pos, sizeof(fmt));
+            format = fmt.audio_format;
+            /* WAVE_FORMAT_EXTENSIBLE: real format is the SubFormat GUID prefix */
+            if (format == WAV_FORMAT_EXTENSIBLE && chunk.size >= 26) {
+                uint16_t sub;
+                memcpy(&sub, map + pos + 24, 2);
+                format = sub;
+            }
+            found_fmt = 1;
+        } else if (memcmp(chunk.id, "data", 4) == 0) {
+            data = map + pos;
+            /* Clamp sizes from truncated or still-being-written files */
+            data_size = chunk.size < avail ? chunk.size : avail;
+            break;
+        }
+        if (chunk.size > avail) break;
+        pos += chunk.size + (chunk.size & 1);
+    }
+
+    if (err == CTTS_OK && (!found_fmt || !data)) err = CTTS_ERR_INVALID_WAV;
+
+    int bits = fmt.bits_per_sample;
+    int channels = fmt.num_channels;
+    if (err == CTTS_OK) {
+        int int_ok = (format == WAV_FORMAT_PCM &&
+                      (bits == 8 || bits == 16 || bits == 24 || bits == 32));
+        int float_ok = (format == WAV_FORMAT_FLOAT && (bits == 32 || bits == 64));
+        if ((!int_ok && !float_ok) || channels == 0 || fmt.sample_rate == 0) {
+            err = CTTS_ERR_INVALID_WAV;
+        }
+    }
+
+    if (err != CTTS_OK) {
+        munmap(map, file_size);
+        return err;
+    }
+
+    size_t frames = data_size / ((size_t)(bits / 8) * channels);
+    int16_t* result = NULL;
+    size_t result_count = 0;
+
+    if (format == WAV_FORMAT_PCM && bits == 16 && fmt.sample_rate == CTTS_SAMPLE_RATE) {
+        /* Native format: copy, or integer downmix (truncating average) */
+        result = malloc((frames ? frames : 1) * sizeof(int16_t));
+        if (!result) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+        } else if (channels == 1) {
+            memcpy(result, data, frames * sizeof(int16_t));
+        } else {
+            for (size_t i = 0; i < frames; i++) {
+                int32_t sum = 0;
+                for (int c = 0; c < channels; c++) {
+                    int16_t v;
+                    memcpy(&v, data + (i * channels + c) * 2, 2);
+                    sum += v;
+                }
+                result[i] = (int16_t)(sum / channels);
+            }
         }
+        result_count = frames;
     } else {
-        /* Stereo: average channels */
-        for (size_t i = 0; i < *sample_count; i++) {
-            int16_t left, right;
-            if (fread(&left, sizeof(int16_t), 1, f) != 1 ||
-                fread(&right, sizeof(int16_t), 1, f) != 1) {
-                free(*samples);
-                fclose(f);
-                return CTTS_ERR_FILE_READ;
+        float* mono = malloc((frames ? frames : 1) * sizeof(float));
+        float* resampled = NULL;
+        if (!mono) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+        } else {
+            wav_decode_mono(data, frames, format, bits, channels, mono);
+            if (fmt.sample_rate != CTTS_SAMPLE_RATE) {
+                err = resample_float(mono, frames, fmt.sample_rate, CTTS_SAMPLE_RATE,
+                                     &resampled, &result_count);
+            } else {
+                resampled = mono;
+                mono = NULL;
+                result_count = frames;
+            }
+        }
+
+        if (err == CTTS_OK) {
+            result = malloc((result_count ? result_count : 1) * sizeof(int16_t));
+            if (!result) {
+                err = CTTS_ERR_OUT_OF_MEMORY;
+            } else {
+                for (size_t i = 0; i < result_count; i++) {
+                    float v = resampled[i];
+                    v = v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v);
+                    result[i] = (int16_t)lrintf(v);
+                }
             }
-            (*samples)[i] = (left + right) / 2;
         }
+        free(mono);
+        free(resampled);
     }
 
-    fclose(f);
+    munmap(map, file_size);
+    if (err != CTTS_OK) {
+        free(result);
+        return err;
+    }
+
+    *samples = result;
+    *sample_count = result_count;
     return CTTS_OK;
 }
 
-int ctts_write_wav(const char* filename, const int16_t* samples,
-                   size_t sample_count, int sample_rate) {
-    FILE* f = fopen(filename, "wb");
-    if (!f) return CTTS_ERR_FILE_WRITE;
-
+/* Canonical 44-byte header for mono 16-bit PCM */
+static void wav_fill_header(uint8_t* out, size_t sample_count, int sample_rate) {
     uint32_t data_size = sample_count * sizeof(int16_t);
     uint32_t file_size = 36 + data_size;
 
-    /* RIFF header */
-    fwrite("RIFF", 1, 4, f);
-    fwrite(&file_size, 4, 1, f);
-    fwrite("WAVE", 1, 4, f);
-
-    /* fmt chunk */
-    fwrite("fmt ", 1, 4, f);
     uint32_t fmt_size = 16;
-    fwrite(&fmt_size, 4, 1, f);
-
     uint16_t audio_format = 1;  /* PCM */
     uint16_t num_channels = 1;  /* Mono */
     uint32_t sr = sample_rate;
@@ -831,16 +1764,34 @@ int ctts_write_wav(const char* filename, const int16_t* samples,
     uint16_t block_align = 2;
     uint16_t bits_per_sample = 16;
 
-    fwrite(&audio_format, 2, 1, f);
-    fwrite(&num_channels, 2, 1, f);
-    fwrite(&sr, 4, 1, f);
-    fwrite(&byte_rate, 4, 1, f);
-    fwrite(&block_align, 2, 1, f);
-    fwrite(&bits_per_sample, 2, 1, f);
+    /* RIFF header */
+    memcpy(out + 0, "RIFF", 4);
+    memcpy(out + 4, &file_size, 4);
+    memcpy(out + 8, "WAVE", 4);
+
+    /* fmt chunk */
+    memcpy(out + 12, "fmt ", 4);
+    memcpy(out + 16, &fmt_size, 4);
+    memcpy(out + 20, &audio_format, 2);
+    memcpy(out + 22, &num_channels, 2);
+    memcpy(out + 24, &sr, 4);
+    memcpy(out + 28, &byte_rate, 4);
+    memcpy(out + 32, &block_align, 2);
+    memcpy(out + 34, &bits_per_sample, 2);
 
     /* data chunk */
-    fwrite("data", 1, 4, f);
-    fwrite(&data_size, 4, 1, f);
+    memcpy(out + 36, "data", 4);
+    memcpy(out + 40, &data_size, 4);
+}
+
+int ctts_write_wav(const char* filename, const int16_t* samples,
+                   size_t sample_count, int sample_rate) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) return CTTS_ERR_FILE_WRITE;
+
+    uint8_t header[CTTS_WAV_HEADER_SIZE];
+    wav_fill_header(header, sample_count, sample_rate);
+    fwrite(header, 1, sizeof(header), f);
     fwrite(samples, sizeof(int16_t), sample_count, f);
 
     fclose(f);
@@ -936,53 +1887,22 @@ static int compare_units(const void* a, const void* b) {
     return strcmp(ua->text, ub->text);
 }
 
-int ctts_build_database(const char* letters_dir, const char* letters_index,
-                        const char* syllables_dir, const char* syllables_index,
-                        const char* output_file) {
-    BuildUnit* letters = NULL;
-    BuildUnit* syllables = NULL;
-    size_t letter_count = 0, syllable_count = 0;
-    int err;
-
-    /* Load letters */
-    err = load_units_from_index(letters_dir, letters_index, &letters, &letter_count);
-    if (err != CTTS_OK) {
-        fprintf(stderr, "Failed to load letters: %s\n", ctts_strerror(err));
-        return err;
-    }
-    printf("Loaded %zu letters\n", letter_count);
-
-    /* Load syllables */
-    err = load_units_from_index(syllables_dir, syllables_index, &syllables, &syllable_count);
-    if (err != CTTS_OK) {
-        fprintf(stderr, "Failed to load syllables: %s\n", ctts_strerror(err));
-        /* Continue with just letters */
-    } else {
-        printf("Loaded %zu syllables\n", syllable_count);
-    }
-
-    /* Merge and sort */
-    size_t total_count = letter_count + syllable_count;
-    BuildUnit* all_units = malloc(total_count * sizeof(BuildUnit));
-    if (!all_units) {
-        err = CTTS_ERR_OUT_OF_MEMORY;
-        goto cleanup;
-    }
-
-    memcpy(all_units, letters, letter_count * sizeof(BuildUnit));
-    memcpy(all_units + letter_count, syllables, syllable_count * sizeof(BuildUnit));
-    qsort(all_units, total_count, sizeof(BuildUnit), compare_units);
-
+/*
+ * Write a database file from units sorted for longest-match.
+ * Builds the index, hash table (with chaining), string pool and audio data.
+ */
+static int write_database(const char* output_file, const BuildUnit* units,
+                          size_t total_count) {
     /* Calculate sizes */
     size_t strings_size = 0;
     size_t audio_samples = 0;
     size_t max_chars = 0;
 
     for (size_t i = 0; i < total_count; i++) {
-        strings_size += all_units[i].text_len + 1;
-        audio_samples += all_units[i].sample_count;
-        if (all_units[i].char_count > max_chars)
-            max_chars = all_units[i].char_count;
+        strings_size += units[i].text_len + 1;
+        audio_samples += units[i].sample_count;
+        if (units[i].char_count > max_chars)
+            max_chars = units[i].char_count;
     }
 
     /* Calculate hash table size (next power of 2, with load factor) */
@@ -992,16 +1912,14 @@ int ctts_build_database(const char* letters_dir, const char* letters_index,
 
     /* Create file */
     FILE* out = fopen(output_file, "wb");
-    if (!out) {
-        err = CTTS_ERR_FILE_WRITE;
-        goto cleanup;
-    }
+    if (!out) return CTTS_ERR_FILE_WRITE;
 
     /* Calculate offsets */
     size_t index_offset = sizeof(CTTSHeader);
     size_t hash_table_offset = index_offset + total_count * sizeof(CTTSIndexEntry);
     size_t strings_offset = hash_table_offset + hash_table_size * sizeof(uint32_t);
-    size_t audio_offset = strings_offset + strings_size;
+    size_t audio_offset = (strings_offset + strings_size + DB_AUDIO_ALIGN - 1) &
+                          ~(size_t)(DB_AUDIO_ALIGN - 1);
 
     /* Write header */
     CTTSHeader header = {
@@ -1021,14 +1939,13 @@ int ctts_build_database(const char* letters_dir, const char* letters_index,
     fwrite(&header, sizeof(header), 1, out);
 
     /* Build index and write */
-    CTTSIndexEntry* index = calloc(total_count, sizeof(CTTSIndexEntry));
+    CTTSIndexEntry* index = calloc(total_count ? total_count : 1, sizeof(CTTSIndexEntry));
     uint32_t* hash_table = calloc(hash_table_size, sizeof(uint32_t));
     if (!index || !hash_table) {
         free(index);
         free(hash_table);
         fclose(out);
-        err = CTTS_ERR_OUT_OF_MEMORY;
-        goto cleanup;
+        return CTTS_ERR_OUT_OF_MEMORY;
     }
 
     /* Initialize hash table to "empty" (-1) */
@@ -1038,7 +1955,7 @@ int ctts_build_database(const char* letters_dir, const char* letters_index,
     size_t audio_pos = 0;
 
     for (size_t i = 0; i < total_count; i++) {
-        BuildUnit* unit = &all_units[i];
+        const BuildUnit* unit = &units[i];
         CTTSIndexEntry* entry = &index[i];
 
         entry->hash = unit->hash;
@@ -1070,19 +1987,75 @@ int ctts_build_database(const char* letters_dir, const char* letters_index,
 
     /* Write string pool */
     for (size_t i = 0; i < total_count; i++) {
-        fwrite(all_units[i].text, 1, all_units[i].text_len + 1, out);
+        fwrite(units[i].text, 1, units[i].text_len + 1, out);
     }
 
+    /* Pad so the int16 audio starts on a cache line */
+    static const char zero_pad[DB_AUDIO_ALIGN];
+    fwrite(zero_pad, 1, audio_offset - strings_offset - strings_size, out);
+
     /* Write audio data */
     for (size_t i = 0; i < total_count; i++) {
-        fwrite(all_units[i].samples, sizeof(int16_t),
-               all_units[i].sample_count, out);
+        fwrite(units[i].samples, sizeof(int16_t),
+               units[i].sample_count, out);
     }
 
-    fclose(out);
+    int write_failed = ferror(out);
+    if (fclose(out) != 0) write_failed = 1;
     free(index);
     free(hash_table);
 
+    return write_failed ? CTTS_ERR_FILE_WRITE : CTTS_OK;
+}
+
+int ctts_build_database(const char* letters_dir, const char* letters_index,
+                        const char* syllables_dir, const char* syllables_index,
+                        const char* output_file) {
+    BuildUnit* letters = NULL;
+    BuildUnit* syllables = NULL;
+    size_t letter_count = 0, syllable_count = 0;
+    int err;
+
+    /* Load letters */
+    err = load_units_from_index(letters_dir, letters_index, &letters, &letter_count);
+    if (err != CTTS_OK) {
+        fprintf(stderr, "Failed to load letters: %s\n", ctts_strerror(err));
+        return err;
+    }
+    printf("Loaded %zu letters\n", letter_count);
+
+    /* Load syllables */
+    err = load_units_from_index(syllables_dir, syllables_index, &syllables, &syllable_count);
+    if (err != CTTS_OK) {
+        fprintf(stderr, "Failed to load syllables: %s\n", ctts_strerror(err));
+        /* Continue with just letters */
+    } else {
+        printf("Loaded %zu syllables\n", syllable_count);
+    }
+
+    /* Merge and sort */
+    size_t total_count = letter_count + syllable_count;
+    BuildUnit* all_units = malloc(total_count * sizeof(BuildUnit));
+    if (!all_units) {
+        err = CTTS_ERR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+
+    memcpy(all_units, letters, letter_count * sizeof(BuildUnit));
+    memcpy(all_units + letter_count, syllables, syllable_count * sizeof(BuildUnit));
+    qsort(all_units, total_count, sizeof(BuildUnit), compare_units);
+
+    err = write_database(output_file, all_units, total_count);
+    if (err != CTTS_OK) goto cleanup;
+
+    size_t max_chars = 0;
+    size_t audio_samples = 0;
+    for (size_t i = 0; i < total_count; i++) {
+        audio_samples += all_units[i].sample_count;
+        if (all_units[i].char_count > max_chars)
+            max_chars = all_units[i].char_count;
+    }
+
     printf("Database written to %s\n", output_file);
     printf("  Units: %zu\n", total_count);
     printf("  Max unit length: %zu characters\n", max_chars);
@@ -1206,7 +2179,9 @@ void ctts_config_defaults(CTTSConfig* config) {
     config->default_speed = CTTS_DEFAULT_SPEED;
     config->min_speed = CTTS_MIN_SPEED;
     config->max_speed = CTTS_MAX_SPEED;
+    config->stretch_mode = CTTS_STRETCH_WSOLA;
     config->max_pitch_change = 0.10f;  /* ±10% maximum pitch change */
+    config->pitch_interp = CTTS_PITCH_LINEAR;
     config->print_units = 0;
     config->print_timing = 0;
 }
@@ -1282,8 +2257,14 @@ static void parse_config_line(CTTSConfig* config, const char* line) {
         config->min_speed = strtof(value, NULL);
     } else if (strcmp(k, "max_speed") == 0) {
         config->max_speed = strtof(value, NULL);
+    } else if (strcmp(k, "stretch_mode") == 0) {
+        config->stretch_mode = (strcmp(value, "psola") == 0) ? CTTS_STRETCH_PSOLA
+                                                              : CTTS_STRETCH_WSOLA;
     } else if (strcmp(k, "max_pitch_change") == 0) {
         config->max_pitch_change = strtof(value, NULL);
+    } else if (strcmp(k, "pitch_interpolation") == 0) {
+        config->pitch_interp = (strcmp(value, "cubic") == 0) ? CTTS_PITCH_CUBIC
+                                                             : CTTS_PITCH_LINEAR;
     } else if (strcmp(k, "print_units") == 0) {
         config->print_units = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
     } else if (strcmp(k, "print_timing") == 0) {
@@ -1353,22 +2334,24 @@ static int find_unit(CTTS* engine, const char* text, size_t len) {
     return -1;
 }
 
-/* Find the longest matching unit starting at pos, returns byte length or 0 */
-static size_t find_longest_match(CTTS* engine, const char* pos, size_t max_chars) {
-    size_t remaining = strlen(pos);
-    size_t try_chars = max_chars;
-    if (try_chars > remaining) try_chars = remaining;
-
-    /* Calculate byte position for try_chars characters */
+/*
+ * Find the longest matching unit starting at pos, returns byte length or 0.
+ * If out_unit_idx is not NULL it receives the matched unit index (or -1).
+ */
+static size_t find_longest_match(CTTS* engine, const char* pos, size_t max_chars,
+                                 int* out_unit_idx) {
+    /* Calculate byte position for up to max_chars characters */
     const char* end = pos;
-    for (size_t c = 0; c < try_chars && *end; c++) {
+    for (size_t c = 0; c < max_chars && *end; c++) {
         end += utf8_char_len(end);
     }
 
     /* Try decreasing lengths */
     while (end > pos) {
         size_t try_len = end - pos;
-        if (find_unit(engine, pos, try_len) >= 0) {
+        int unit_idx = find_unit(engine, pos, try_len);
+        if (unit_idx >= 0) {
+            if (out_unit_idx) *out_unit_idx = unit_idx;
             return try_len;
         }
 
@@ -1383,6 +2366,7 @@ static size_t find_longest_match(CTTS* engine, const char* pos, size_t max_chars
         end = prev_end;
     }
 
+    if (out_unit_idx) *out_unit_idx = -1;
     return 0;
 }
 
@@ -1406,23 +2390,19 @@ static int pt_syllable_score(const char* text, size_t byte_len, size_t char_coun
 static size_t find_best_match_with_lookahead(CTTS* engine, const char* pos,
                                               size_t max_chars, int* out_unit_idx,
                                               int at_word_start) {
-    size_t remaining_bytes = strlen(pos);
-    if (remaining_bytes == 0) {
+    if (*pos == '\0') {
         *out_unit_idx = -1;
         return 0;
     }
 
-    /* Count remaining characters */
-    size_t remaining_chars = 0;
+    /* Count remaining characters (only up to max_chars are ever tried) */
+    size_t try_chars = 0;
     const char* tmp = pos;
-    while (*tmp) {
-        remaining_chars++;
+    while (*tmp && try_chars < max_chars) {
+        try_chars++;
         tmp += utf8_char_len(tmp);
     }
 
-    size_t try_chars = max_chars;
-    if (try_chars > remaining_chars) try_chars = remaining_chars;
-
     /* Collect all possible matches at current position */
     typedef struct {
         size_t byte_len;
@@ -1490,7 +2470,8 @@ static size_t find_best_match_with_lookahead(CTTS* engine, const char* pos,
             next_pos++;
         }
         if (*next_pos) {
-            candidates[i].next_match_len = find_longest_match(engine, next_pos, max_chars);
+            candidates[i].next_match_len = find_longest_match(engine, next_pos,
+                                                              max_chars, NULL);
         }
     }
 
@@ -1626,27 +2607,66 @@ static float hanning(size_t i, size_t N) {
 }
 
 /*
- * Remove silence regions from audio buffer.
- * Silence is detected as regions where amplitude is below threshold.
- * Only removes silence longer than min_silence_samples.
- * Returns the new sample count.
+ * Silence detection kernels. Magnitudes follow the int16 reference:
+ * |x| is taken without widening, so -32768 stays -32768 and counts as
+ * silence, exactly as remove_silence_samplewise() classifies it.
  */
-static size_t remove_silence_regions(int16_t* samples, size_t count,
-                                      float threshold, size_t min_silence_samples) {
-    if (count == 0) return 0;
-
-    /* Find max amplitude for relative threshold */
-    int16_t max_amp = 0;
-    for (size_t i = 0; i < count; i++) {
-        int16_t abs_val = samples[i] > 0 ? samples[i] : -samples[i];
-        if (abs_val > max_amp) max_amp = abs_val;
-    }
 
-    if (max_amp == 0) return count;
+/* Largest |x| (0 for an empty or all-silent buffer) */
+static int16_t peak_abs16(const int16_t* x, size_t n) {
+    int16_t peak = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i vmax = zero;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+        vmax = _mm_max_epi16(vmax, _mm_max_epi16(v, _mm_sub_epi16(zero, v)));
+    }
+    vmax = _mm_max_epi16(vmax, _mm_srli_si128(vmax, 8));
+    vmax = _mm_max_epi16(vmax, _mm_srli_si128(vmax, 4));
+    vmax = _mm_max_epi16(vmax, _mm_srli_si128(vmax, 2));
+    peak = (int16_t)_mm_cvtsi128_si32(vmax);
+#endif
+    for (; i < n; i++) {
+        int16_t abs_val = x[i] > 0 ? x[i] : -x[i];
+        if (abs_val > peak) peak = abs_val;
+    }
+    return peak;
+}
 
-    /* Calculate absolute threshold */
-    int16_t abs_threshold = (int16_t)(max_amp * threshold);
+/*
+ * First index >= pos whose class differs from the run being scanned:
+ * the first loud sample (|x| > threshold) when silent is set, otherwise
+ * the first silent one. Returns n if the run reaches the end.
+ */
+static size_t silence_run_end(const int16_t* x, size_t pos, size_t n,
+                              int16_t threshold, int silent) {
+    size_t i = pos;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i thr = _mm_set1_epi16(threshold);
+    unsigned flip = silent ? 0u : 0xFFFFu;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(x + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(x + i + 8));
+        a = _mm_cmpgt_epi16(_mm_max_epi16(a, _mm_sub_epi16(zero, a)), thr);
+        b = _mm_cmpgt_epi16(_mm_max_epi16(b, _mm_sub_epi16(zero, b)), thr);
+        /* One bit per sample, set where the run ends */
+        unsigned ends = ((unsigned)_mm_movemask_epi8(_mm_packs_epi16(a, b)) ^ flip) & 0xFFFFu;
+        if (ends) return i + (size_t)__builtin_ctz(ends);
+    }
+#endif
+    for (; i < n; i++) {
+        int16_t abs_val = x[i] > 0 ? x[i] : -x[i];
+        if ((abs_val > threshold) == silent) return i;
+    }
+    return n;
+}
 
+/* Sample-at-a-time reference; also handles keep > min_silence_samples */
+static size_t remove_silence_samplewise(int16_t* samples, size_t count,
+                                        int16_t abs_threshold, size_t min_silence_samples) {
     /* Find and remove silence regions */
     size_t write_pos = 0;
     size_t read_pos = 0;
@@ -1689,6 +2709,57 @@ static size_t remove_silence_regions(int16_t* samples, size_t count,
     return write_pos;
 }
 
+/*
+ * Remove silence regions from audio buffer.
+ * Silence is detected as regions where amplitude is below threshold.
+ * Only removes silence longer than min_silence_samples.
+ * Returns the new sample count.
+ *
+ * Works on runs: each silence run is located with silence_run_end() and
+ * the audio kept between long silences is moved with one memmove. The
+ * output is that of remove_silence_samplewise(), which still serves
+ * min_silence_samples below 10, where the kept lead-in is longer than
+ * the silence it replaces.
+ */
+static size_t remove_silence_regions(int16_t* samples, size_t count,
+                                      float threshold, size_t min_silence_samples) {
+    if (count == 0) return 0;
+
+    /* Find max amplitude for relative threshold */
+    int16_t max_amp = peak_abs16(samples, count);
+    if (max_amp == 0) return count;
+
+    /* Calculate absolute threshold */
+    int16_t abs_threshold = (int16_t)(max_amp * threshold);
+
+    /* Keep a tiny bit of each long silence for smooth transition */
+    size_t keep = min_silence_samples / 4;
+    if (keep < 10) keep = 10;
+    if (keep > min_silence_samples) {
+        return remove_silence_samplewise(samples, count, abs_threshold, min_silence_samples);
+    }
+
+    size_t write_pos = 0;
+    size_t kept_start = 0;      /* Start of the audio not yet moved into place */
+    size_t pos = 0;
+    while (pos < count) {
+        size_t silence_start = silence_run_end(samples, pos, count, abs_threshold, 0);
+        if (silence_start == count) break;
+        size_t silence_end = silence_run_end(samples, silence_start, count, abs_threshold, 1);
+
+        if (silence_end - silence_start >= min_silence_samples) {
+            size_t kept_end = silence_start + keep;
+            memmove(samples + write_pos, samples + kept_start,
+                    (kept_end - kept_start) * sizeof(int16_t));
+            write_pos += kept_end - kept_start;
+            kept_start = silence_end;
+        }
+        pos = silence_end;
+    }
+    memmove(samples + write_pos, samples + kept_start, (count - kept_start) * sizeof(int16_t));
+    return write_pos + (count - kept_start);
+}
+
 /* ============================================================================
  * Energy Normalization
  * ============================================================================ */
@@ -1892,47 +2963,194 @@ static float get_adaptive_crossfade(PhonemeType prev_end, PhonemeType next_start
 }
 
 /* ============================================================================
- * Pitch Estimation and Smoothing
+ * Correlation Kernel
+ *
+ * Dot product and energies of int16 signals as exact integer sums, shared
+ * by pitch estimation, pitch marking and the WSOLA search. pmaddwd
+ * multiplies sample pairs and adds them into 32-bit lanes, which are
+ * widened into 64-bit accumulators after every step (one step can reach
+ * 2^31). Samples are clamped to -32767 so that no lane can wrap. The AVX2
+ * kernel (16 samples per step) is chosen at run time when the CPU has it.
+ * SSE2 (8 per step) is the x86-64 baseline, and other targets run the
+ * scalar loop. All three return identical sums.
  * ============================================================================ */
 
-/* Simple autocorrelation-based pitch estimation */
-static float estimate_pitch(const int16_t* samples, size_t count) {
-    if (count < 200) return 0.0f;  /* Need enough samples */
-
-    /* Search for pitch in range 80-400 Hz (male to child voice) */
-    size_t min_lag = CTTS_SAMPLE_RATE / 400;  /* ~55 samples at 22050 Hz */
-    size_t max_lag = CTTS_SAMPLE_RATE / 80;   /* ~275 samples */
+#define CORR_ENERGY_A 1     /* Also sum a[i]^2 */
+#define CORR_ENERGY_B 2     /* Also sum b[i]^2 */
 
-    if (max_lag > count / 2) max_lag = count / 2;
+typedef struct {
+    int64_t dot;            /* Sum of a[i] * b[i] */
+    int64_t energy_a;       /* Sum of a[i]^2, if requested */
+    int64_t energy_b;       /* Sum of b[i]^2, if requested */
+} Correlation;
 
-    /* Use first 10ms for analysis */
-    size_t analysis_len = CTTS_SAMPLE_RATE / 100;
-    if (analysis_len > count - max_lag) analysis_len = count - max_lag;
+typedef Correlation (*CorrelateFn)(const int16_t* a, const int16_t* b, size_t len, int what);
 
-    float best_corr = 0.0f;
-    size_t best_lag = 0;
+static int32_t corr_sample(int16_t x) {
+    return x < -32767 ? -32767 : x;
+}
 
-    for (size_t lag = min_lag; lag <= max_lag; lag++) {
-        float corr = 0.0f;
-        float energy1 = 0.0f;
-        float energy2 = 0.0f;
+static Correlation correlate_scalar(const int16_t* a, const int16_t* b, size_t len, int what) {
+    Correlation c = {0, 0, 0};
+    for (size_t i = 0; i < len; i++) {
+        int32_t x = corr_sample(a[i]);
+        int32_t y = corr_sample(b[i]);
+        c.dot += x * y;
+        if (what & CORR_ENERGY_A) c.energy_a += x * x;
+        if (what & CORR_ENERGY_B) c.energy_b += y * y;
+    }
+    return c;
+}
 
-        for (size_t i = 0; i < analysis_len; i++) {
-            float s1 = samples[i];
-            float s2 = samples[i + lag];
-            corr += s1 * s2;
-            energy1 += s1 * s1;
-            energy2 += s2 * s2;
-        }
+#if defined(__SSE2__)
+/* Add the four int32 lanes of v, sign-extended, to the two int64 lanes of acc */
+static inline __m128i corr_widen_add(__m128i acc, __m128i v) {
+    __m128i sign = _mm_srai_epi32(v, 31);
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+    return _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+}
 
-        float norm = sqrtf(energy1 * energy2);
-        if (norm > 0) corr /= norm;
+static int64_t corr_sum64(__m128i acc) {
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return lanes[0] + lanes[1];
+}
 
-        if (corr > best_corr) {
-            best_corr = corr;
-            best_lag = lag;
+static Correlation correlate_sse2(const int16_t* a, const int16_t* b, size_t len, int what) {
+    const __m128i floor16 = _mm_set1_epi16(-32767);
+    __m128i dot = _mm_setzero_si128();
+    __m128i ea = _mm_setzero_si128();
+    __m128i eb = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i x = _mm_max_epi16(_mm_loadu_si128((const __m128i*)(a + i)), floor16);
+        __m128i y = _mm_max_epi16(_mm_loadu_si128((const __m128i*)(b + i)), floor16);
+        dot = corr_widen_add(dot, _mm_madd_epi16(x, y));
+        if (what & CORR_ENERGY_A) ea = corr_widen_add(ea, _mm_madd_epi16(x, x));
+        if (what & CORR_ENERGY_B) eb = corr_widen_add(eb, _mm_madd_epi16(y, y));
+    }
+    Correlation tail = correlate_scalar(a + i, b + i, len - i, what);
+    tail.dot += corr_sum64(dot);
+    tail.energy_a += corr_sum64(ea);
+    tail.energy_b += corr_sum64(eb);
+    return tail;
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2")))
+static Correlation correlate_avx2(const int16_t* a, const int16_t* b, size_t len, int what) {
+    const __m256i floor16 = _mm256_set1_epi16(-32767);
+    __m256i dot = _mm256_setzero_si256();
+    __m256i ea = _mm256_setzero_si256();
+    __m256i eb = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i x = _mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(a + i)), floor16);
+        __m256i y = _mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(b + i)), floor16);
+        __m256i p = _mm256_madd_epi16(x, y);
+        dot = _mm256_add_epi64(dot, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(p)));
+        dot = _mm256_add_epi64(dot, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(p, 1)));
+        if (what & CORR_ENERGY_A) {
+            __m256i e = _mm256_madd_epi16(x, x);
+            ea = _mm256_add_epi64(ea, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(e)));
+            ea = _mm256_add_epi64(ea, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(e, 1)));
+        }
+        if (what & CORR_ENERGY_B) {
+            __m256i e = _mm256_madd_epi16(y, y);
+            eb = _mm256_add_epi64(eb, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(e)));
+            eb = _mm256_add_epi64(eb, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(e, 1)));
+        }
+    }
+    int64_t lanes[4];
+    Correlation tail = correlate_scalar(a + i, b + i, len - i, what);
+    _mm256_storeu_si256((__m256i*)lanes, dot);
+    tail.dot += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_si256((__m256i*)lanes, ea);
+    tail.energy_a += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_si256((__m256i*)lanes, eb);
+    tail.energy_b += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return tail;
+}
+#endif
+
+static CorrelateFn correlate_impl = correlate_scalar;
+static pthread_once_t correlate_once = PTHREAD_ONCE_INIT;
+
+static void init_correlate(void) {
+#if defined(__SSE2__)
+    correlate_impl = correlate_sse2;
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) correlate_impl = correlate_avx2;
+#endif
+}
+
+/* Dot product of a and b over len samples, plus the energies selected by what */
+static Correlation correlate(const int16_t* a, const int16_t* b, size_t len, int what) {
+    pthread_once(&correlate_once, init_correlate);
+    return correlate_impl(a, b, len, what);
+}
+
+/* Normalized correlation from integer sums; 0 when either signal is silent */
+static float correlation_coefficient(int64_t dot, int64_t energy_a, int64_t energy_b) {
+    double denom = sqrt((double)energy_a * (double)energy_b);
+    return denom > 0.0 ? (float)((double)dot / denom) : 0.0f;
+}
+
+/*
+ * Best lag in [min_lag, max_lag] by normalized autocorrelation of the len
+ * samples at x against x + lag. The lagged energy slides from one lag to
+ * the next instead of being summed again. Returns 0 when no lag reaches a
+ * positive correlation; *best_corr receives the winning coefficient.
+ */
+static size_t best_autocorrelation_lag(const int16_t* x, size_t len, size_t min_lag,
+                                       size_t max_lag, float* best_corr) {
+    *best_corr = 0.0f;
+    if (min_lag > max_lag) return 0;
+
+    Correlation first = correlate(x, x + min_lag, len, CORR_ENERGY_A | CORR_ENERGY_B);
+    int64_t energy = first.energy_b;
+    size_t best_lag = 0;
+
+    for (size_t lag = min_lag; lag <= max_lag; lag++) {
+        int64_t dot = first.dot;
+        if (lag > min_lag) {
+            int32_t out = corr_sample(x[lag - 1]);
+            int32_t in = corr_sample(x[lag + len - 1]);
+            energy += (int64_t)in * in - (int64_t)out * out;
+            dot = correlate(x, x + lag, len, 0).dot;
+        }
+        float corr = correlation_coefficient(dot, first.energy_a, energy);
+        if (corr > *best_corr) {
+            *best_corr = corr;
+            best_lag = lag;
         }
     }
+    return best_lag;
+}
+
+/* ============================================================================
+ * Pitch Estimation and Smoothing
+ * ============================================================================ */
+
+/* Simple autocorrelation-based pitch estimation */
+static float estimate_pitch(const int16_t* samples, size_t count) {
+    if (count < 200) return 0.0f;  /* Need enough samples */
+
+    /* Search for pitch in range 80-400 Hz (male to child voice) */
+    size_t min_lag = CTTS_SAMPLE_RATE / 400;  /* ~55 samples at 22050 Hz */
+    size_t max_lag = CTTS_SAMPLE_RATE / 80;   /* ~275 samples */
+
+    if (max_lag > count / 2) max_lag = count / 2;
+
+    /* Use first 10ms for analysis */
+    size_t analysis_len = CTTS_SAMPLE_RATE / 100;
+    if (analysis_len > count - max_lag) analysis_len = count - max_lag;
+
+    float best_corr;
+    size_t best_lag = best_autocorrelation_lag(samples, analysis_len, min_lag, max_lag,
+                                               &best_corr);
 
     /* Only return pitch if correlation is strong enough */
     if (best_corr > 0.3f && best_lag > 0) {
@@ -1942,6 +3160,179 @@ static float estimate_pitch(const int16_t* samples, size_t count) {
     return 0.0f;  /* Unvoiced or unable to estimate */
 }
 
+/* ============================================================================
+ * Fractional Resampling Kernel
+ *
+ * Reads a signal at positions i * step for the pitch contour and pitch
+ * shift stages, eight outputs per block. With SSE2, positions and fractions
+ * are computed as vectors and the taps inserted lane by lane; interpolation,
+ * window, clamp and int16 conversion run on four-float vectors. Blocks that
+ * reach the end of the span, partial blocks and non-SSE2 builds go through
+ * frac_gather() and scalar arithmetic. Linear output is bit-identical to the
+ * per-sample form a * (1 - f) + b * f.
+ * ============================================================================ */
+
+#define FRAC_BLOCK 8
+
+/* Catmull-Rom through y0..y3, at fraction t of the way from y1 to y2 */
+static float cubic_interp(float y0, float y1, float y2, float y3, float t) {
+    float a = -0.5f * y0 + 1.5f * y1 - 1.5f * y2 + 0.5f * y3;
+    float b = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3;
+    float c = 0.5f * (y2 - y0);
+    return ((a * t + b) * t + c) * t + y1;
+}
+
+/*
+ * Gather taps for outputs first..first+lanes-1. Positions whose taps fit in
+ * span samples from pos interpolate; later ones repeat the nearest sample
+ * (clamped to count) with a zero fraction. Cubic taps are clamped to the
+ * buffer.
+ */
+static void frac_gather(const int16_t* x, size_t count, size_t pos, size_t span, float step,
+                        size_t first, size_t lanes, int cubic,
+                        float taps[4][FRAC_BLOCK], float* frac) {
+    for (size_t k = 0; k < lanes; k++) {
+        float src = (float)(first + k) * step;
+        size_t idx = (size_t)src;
+        size_t j = pos + idx;
+        if (idx + 1 < span) {
+            frac[k] = src - idx;
+            taps[1][k] = x[j];
+            taps[2][k] = x[j + 1];
+            if (cubic) {
+                taps[0][k] = x[j > 0 ? j - 1 : 0];
+                taps[3][k] = x[j + 2 < count ? j + 2 : count - 1];
+            }
+        } else {
+            float y = x[j < count ? j : count - 1];
+            frac[k] = 0.0f;
+            taps[0][k] = taps[1][k] = taps[2][k] = taps[3][k] = y;
+        }
+    }
+}
+
+#if defined(__SSE2__)
+/* p[idx[k] + offset] for eight lanes, inserted word by word */
+static inline __m128i frac_taps8(const int16_t* p, const int32_t* idx, int offset) {
+    __m128i v = _mm_cvtsi32_si128((uint16_t)p[idx[0] + offset]);
+    v = _mm_insert_epi16(v, p[idx[1] + offset], 1);
+    v = _mm_insert_epi16(v, p[idx[2] + offset], 2);
+    v = _mm_insert_epi16(v, p[idx[3] + offset], 3);
+    v = _mm_insert_epi16(v, p[idx[4] + offset], 4);
+    v = _mm_insert_epi16(v, p[idx[5] + offset], 5);
+    v = _mm_insert_epi16(v, p[idx[6] + offset], 6);
+    return _mm_insert_epi16(v, p[idx[7] + offset], 7);
+}
+
+/* Low and high four int16 lanes as floats */
+static inline __m128 frac_lo_ps(__m128i v) {
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+}
+
+static inline __m128 frac_hi_ps(__m128i v) {
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+}
+#endif
+
+/*
+ * n outputs of x read from pos at positions i * step (see frac_gather()).
+ * With a window, out[i] += (int16_t)(y * window[i]); without, out[i] = y.
+ */
+static void resample_frac(const int16_t* x, size_t count, size_t pos, size_t span,
+                          float step, size_t n, const float* window, int cubic,
+                          int16_t* out) {
+    float taps[4][FRAC_BLOCK];
+    float frac[FRAC_BLOCK];
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    const __m128 vstep = _mm_set1_ps(step);
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    for (; i + FRAC_BLOCK <= n; i += FRAC_BLOCK) {
+        __m128 t[2], y0[2], y1[2], y2[2], y3[2];
+        size_t last = (size_t)((float)(i + FRAC_BLOCK - 1) * step);
+        if (last + 1 < span && (!cubic || (pos + (size_t)((float)i * step) > 0 &&
+                                           pos + last + 2 < count))) {
+            /* Every lane interpolates: positions and fractions as vectors */
+            int32_t idx[FRAC_BLOCK];
+            for (int h = 0; h < 2; h++) {
+                __m128i n4 = _mm_add_epi32(_mm_set1_epi32((int32_t)(i + 4 * h)), lane);
+                __m128 src = _mm_mul_ps(_mm_cvtepi32_ps(n4), vstep);
+                __m128i whole = _mm_cvttps_epi32(src);
+                t[h] = _mm_sub_ps(src, _mm_cvtepi32_ps(whole));
+                _mm_storeu_si128((__m128i*)(idx + 4 * h), whole);
+            }
+            const int16_t* p = x + pos;
+            __m128i g1 = frac_taps8(p, idx, 0), g2 = frac_taps8(p, idx, 1);
+            y1[0] = frac_lo_ps(g1);
+            y1[1] = frac_hi_ps(g1);
+            y2[0] = frac_lo_ps(g2);
+            y2[1] = frac_hi_ps(g2);
+            if (cubic) {
+                __m128i g0 = frac_taps8(p, idx, -1), g3 = frac_taps8(p, idx, 2);
+                y0[0] = frac_lo_ps(g0);
+                y0[1] = frac_hi_ps(g0);
+                y3[0] = frac_lo_ps(g3);
+                y3[1] = frac_hi_ps(g3);
+            }
+        } else {
+            frac_gather(x, count, pos, span, step, i, FRAC_BLOCK, cubic, taps, frac);
+            for (int h = 0; h < 2; h++) {
+                t[h] = _mm_loadu_ps(frac + 4 * h);
+                y0[h] = _mm_loadu_ps(taps[0] + 4 * h);
+                y1[h] = _mm_loadu_ps(taps[1] + 4 * h);
+                y2[h] = _mm_loadu_ps(taps[2] + 4 * h);
+                y3[h] = _mm_loadu_ps(taps[3] + 4 * h);
+            }
+        }
+
+        __m128i half[2];
+        for (int h = 0; h < 2; h++) {
+            __m128 y;
+            if (cubic) {
+                __m128 a = _mm_add_ps(_mm_sub_ps(_mm_add_ps(
+                               _mm_mul_ps(_mm_set1_ps(-0.5f), y0[h]),
+                               _mm_mul_ps(_mm_set1_ps(1.5f), y1[h])),
+                               _mm_mul_ps(_mm_set1_ps(1.5f), y2[h])),
+                               _mm_mul_ps(_mm_set1_ps(0.5f), y3[h]));
+                __m128 b = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(
+                               y0[h], _mm_mul_ps(_mm_set1_ps(2.5f), y1[h])),
+                               _mm_mul_ps(_mm_set1_ps(2.0f), y2[h])),
+                               _mm_mul_ps(_mm_set1_ps(0.5f), y3[h]));
+                __m128 c = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_sub_ps(y2[h], y0[h]));
+                y = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(
+                        _mm_add_ps(_mm_mul_ps(a, t[h]), b), t[h]), c), t[h]), y1[h]);
+            } else {
+                y = _mm_add_ps(_mm_mul_ps(y1[h], _mm_sub_ps(one, t[h])), _mm_mul_ps(y2[h], t[h]));
+            }
+            y = _mm_min_ps(_mm_max_ps(y, lo), hi);
+            if (window) y = _mm_mul_ps(y, _mm_loadu_ps(window + i + 4 * h));
+            half[h] = _mm_cvttps_epi32(y);
+        }
+        __m128i v = _mm_packs_epi32(half[0], half[1]);
+        if (window) v = _mm_add_epi16(v, _mm_loadu_si128((const __m128i*)(out + i)));
+        _mm_storeu_si128((__m128i*)(out + i), v);
+    }
+#endif
+
+    while (i < n) {
+        size_t lanes = (n - i < FRAC_BLOCK) ? n - i : FRAC_BLOCK;
+        frac_gather(x, count, pos, span, step, i, lanes, cubic, taps, frac);
+        for (size_t k = 0; k < lanes; k++) {
+            float y = cubic ? cubic_interp(taps[0][k], taps[1][k], taps[2][k], taps[3][k], frac[k])
+                            : taps[1][k] * (1.0f - frac[k]) + taps[2][k] * frac[k];
+            if (y < -32768.0f) y = -32768.0f;
+            if (y > 32767.0f) y = 32767.0f;
+            if (window) out[i + k] += (int16_t)(y * window[i + k]);
+            else out[i + k] = (int16_t)y;
+        }
+        i += lanes;
+    }
+}
+
 /* Apply pitch shift using simple resampling (for small adjustments) */
 static void apply_pitch_shift(int16_t* samples, size_t count, float factor) {
     if (factor < 0.9f || factor > 1.1f || count < 100) return;  /* Limit to ±10% */
@@ -1951,17 +3342,7 @@ static void apply_pitch_shift(int16_t* samples, size_t count, float factor) {
     int16_t* temp = malloc(new_count * sizeof(int16_t));
     if (!temp) return;
 
-    for (size_t i = 0; i < new_count; i++) {
-        float src_pos = i * factor;
-        size_t idx = (size_t)src_pos;
-        float frac = src_pos - idx;
-
-        if (idx + 1 < count) {
-            temp[i] = (int16_t)(samples[idx] * (1.0f - frac) + samples[idx + 1] * frac);
-        } else if (idx < count) {
-            temp[i] = samples[idx];
-        }
-    }
+    resample_frac(samples, count, 0, count, factor, new_count, NULL, 0, temp);
 
     /* Copy back (only up to original count) */
     size_t copy_count = (new_count < count) ? new_count : count;
@@ -2039,13 +3420,14 @@ static void smooth_pitch_boundary(int16_t* prev_samples, size_t prev_count,
  * 5. Overlap-add with smooth blending
  */
 
-/* Find pitch period at a specific position */
-static size_t find_pitch_period(const int16_t* samples, size_t count, size_t pos) {
-    if (pos + 600 > count) return 0;
+/* Search for pitch in range 80-400 Hz */
+#define PITCH_MIN_PERIOD (CTTS_SAMPLE_RATE / 400)   /* ~55 samples */
+#define PITCH_MAX_PERIOD (CTTS_SAMPLE_RATE / 80)    /* ~275 samples */
 
-    /* Search for pitch in range 80-400 Hz */
-    size_t min_period = CTTS_SAMPLE_RATE / 400;  /* ~55 samples */
-    size_t max_period = CTTS_SAMPLE_RATE / 80;   /* ~275 samples */
+/* Best period in [min_period, max_period] at pos, 0 if unvoiced */
+static size_t pitch_period_in_range(const int16_t* samples, size_t count, size_t pos,
+                                    size_t min_period, size_t max_period) {
+    if (pos + 600 > count) return 0;
 
     size_t analysis_len = 200;
     if (pos + analysis_len + max_period > count) {
@@ -2053,30 +3435,9 @@ static size_t find_pitch_period(const int16_t* samples, size_t count, size_t pos
     }
     if (analysis_len < 100) return 0;
 
-    float best_corr = 0.0f;
-    size_t best_period = 0;
-
-    for (size_t period = min_period; period <= max_period; period++) {
-        float corr = 0.0f;
-        float energy1 = 0.0f;
-        float energy2 = 0.0f;
-
-        for (size_t i = 0; i < analysis_len; i++) {
-            float s1 = samples[pos + i];
-            float s2 = samples[pos + i + period];
-            corr += s1 * s2;
-            energy1 += s1 * s1;
-            energy2 += s2 * s2;
-        }
-
-        float norm = sqrtf(energy1 * energy2);
-        if (norm > 0) corr /= norm;
-
-        if (corr > best_corr) {
-            best_corr = corr;
-            best_period = period;
-        }
-    }
+    float best_corr;
+    size_t best_period = best_autocorrelation_lag(samples + pos, analysis_len,
+                                                  min_period, max_period, &best_corr);
 
     /* Return period only if correlation is strong (voiced) */
     if (best_corr > 0.25f && best_period > 0) {
@@ -2086,6 +3447,11 @@ static size_t find_pitch_period(const int16_t* samples, size_t count, size_t pos
     return 0;  /* Unvoiced */
 }
 
+/* Find pitch period at a specific position */
+static size_t find_pitch_period(const int16_t* samples, size_t count, size_t pos) {
+    return pitch_period_in_range(samples, count, pos, PITCH_MIN_PERIOD, PITCH_MAX_PERIOD);
+}
+
 /*
  * Apply smooth pitch modification using TD-PSOLA
  * pitch_factor > 1.0 = higher pitch, < 1.0 = lower pitch
@@ -2193,6 +3559,7 @@ static int apply_td_psola_pitch(const int16_t* input, size_t input_count,
 /* Pre-computed Hanning window for 256-sample frame */
 #define PITCH_FRAME_SIZE 256
 static float hanning_window[PITCH_FRAME_SIZE];
+static float hanning_overlap[PITCH_FRAME_SIZE / 2];  /* Sum of the two frames over a sample */
 static int hanning_initialized = 0;
 
 static void init_hanning_window(void) {
@@ -2200,12 +3567,67 @@ static void init_hanning_window(void) {
     for (int i = 0; i < PITCH_FRAME_SIZE; i++) {
         hanning_window[i] = 0.5f * (1.0f - cosf(2.0f * PI * i / PITCH_FRAME_SIZE));
     }
+    for (int i = 0; i < PITCH_FRAME_SIZE / 2; i++) {
+        hanning_overlap[i] = hanning_window[i + PITCH_FRAME_SIZE / 2] + hanning_window[i];
+    }
     hanning_initialized = 1;
 }
 
+/* Divide one overlap-added sample by its window sum; uncovered samples keep temp */
+static void pitch_contour_divide(int16_t* samples, const int16_t* temp, size_t i, float norm) {
+    if (norm > 0.01f) {
+        float val = samples[i] / norm;
+        if (val > 32767.0f) val = 32767.0f;
+        if (val < -32768.0f) val = -32768.0f;
+        samples[i] = (int16_t)val;
+    } else {
+        samples[i] = temp[i];
+    }
+}
+
+/*
+ * Normalize after frames overlap-added frames: the first and last half
+ * frames lie under one window, samples between them under two (a sum that
+ * repeats every hop), and anything after the last frame under none.
+ */
+static void pitch_contour_normalize(int16_t* samples, const int16_t* temp, size_t count,
+                                    size_t frames) {
+    size_t hop = PITCH_FRAME_SIZE / 2;
+    size_t overlap_end = frames * hop;
+    size_t i = 0;
+
+    for (; i < hop; i++) pitch_contour_divide(samples, temp, i, hanning_window[i]);
+
+#if defined(__SSE2__)
+    /* The window sum is close to 1 here, so no sample falls back to temp */
+    for (; i + 8 <= overlap_end; i += 8) {
+        const float* norm = hanning_overlap + (i % hop);
+        __m128i v = _mm_loadu_si128((const __m128i*)(samples + i));
+        __m128i sign = _mm_srai_epi16(v, 15);
+        __m128 lo = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, sign)), _mm_loadu_ps(norm));
+        __m128 hi = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, sign)),
+                               _mm_loadu_ps(norm + 4));
+        v = _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi));
+        _mm_storeu_si128((__m128i*)(samples + i), v);
+    }
+#endif
+    for (; i < overlap_end; i++) pitch_contour_divide(samples, temp, i, hanning_overlap[i % hop]);
+
+    for (; i < overlap_end + hop && i < count; i++) {
+        pitch_contour_divide(samples, temp, i, hanning_window[i - overlap_end + hop]);
+    }
+    for (; i < count; i++) samples[i] = temp[i];
+}
+
+/*
+ * Resample 256-sample Hanning frames at 50% overlap, each at the pitch
+ * factor of its position on a smoothstep from start_factor to end_factor.
+ * interp is a CTTSPitchInterp (4-tap cubic or linear).
+ */
 static void apply_smooth_pitch_contour(int16_t* samples, size_t count,
-                                        float start_factor, float end_factor) {
+                                        float start_factor, float end_factor, int interp) {
     if (count < 100 || fabsf(start_factor - end_factor) < 0.01f) return;
+    if (count < PITCH_FRAME_SIZE) return;  /* No whole frame to resample */
 
     /* Initialize Hanning window if needed */
     init_hanning_window();
@@ -2218,16 +3640,12 @@ static void apply_smooth_pitch_contour(int16_t* samples, size_t count,
     if (!temp) return;
     memcpy(temp, samples, count * sizeof(int16_t));
 
-    float* norm = calloc(count, sizeof(float));
-    if (!norm) {
-        free(temp);
-        return;
-    }
-
     memset(samples, 0, count * sizeof(int16_t));
 
     float inv_count = 1.0f / (float)(count - frame_size);
+    int cubic = (interp == CTTS_PITCH_CUBIC);
 
+    size_t frames = 0;
     for (size_t pos = 0; pos + frame_size <= count; pos += hop) {
         /* Calculate pitch factor at this position using smooth interpolation */
         float t = (float)pos * inv_count;
@@ -2235,41 +3653,16 @@ static void apply_smooth_pitch_contour(int16_t* samples, size_t count,
         float smooth_t = t * t * (3.0f - 2.0f * t);
         float pitch_factor = start_factor + (end_factor - start_factor) * smooth_t;
 
-        /* Apply pitch modification to this frame using pre-computed window */
-        for (size_t i = 0; i < frame_size; i++) {
-            float window = hanning_window[i];
-
-            /* Resample */
-            float src_idx = i * pitch_factor;
-            size_t idx = (size_t)src_idx;
-            float frac = src_idx - idx;
-
-            float sample;
-            if (idx + 1 < frame_size) {
-                sample = temp[pos + idx] * (1.0f - frac) + temp[pos + idx + 1] * frac;
-            } else {
-                sample = temp[pos + idx];
-            }
-
-            samples[pos + i] += (int16_t)(sample * window);
-            norm[pos + i] += window;
-        }
+        /* Resample this frame and overlap-add it under the window */
+        resample_frac(temp, count, pos, frame_size, pitch_factor, frame_size,
+                      hanning_window, cubic, samples + pos);
+        frames++;
     }
 
     /* Normalize */
-    for (size_t i = 0; i < count; i++) {
-        if (norm[i] > 0.01f) {
-            float val = samples[i] / norm[i];
-            if (val > 32767.0f) val = 32767.0f;
-            if (val < -32768.0f) val = -32768.0f;
-            samples[i] = (int16_t)val;
-        } else {
-            samples[i] = temp[i];
-        }
-    }
+    pitch_contour_normalize(samples, temp, count, frames);
 
     free(temp);
-    free(norm);
 }
 
 /* ============================================================================
@@ -2736,7 +4129,7 @@ static PhraseIntonation get_phrase_intonation_limited(PhraseType type, float max
 static void apply_phrase_intonation(int16_t* samples, size_t count,
                                      PhraseIntonation* inton,
                                      int word_index, int total_words,
-                                     float max_pitch_change) {
+                                     float max_pitch_change, int pitch_interp) {
     if (count < 100 || total_words == 0) return;
 
     /* Calculate position in phrase (0.0 = first word, 1.0 = last word) */
@@ -2782,10 +4175,10 @@ static void apply_phrase_intonation(int16_t* samples, size_t count,
                 float peak = clamp_pitch(inton->pitch_peak, max_pitch_change);
                 /* Rising portion */
                 apply_smooth_pitch_contour(samples, rise_samples,
-                                           word_start, peak);
+                                           word_start, peak, pitch_interp);
                 /* Falling portion */
                 apply_smooth_pitch_contour(samples + rise_samples, count - rise_samples,
-                                           peak, word_end);
+                                           peak, word_end, pitch_interp);
                 goto apply_energy;  /* Skip normal contour application */
             }
         } else {
@@ -2836,7 +4229,7 @@ static void apply_phrase_intonation(int16_t* samples, size_t count,
     }
 
     /* Apply the pitch contour */
-    apply_smooth_pitch_contour(samples, count, word_start, word_end);
+    apply_smooth_pitch_contour(samples, count, word_start, word_end, pitch_interp);
 
 apply_energy:
     /* Apply energy adjustment */
@@ -3267,6 +4660,50 @@ static int pt_syllable_score(const char* text, size_t byte_len, size_t char_coun
     return score;
 }
 
+/*
+ * Overlap the start of src with the end of the buffer and append the rest.
+ * Buffer must already have room for count samples.
+ * Uses pre-computed LUT for the raised-cosine gains.
+ */
+static void buffer_mix_crossfade(SampleBuffer* buf, const int16_t* src,
+                                 size_t count, size_t crossfade_samples) {
+    size_t actual_crossfade = crossfade_samples;
+    if (actual_crossfade > buf->count) actual_crossfade = buf->count;
+    if (actual_crossfade > count) actual_crossfade = count;
+
+    /* Crossfade region using pre-computed lookup tables */
+    if (actual_crossfade > 0) {
+        size_t fade_start = buf->count - actual_crossfade;
+        float inv_crossfade = 1.0f / (float)actual_crossfade;
+
+        for (size_t i = 0; i < actual_crossfade; i++) {
+            float t = (float)i * inv_crossfade;
+            /* Use pre-computed LUT for crossfade gains */
+            float prev_gain = fast_fade_out(t);
+            float next_gain = fast_fade_in(t);
+
+            int32_t prev_sample = buf->data[fade_start + i];
+            int32_t next_sample = src[i];
+
+            int32_t mixed = (int32_t)(prev_sample * prev_gain + next_sample * next_gain);
+
+            /* Clamp to int16 range */
+            if (mixed > 32767) mixed = 32767;
+            else if (mixed < -32768) mixed = -32768;
+
+            buf->data[fade_start + i] = (int16_t)mixed;
+        }
+    }
+
+    /* Append the rest of the new samples (after crossfade region) */
+    if (count > actual_crossfade) {
+        memcpy(buf->data + buf->count,
+               src + actual_crossfade,
+               (count - actual_crossfade) * sizeof(int16_t));
+        buf->count += count - actual_crossfade;
+    }
+}
+
 /*
  * Append audio unit with crossfade.
  * Uses smooth crossfade for syllable concatenation.
@@ -3315,42 +4752,8 @@ static int buffer_append_crossfade(SampleBuffer* buf, const int16_t* samples,
         memcpy(buf->data + buf->count, src, count * sizeof(int16_t));
         buf->count += count;
     } else {
-        /* Crossfade with previous audio (within a word) - use pre-computed LUT */
-        size_t actual_crossfade = crossfade_samples;
-        if (actual_crossfade > buf->count) actual_crossfade = buf->count;
-        if (actual_crossfade > count) actual_crossfade = count;
-
-        /* Crossfade region using pre-computed lookup tables */
-        if (actual_crossfade > 0) {
-            size_t fade_start = buf->count - actual_crossfade;
-            float inv_crossfade = 1.0f / (float)actual_crossfade;
-
-            for (size_t i = 0; i < actual_crossfade; i++) {
-                float t = (float)i * inv_crossfade;
-                /* Use pre-computed LUT for crossfade gains */
-                float prev_gain = fast_fade_out(t);
-                float next_gain = fast_fade_in(t);
-
-                int32_t prev_sample = buf->data[fade_start + i];
-                int32_t next_sample = src[i];
-
-                int32_t mixed = (int32_t)(prev_sample * prev_gain + next_sample * next_gain);
-
-                /* Clamp to int16 range */
-                if (mixed > 32767) mixed = 32767;
-                else if (mixed < -32768) mixed = -32768;
-
-                buf->data[fade_start + i] = (int16_t)mixed;
-            }
-        }
-
-        /* Append the rest of the new samples (after crossfade region) */
-        if (count > actual_crossfade) {
-            memcpy(buf->data + buf->count,
-                   src + actual_crossfade,
-                   (count - actual_crossfade) * sizeof(int16_t));
-            buf->count += count - actual_crossfade;
-        }
+        /* Crossfade with previous audio (within a word) */
+        buffer_mix_crossfade(buf, src, count, crossfade_samples);
     }
 
     if (copy) free(copy);
@@ -3385,47 +4788,17 @@ static void buffer_finalize(SampleBuffer* buf, size_t fade_out_samples) {
 /*
  * Calculate cross-correlation between two signal segments.
  * Returns normalized correlation coefficient (-1.0 to 1.0).
- * OPTIMIZED: Uses float arithmetic and loop unrolling for speed.
+ * energy2 is the energy of sig2 (constant over a search), from correlate().
  */
-static float cross_correlation(const int16_t* sig1, const int16_t* sig2, size_t len) {
+static float cross_correlation(const int16_t* sig1, const int16_t* sig2, size_t len,
+                               int64_t energy2) {
     if (len == 0) return 0.0f;
 
-    float sum_prod = 0.0f;
-    float sum_sq1 = 0.0f;
-    float sum_sq2 = 0.0f;
-
-    /* Process 4 samples at a time for better cache utilization */
-    size_t i = 0;
-    size_t len4 = len & ~3;  /* Round down to multiple of 4 */
-
-    for (; i < len4; i += 4) {
-        float s1_0 = (float)sig1[i];
-        float s1_1 = (float)sig1[i+1];
-        float s1_2 = (float)sig1[i+2];
-        float s1_3 = (float)sig1[i+3];
-        float s2_0 = (float)sig2[i];
-        float s2_1 = (float)sig2[i+1];
-        float s2_2 = (float)sig2[i+2];
-        float s2_3 = (float)sig2[i+3];
-
-        sum_prod += s1_0 * s2_0 + s1_1 * s2_1 + s1_2 * s2_2 + s1_3 * s2_3;
-        sum_sq1 += s1_0 * s1_0 + s1_1 * s1_1 + s1_2 * s1_2 + s1_3 * s1_3;
-        sum_sq2 += s2_0 * s2_0 + s2_1 * s2_1 + s2_2 * s2_2 + s2_3 * s2_3;
-    }
+    Correlation c = correlate(sig1, sig2, len, CORR_ENERGY_A);
+    double denom = sqrt((double)c.energy_a * (double)energy2);
+    if (denom < 1.0) return 0.0f;
 
-    /* Handle remaining samples */
-    for (; i < len; i++) {
-        float s1 = (float)sig1[i];
-        float s2 = (float)sig2[i];
-        sum_prod += s1 * s2;
-        sum_sq1 += s1 * s1;
-        sum_sq2 += s2 * s2;
-    }
-
-    float denom = sqrtf(sum_sq1 * sum_sq2);
-    if (denom < 1.0f) return 0.0f;
-
-    return sum_prod / denom;
+    return (float)((double)c.dot / denom);
 }
 
 /*
@@ -3436,12 +4809,13 @@ static float cross_correlation(const int16_t* sig1, const int16_t* sig2, size_t
 static int find_best_match_wsola(const int16_t* input, size_t input_count,
                                   const int16_t* prev_frame, size_t overlap_len,
                                   size_t nominal_pos, size_t frame_size,
-                                  int max_shift) {
+                                  int max_shift, int coarse_only) {
     if (prev_frame == NULL || overlap_len == 0) {
         return 0;  /* First frame, no search needed */
     }
 
     const int16_t* target = prev_frame + frame_size - overlap_len;
+    int64_t target_energy = correlate(target, target, overlap_len, 0).dot;
 
     /* Coarse search: check every 4th position first */
     float best_corr = -2.0f;
@@ -3455,7 +4829,8 @@ static int find_best_match_wsola(const int16_t* input, size_t input_count,
         if (candidate_pos < 0) continue;
         if ((size_t)candidate_pos + frame_size > input_count) continue;
 
-        float corr = cross_correlation(input + candidate_pos, target, overlap_len);
+        float corr = cross_correlation(input + candidate_pos, target, overlap_len,
+                                       target_energy);
 
         if (corr > best_corr) {
             best_corr = corr;
@@ -3463,6 +4838,8 @@ static int find_best_match_wsola(const int16_t* input, size_t input_count,
         }
     }
 
+    if (coarse_only) return best_offset;
+
     /* Fine search: check around the best coarse position */
     int fine_start = best_offset - coarse_step + 1;
     int fine_end = best_offset + coarse_step - 1;
@@ -3476,7 +4853,8 @@ static int find_best_match_wsola(const int16_t* input, size_t input_count,
         if (candidate_pos < 0) continue;
         if ((size_t)candidate_pos + frame_size > input_count) continue;
 
-        float corr = cross_correlation(input + candidate_pos, target, overlap_len);
+        float corr = cross_correlation(input + candidate_pos, target, overlap_len,
+                                       target_energy);
 
         if (corr > best_corr) {
             best_corr = corr;
@@ -3487,92 +4865,452 @@ static int find_best_match_wsola(const int16_t* input, size_t input_count,
     return best_offset;
 }
 
-static int time_stretch(const int16_t* input, size_t input_count,
-                        int16_t** output, size_t* output_count,
-                        float speed_factor) {
-    if (speed_factor < CTTS_MIN_SPEED) speed_factor = CTTS_MIN_SPEED;
-    if (speed_factor > CTTS_MAX_SPEED) speed_factor = CTTS_MAX_SPEED;
+/* WSOLA frame: ~23ms at 22050 Hz - slightly larger for better quality */
+#define WSOLA_FRAME 512
 
-    /* If speed is very close to 1.0, just copy the input */
-    if (fabsf(speed_factor - 1.0f) < 0.01f) {
-        *output = malloc(input_count * sizeof(int16_t));
-        if (!*output) return CTTS_ERR_OUT_OF_MEMORY;
-        memcpy(*output, input, input_count * sizeof(int16_t));
-        *output_count = input_count;
-        return CTTS_OK;
+static float wsola_window[WSOLA_FRAME];
+static pthread_once_t wsola_window_once = PTHREAD_ONCE_INIT;
+
+static void build_wsola_window(void) {
+    for (size_t i = 0; i < WSOLA_FRAME; i++) {
+        wsola_window[i] = hanning(i, WSOLA_FRAME);
     }
+}
 
-    /* WSOLA Frame parameters */
-    const size_t frame_size = 512;      /* ~23ms at 22050 Hz - slightly larger for better quality */
-    const size_t analysis_hop = frame_size / 4;  /* 75% overlap */
-    const size_t overlap_len = frame_size - analysis_hop;  /* Overlap region for correlation */
-    const int max_shift = (int)(frame_size * 0.25f);  /* Search window: ±25% of frame */
+/* Safe to call from concurrent time_stretch() callers */
+static void init_wsola_window(void) {
+    pthread_once(&wsola_window_once, build_wsola_window);
+}
 
-    size_t synthesis_hop = (size_t)(analysis_hop / speed_factor);
-    if (synthesis_hop < 1) synthesis_hop = 1;
+/*
+ * Piecewise speed over rendered samples: speeds[i] applies from starts[i]
+ * on (starts[0] == 0, ascending). Around each change the rate (1 / speed)
+ * ramps linearly over SPEED_RAMP_SAMPLES, so the WSOLA synthesis hop slides
+ * from one speed to the next instead of jumping.
+ */
+typedef struct {
+    const size_t* starts;
+    const float* speeds;
+    size_t count;
+} SpeedContour;
 
-    /* Calculate output size with some extra buffer */
-    size_t num_frames = (input_count > frame_size) ?
-                        (input_count - frame_size) / analysis_hop + 1 : 1;
-    *output_count = num_frames * synthesis_hop + frame_size + 1024;
+#define SPEED_RAMP_SAMPLES 2205     /* 100 ms */
 
-    *output = calloc(*output_count, sizeof(int16_t));
-    if (!*output) return CTTS_ERR_OUT_OF_MEMORY;
+static double contour_rate(const SpeedContour* c, size_t i) {
+    float speed = c->speeds[i];
+    if (speed < CTTS_MIN_SPEED) speed = CTTS_MIN_SPEED;
+    if (speed > CTTS_MAX_SPEED) speed = CTTS_MAX_SPEED;
+    return 1.0 / speed;
+}
 
-    /* Precompute Hanning window */
-    float* window = malloc(frame_size * sizeof(float));
-    if (!window) {
-        free(*output);
-        return CTTS_ERR_OUT_OF_MEMORY;
-    }
-    for (size_t i = 0; i < frame_size; i++) {
-        window[i] = hanning(i, frame_size);
+/* Half width of the ramp around change j (1 <= j < count) */
+static double contour_half_ramp(const SpeedContour* c, size_t j) {
+    double h = SPEED_RAMP_SAMPLES / 2.0;
+    double before = (double)(c->starts[j] - c->starts[j - 1]) / 2.0;
+    if (before < h) h = before;
+    if (j + 1 < c->count) {
+        double after = (double)(c->starts[j + 1] - c->starts[j]) / 2.0;
+        if (after < h) h = after;
     }
+    return h;
+}
 
-    /* Accumulator for normalization */
-    float* norm = calloc(*output_count, sizeof(float));
-    if (!norm) {
-        free(*output);
-        free(window);
-        return CTTS_ERR_OUT_OF_MEMORY;
-    }
+/*
+ * Output position of input position x: the integral of the rate up to x.
+ * A symmetric linear ramp integrates to the same total as a step at its
+ * centre, so only a ramp containing x needs a correction.
+ */
+static double contour_output_pos(const SpeedContour* c, double x) {
+    double out = 0.0;
+    for (size_t i = 0; i < c->count && x > (double)c->starts[i]; i++) {
+        double end = (i + 1 < c->count && (double)c->starts[i + 1] < x) ?
+                     (double)c->starts[i + 1] : x;
+        out += (end - (double)c->starts[i]) * contour_rate(c, i);
+    }
+    for (size_t j = 1; j < c->count; j++) {
+        double h = contour_half_ramp(c, j);
+        double t = x - ((double)c->starts[j] - h);
+        if (h <= 0.0 || t <= 0.0 || t >= 2.0 * h) continue;
+        double r0 = contour_rate(c, j - 1), r1 = contour_rate(c, j);
+        double step = (t <= h) ? r0 * t : r0 * h + r1 * (t - h);
+        out += r0 * t + (r1 - r0) * t * t / (4.0 * h) - step;
+    }
+    return out;
+}
 
-    /* Buffer to store previous frame for correlation */
-    int16_t* prev_frame = malloc(frame_size * sizeof(int16_t));
-    if (!prev_frame) {
-        free(*output);
-        free(window);
-        free(norm);
-        return CTTS_ERR_OUT_OF_MEMORY;
+/* Whether [from, to) sees a single speed, no ramp included; sets *speed */
+static int contour_constant(const SpeedContour* c, size_t from, size_t to, float* speed) {
+    size_t i = 0;
+    while (i + 1 < c->count && c->starts[i + 1] <= from) i++;
+    for (size_t j = 1; j < c->count; j++) {
+        double h = contour_half_ramp(c, j);
+        if ((double)c->starts[j] - h < (double)to && (double)c->starts[j] + h > (double)from) {
+            return 0;
+        }
     }
-    int have_prev_frame = 0;
+    *speed = c->speeds[i];
+    return 1;
+}
 
-    /* Process frames using WSOLA */
-    size_t nominal_analysis_pos = 0;
-    size_t synthesis_pos = 0;
-    size_t actual_output_len = 0;
+/* How voiced pieces are time-scaled */
+typedef enum {
+    STRETCH_WSOLA,              /* Coarse-to-fine waveform similarity search */
+    STRETCH_WSOLA_COARSE,       /* Coarse search only (under load) */
+    STRETCH_PSOLA               /* Pitch-synchronous; WSOLA in unvoiced regions */
+} StretchMethod;
+
+static int stretch_method(int quality, int stretch_mode) {
+    if (stretch_mode == CTTS_STRETCH_PSOLA) return STRETCH_PSOLA;
+    return (quality >= CTTS_QUALITY_COARSE_WSOLA) ? STRETCH_WSOLA_COARSE : STRETCH_WSOLA;
+}
 
-    while (nominal_analysis_pos + frame_size <= input_count &&
-           synthesis_pos + frame_size <= *output_count) {
+/* ============================================================================
+ * PSOLA Time Scaling
+ *
+ * Pitch marks are placed once per piece, one per period, on the waveform
+ * peak. Output grains (two periods, Hann-windowed) are laid down one output
+ * period apart, each taken from the analysis mark nearest to where the
+ * speed maps that output time: periods are repeated or dropped, pitch is
+ * kept, and nothing is searched. Where there is no pitch the grain is an
+ * ordinary WSOLA frame with its similarity search.
+ * ============================================================================ */
 
-        /* Find best matching position using cross-correlation */
-        int offset = 0;
-        if (have_prev_frame) {
-            offset = find_best_match_wsola(input, input_count,
-                                            prev_frame, overlap_len,
-                                            nominal_analysis_pos, frame_size,
-                                            max_shift);
-        }
+#define PSOLA_BLOCK 220             /* Pitch analysis step, ~10 ms */
+#define PSOLA_WINDOW_RES 1024
 
-        size_t actual_analysis_pos = nominal_analysis_pos + offset;
+static float psola_window[PSOLA_WINDOW_RES];
+static pthread_once_t psola_window_once = PTHREAD_ONCE_INIT;
 
-        /* Ensure we don't go out of bounds */
-        if (actual_analysis_pos + frame_size > input_count) {
-            actual_analysis_pos = input_count - frame_size;
-        }
+static void build_psola_window(void) {
+    for (size_t i = 0; i < PSOLA_WINDOW_RES; i++) {
+        psola_window[i] = hanning(i, PSOLA_WINDOW_RES);
+    }
+}
 
-        /* Window and overlap-add the frame */
-        for (size_t i = 0; i < frame_size; i++) {
+static void init_psola_window(void) {
+    pthread_once(&psola_window_once, build_psola_window);
+}
+
+/*
+ * Period per analysis block (0 = unvoiced). A voiced block only searches
+ * around the previous period, which keeps tracking cheap and avoids octave
+ * jumps; a miss falls back to the full range.
+ */
+static void psola_track_pitch(const int16_t* input, size_t count, size_t* periods,
+                              size_t blocks) {
+    size_t prev = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        size_t pos = b * PSOLA_BLOCK;
+        size_t period = 0;
+        if (prev > 0) {
+            size_t lo = prev * 4 / 5, hi = prev * 5 / 4;
+            if (lo < PITCH_MIN_PERIOD) lo = PITCH_MIN_PERIOD;
+            if (hi > PITCH_MAX_PERIOD) hi = PITCH_MAX_PERIOD;
+            period = pitch_period_in_range(input, count, pos, lo, hi);
+        }
+        if (period == 0) period = find_pitch_period(input, count, pos);
+        periods[b] = prev = period;
+    }
+}
+
+static size_t psola_peak(const int16_t* input, size_t from, size_t to) {
+    size_t best = from;
+    for (size_t i = from + 1; i < to; i++) {
+        if (input[i] > input[best]) best = i;
+    }
+    return best;
+}
+
+/*
+ * Pitch marks through the voiced blocks: one per period, each refined to
+ * the peak within an eighth of a period of where the last one predicts.
+ * Only marks with a full two-period grain inside the input are kept.
+ * Returns the number of marks.
+ */
+static size_t psola_place_marks(const int16_t* input, size_t count, const size_t* periods,
+                                size_t blocks, size_t* marks, size_t* mark_periods) {
+    size_t n = 0;
+    size_t b = 0;
+    while (b < blocks) {
+        if (periods[b] == 0) {
+            b++;
+            continue;
+        }
+        size_t period = periods[b];
+        size_t start = b * PSOLA_BLOCK;
+        size_t mark = psola_peak(input, start, start + period < count ? start + period : count);
+        for (;;) {
+            if (mark >= period && mark + period <= count) {
+                marks[n] = mark;
+                mark_periods[n] = period;
+                n++;
+            }
+            size_t next = mark + period;
+            size_t nb = next / PSOLA_BLOCK;
+            if (nb >= blocks || periods[nb] == 0) {
+                b = nb + 1;
+                break;
+            }
+            period = periods[nb];
+            size_t reach = period / 8;
+            size_t lo = next > reach ? next - reach : 0;
+            size_t hi = next + reach + 1 < count ? next + reach + 1 : count;
+            if (lo >= hi) {
+                b = nb + 1;
+                break;
+            }
+            mark = psola_peak(input, lo, hi);
+        }
+    }
+    return n;
+}
+
+/*
+ * PSOLA time scaling with the same speed/contour handling as
+ * time_stretch_contour(). Pieces shorter than a WSOLA frame are copied.
+ */
+static int psola_stretch(const int16_t* input, size_t input_count,
+                         int16_t** output, size_t* output_count,
+                         float speed_factor, const SpeedContour* contour,
+                         size_t contour_base, size_t* work_bytes) {
+    const size_t frame_size = WSOLA_FRAME;
+    const size_t hop = frame_size / 4;
+    const size_t overlap_len = frame_size - hop;
+    const int max_shift = (int)(frame_size * 0.25f);
+
+    if (input_count < frame_size) {
+        *output = malloc((input_count ? input_count : 1) * sizeof(int16_t));
+        if (!*output) return CTTS_ERR_OUT_OF_MEMORY;
+        memcpy(*output, input, input_count * sizeof(int16_t));
+        *output_count = input_count;
+        return CTTS_OK;
+    }
+
+    /* Output time of input position x, relative to the piece */
+    double origin = contour ? contour_output_pos(contour, (double)contour_base) : 0.0;
+#define PSOLA_MAP(x) (contour ? contour_output_pos(contour, (double)contour_base + (x)) - origin \
+                              : (x) / speed_factor)
+
+    size_t blocks = input_count / PSOLA_BLOCK + 1;
+    size_t max_marks = input_count / PITCH_MIN_PERIOD + 2;
+    size_t* periods = malloc(blocks * sizeof(size_t));
+    size_t* marks = malloc(max_marks * sizeof(size_t));
+    size_t* mark_periods = malloc(max_marks * sizeof(size_t));
+    int16_t* prev_frame = malloc(frame_size * sizeof(int16_t));
+    size_t capacity = (size_t)PSOLA_MAP((double)input_count) + 2 * frame_size + 1024;
+    float* acc = calloc(capacity, sizeof(float));
+    float* norm = calloc(capacity, sizeof(float));
+    *output = NULL;
+    if (!periods || !marks || !mark_periods || !prev_frame || !acc || !norm) {
+        free(periods);
+        free(marks);
+        free(mark_periods);
+        free(prev_frame);
+        free(acc);
+        free(norm);
+        return CTTS_ERR_OUT_OF_MEMORY;
+    }
+    if (work_bytes) {
+        *work_bytes = capacity * (2 * sizeof(float) + sizeof(int16_t)) +
+                      (blocks + 2 * max_marks) * sizeof(size_t);
+    }
+
+    init_psola_window();
+    init_wsola_window();
+    psola_track_pitch(input, input_count, periods, blocks);
+    size_t mark_count = psola_place_marks(input, input_count, periods, blocks,
+                                          marks, mark_periods);
+
+    double t = 0.0;             /* Output time of the current grain centre */
+    double x = 0.0;             /* Input position mapped to t */
+    size_t k = 0;               /* Mark at or before x */
+    int have_prev_frame = 0;
+    size_t out_len = 0;
+
+    while (x < (double)input_count) {
+        while (k + 1 < mark_count && (double)marks[k + 1] <= x) k++;
+        size_t nearest = k;
+        if (k + 1 < mark_count && (double)marks[k + 1] - x < x - (double)marks[k]) {
+            nearest = k + 1;
+        }
+        long centre = lrint(t);
+        double step;
+
+        if (mark_count > 0 && fabs((double)marks[nearest] - x) <= (double)mark_periods[nearest]) {
+            /* Voiced: two periods around the mark, one period further on */
+            size_t period = mark_periods[nearest];
+            size_t grain = 2 * period;
+            const int16_t* src = input + marks[nearest] - period;
+            long out_start = centre - (long)period;
+            for (size_t i = 0; i < grain; i++) {
+                long o = out_start + (long)i;
+                if (o < 0 || (size_t)o >= capacity) continue;
+                float w = psola_window[i * PSOLA_WINDOW_RES / grain];
+                acc[o] += src[i] * w;
+                norm[o] += w;
+            }
+            if (out_start + (long)grain > (long)out_len) out_len = (size_t)(out_start + (long)grain);
+            have_prev_frame = 0;
+            step = (double)period;
+        } else {
+            /* Unvoiced: a WSOLA frame, searched against the previous one */
+            long nominal = lrint(x) - (long)(frame_size / 2);
+            if (nominal < 0) nominal = 0;
+            if ((size_t)nominal + frame_size > input_count) nominal = (long)(input_count - frame_size);
+            int offset = 0;
+            if (have_prev_frame) {
+                offset = find_best_match_wsola(input, input_count, prev_frame, overlap_len,
+                                               (size_t)nominal, frame_size, max_shift, 0);
+            }
+            size_t pos = (size_t)(nominal + offset);
+            if (pos + frame_size > input_count) pos = input_count - frame_size;
+            long out_start = centre - (long)(frame_size / 2);
+            for (size_t i = 0; i < frame_size; i++) {
+                long o = out_start + (long)i;
+                if (o < 0 || (size_t)o >= capacity) continue;
+                acc[o] += input[pos + i] * wsola_window[i];
+                norm[o] += wsola_window[i];
+            }
+            memcpy(prev_frame, input + pos, frame_size * sizeof(int16_t));
+            have_prev_frame = 1;
+            if (out_start + (long)frame_size > (long)out_len) {
+                out_len = (size_t)(out_start + (long)frame_size);
+            }
+            step = (double)hop;
+        }
+
+        /* Advance the output by one grain hop; Newton step back to input */
+        t += step;
+        double slope = PSOLA_MAP(x + 1.0) - PSOLA_MAP(x);
+        x += (t - PSOLA_MAP(x)) / slope;
+    }
+#undef PSOLA_MAP
+
+    if (out_len > capacity) out_len = capacity;
+    *output = malloc((out_len ? out_len : 1) * sizeof(int16_t));
+    if (*output) {
+        for (size_t i = 0; i < out_len; i++) {
+            float val = (norm[i] > 0.01f) ? acc[i] / norm[i] : 0.0f;
+            if (val > 32767.0f) val = 32767.0f;
+            if (val < -32768.0f) val = -32768.0f;
+            (*output)[i] = (int16_t)val;
+        }
+        /* Trim trailing silence */
+        while (out_len > 0 && (*output)[out_len - 1] == 0) out_len--;
+        *output_count = out_len;
+    }
+
+    free(periods);
+    free(marks);
+    free(mark_periods);
+    free(prev_frame);
+    free(acc);
+    free(norm);
+    return *output ? CTTS_OK : CTTS_ERR_OUT_OF_MEMORY;
+}
+
+/*
+ * WSOLA time stretch. With contour != NULL the speed follows the contour
+ * (input[0] sits at contour position contour_base) and speed_factor is
+ * ignored: each frame is placed where the contour maps its nominal
+ * analysis position, so the hop varies smoothly within one pass.
+ */
+static int time_stretch_contour(const int16_t* input, size_t input_count,
+                                int16_t** output, size_t* output_count,
+                                float speed_factor, const SpeedContour* contour,
+                                size_t contour_base, int method, size_t* work_bytes) {
+    if (speed_factor < CTTS_MIN_SPEED) speed_factor = CTTS_MIN_SPEED;
+    if (speed_factor > CTTS_MAX_SPEED) speed_factor = CTTS_MAX_SPEED;
+
+    /* If speed is very close to 1.0, just copy the input */
+    if (!contour && fabsf(speed_factor - 1.0f) < 0.01f) {
+        *output = malloc(input_count * sizeof(int16_t));
+        if (!*output) return CTTS_ERR_OUT_OF_MEMORY;
+        memcpy(*output, input, input_count * sizeof(int16_t));
+        *output_count = input_count;
+        if (work_bytes) *work_bytes = input_count * sizeof(int16_t);
+        return CTTS_OK;
+    }
+
+    if (method == STRETCH_PSOLA) {
+        return psola_stretch(input, input_count, output, output_count, speed_factor,
+                             contour, contour_base, work_bytes);
+    }
+
+    /* WSOLA Frame parameters */
+    const size_t frame_size = WSOLA_FRAME;
+    const size_t analysis_hop = frame_size / 4;  /* 75% overlap */
+    const size_t overlap_len = frame_size - analysis_hop;  /* Overlap region for correlation */
+    const int max_shift = (int)(frame_size * 0.25f);  /* Search window: ±25% of frame */
+
+    size_t synthesis_hop = (size_t)(analysis_hop / speed_factor);
+    if (synthesis_hop < 1) synthesis_hop = 1;
+
+    /* Calculate output size with some extra buffer */
+    size_t num_frames = (input_count > frame_size) ?
+                        (input_count - frame_size) / analysis_hop + 1 : 1;
+    double contour_origin = 0.0;
+    if (contour) {
+        contour_origin = contour_output_pos(contour, (double)contour_base);
+        *output_count = (size_t)(contour_output_pos(contour, (double)(contour_base + input_count)) -
+                                 contour_origin) + frame_size + 1024;
+    } else {
+        *output_count = num_frames * synthesis_hop + frame_size + 1024;
+    }
+
+    *output = calloc(*output_count, sizeof(int16_t));
+    if (!*output) return CTTS_ERR_OUT_OF_MEMORY;
+
+    /* Hanning window, computed once per process */
+    init_wsola_window();
+    const float* window = wsola_window;
+
+    /* Accumulator for normalization */
+    float* norm = calloc(*output_count, sizeof(float));
+    if (!norm) {
+        free(*output);
+        return CTTS_ERR_OUT_OF_MEMORY;
+    }
+
+    /* Buffer to store previous frame for correlation */
+    int16_t* prev_frame = malloc(frame_size * sizeof(int16_t));
+    if (!prev_frame) {
+        free(*output);
+        free(norm);
+        return CTTS_ERR_OUT_OF_MEMORY;
+    }
+    int have_prev_frame = 0;
+    if (work_bytes) {
+        *work_bytes = *output_count * (sizeof(int16_t) + sizeof(float)) +
+                      frame_size * (sizeof(float) + sizeof(int16_t));
+    }
+
+    /* Process frames using WSOLA */
+    size_t nominal_analysis_pos = 0;
+    size_t synthesis_pos = 0;
+    size_t actual_output_len = 0;
+
+    while (nominal_analysis_pos + frame_size <= input_count &&
+           synthesis_pos + frame_size <= *output_count) {
+
+        /* Find best matching position using cross-correlation */
+        int offset = 0;
+        if (have_prev_frame) {
+            offset = find_best_match_wsola(input, input_count,
+                                            prev_frame, overlap_len,
+                                            nominal_analysis_pos, frame_size,
+                                            max_shift, method == STRETCH_WSOLA_COARSE);
+        }
+
+        size_t actual_analysis_pos = nominal_analysis_pos + offset;
+
+        /* Ensure we don't go out of bounds */
+        if (actual_analysis_pos + frame_size > input_count) {
+            actual_analysis_pos = input_count - frame_size;
+        }
+
+        /* Window and overlap-add the frame */
+        for (size_t i = 0; i < frame_size; i++) {
             float sample = input[actual_analysis_pos + i] * window[i];
             (*output)[synthesis_pos + i] += (int16_t)sample;
             norm[synthesis_pos + i] += window[i];
@@ -3588,7 +5326,14 @@ static int time_stretch(const int16_t* input, size_t input_count,
         }
 
         nominal_analysis_pos += analysis_hop;
-        synthesis_pos += synthesis_hop;
+        if (contour) {
+            double mapped = contour_output_pos(contour,
+                                               (double)(contour_base + nominal_analysis_pos)) -
+                            contour_origin;
+            synthesis_pos = (size_t)(mapped + 0.5);
+        } else {
+            synthesis_pos += synthesis_hop;
+        }
     }
 
     /* Normalize by accumulated window energy */
@@ -3601,7 +5346,6 @@ static int time_stretch(const int16_t* input, size_t input_count,
         }
     }
 
-    free(window);
     free(norm);
     free(prev_frame);
 
@@ -3616,179 +5360,605 @@ static int time_stretch(const int16_t* input, size_t input_count,
     return CTTS_OK;
 }
 
+static int time_stretch(const int16_t* input, size_t input_count,
+                        int16_t** output, size_t* output_count,
+                        float speed_factor, int method, size_t* work_bytes) {
+    return time_stretch_contour(input, input_count, output, output_count, speed_factor,
+                                NULL, 0, method, work_bytes);
+}
+
 /* ============================================================================
- * Text-to-Speech Synthesis
+ * Run-Length Silence
+ *
+ * Word and punctuation pauses are rendered as exact zeros. After rendering,
+ * the output is cut into voiced pieces and silence runs: voiced pieces go
+ * through WSOLA one at a time, silence runs are only carried as a length
+ * (scaled directly by the speed factor) and are never windowed, correlated
+ * or copied. Consumers that understand runs can skip them entirely (DTX,
+ * sparse writes); the rest get zeros from a shared block.
  * ============================================================================ */
 
-int ctts_synthesize(CTTS* engine, const char* text,
-                    int16_t** samples, size_t* sample_count, float speed) {
-    if (!engine || !text || !samples || !sample_count) {
-        return CTTS_ERR_INVALID_ARG;
+/* Interior zero runs shorter than one WSOLA frame stay inside the voiced piece */
+#define SILENCE_RUN_MIN 512
+
+/* Shared zeros for consumers that want silence materialized */
+#define SILENCE_BLOCK_LEN 4096
+static const int16_t silence_block[SILENCE_BLOCK_LEN];
+
+/*
+ * Find the next silence run at or after from. A run is a stretch of exact
+ * zeros at least SILENCE_RUN_MIN long, or of any length when it touches
+ * either end of the input. Returns 0 when there is none.
+ */
+static int next_silence_run(const int16_t* samples, size_t count, size_t from,
+                            size_t* run_start, size_t* run_end) {
+    size_t i = from;
+    while (i < count) {
+        while (i < count && samples[i] != 0) i++;
+        if (i == count) return 0;
+        size_t start = i;
+        while (i < count && samples[i] == 0) i++;
+        if (i - start >= SILENCE_RUN_MIN || start == 0 || i == count) {
+            *run_start = start;
+            *run_end = i;
+            return 1;
+        }
     }
+    return 0;
+}
 
-    /* Initialize lookup tables (once) */
-    init_fade_luts();
+/* Receives either voiced samples or (samples == NULL) a run of silence */
+typedef int (*SegmentSink)(void* ctx, const int16_t* samples, size_t count);
 
-    /* Get config */
-    CTTSConfig* config = &engine->config;
+/* Speed factor as applied to segments: clamped, 1.0 when close enough */
+static float segment_speed(float speed) {
+    if (speed < CTTS_MIN_SPEED) speed = CTTS_MIN_SPEED;
+    if (speed > CTTS_MAX_SPEED) speed = CTTS_MAX_SPEED;
+    return (fabsf(speed - 1.0f) < 0.01f) ? 1.0f : speed;
+}
 
-    /* Load duration rules (if not already loaded) */
-    load_duration_rules("duration_rules.csv");
+/*
+ * Voiced pieces stretch_segments() passes through WSOLA, in order. With
+ * starts == NULL only counts them. Returns the number of pieces.
+ */
+static size_t segment_voiced_pieces(const int16_t* input, size_t count, float speed,
+                                    size_t* starts, size_t* lengths) {
+    if (segment_speed(speed) == 1.0f) return 0;
+
+    size_t n = 0, pos = 0;
+    while (pos < count) {
+        size_t run_start = count, run_end = count;
+        if (!next_silence_run(input, count, pos, &run_start, &run_end)) {
+            run_start = run_end = count;
+        }
+        if (run_start - pos >= SILENCE_RUN_MIN) {
+            if (starts) {
+                starts[n] = pos;
+                lengths[n] = run_start - pos;
+            }
+            n++;
+        }
+        pos = run_end;
+    }
+    return n;
+}
 
-    /* Analyze prosody context from original text (with pitch limit from config) */
-    ProsodyContext prosody;
-    analyze_prosody(text, &prosody, config->max_pitch_change);
+/* Voiced piece already stretched by the caller (taken over by stretch_segments) */
+typedef struct {
+    int16_t* samples;
+    size_t count;
+} StretchedPiece;
 
-    /* Step 1: Expand numbers to words */
-    char* numbers_expanded = expand_numbers(text);
-    if (!numbers_expanded) return CTTS_ERR_OUT_OF_MEMORY;
+/*
+ * Time-stretch rendered audio piece by piece. Voiced pieces shorter than a
+ * WSOLA frame are passed through; silence after a voiced piece absorbs its
+ * length error so pauses land where the speed factor puts them. With
+ * stretched_pieces != NULL the voiced pieces come from there (see
+ * segment_voiced_pieces()) and are freed here. With contour != NULL speed
+ * is ignored and each piece follows the contour (stretched_pieces must be
+ * NULL).
+ */
+static int stretch_segments(const int16_t* input, size_t count, float speed,
+                            const SpeedContour* contour, int method,
+                            StretchedPiece* stretched_pieces, SegmentSink sink, void* ctx,
+                            size_t* work_bytes) {
+    speed = segment_speed(speed);
+    if (work_bytes) *work_bytes = 0;
+
+    size_t pos = 0, out_pos = 0;
+    while (pos < count) {
+        size_t run_start = count, run_end = count;
+        if (!next_silence_run(input, count, pos, &run_start, &run_end)) {
+            run_start = run_end = count;
+        }
 
-    /* Step 2: Load and apply CSV normalization rules (includes abbreviations) */
-    ctts_load_normalization("normalization.csv");
-    char* rule_normalized = ctts_apply_normalization(numbers_expanded);
-    free(numbers_expanded);
-    if (!rule_normalized) return CTTS_ERR_OUT_OF_MEMORY;
+        /* Voiced piece before the run; a piece inside one contour step
+           takes the constant-speed path */
+        size_t voiced = run_start - pos;
+        const SpeedContour* piece_contour = NULL;
+        float piece_speed = speed;
+        if (contour && voiced > 0) {
+            if (contour_constant(contour, pos, run_start, &piece_speed)) {
+                piece_speed = segment_speed(piece_speed);
+            } else {
+                piece_contour = contour;
+            }
+        }
+        if (voiced > 0) {
+            int err;
+            if ((piece_contour || piece_speed != 1.0f) && voiced >= SILENCE_RUN_MIN) {
+                int16_t* stretched;
+                size_t stretched_count, piece_bytes = 0;
+                if (stretched_pieces) {
+                    stretched = stretched_pieces->samples;
+                    stretched_count = stretched_pieces->count;
+                    stretched_pieces->samples = NULL;
+                    stretched_pieces++;
+                } else {
+                    err = time_stretch_contour(input + pos, voiced, &stretched, &stretched_count,
+                                               piece_speed, piece_contour, pos, method,
+                                               &piece_bytes);
+                    if (err != CTTS_OK) return err;
+                }
+                if (work_bytes && piece_bytes > *work_bytes) *work_bytes = piece_bytes;
+                err = sink(ctx, stretched, stretched_count);
+                free(stretched);
+                out_pos += stretched_count;
+            } else {
+                err = sink(ctx, input + pos, voiced);
+                out_pos += voiced;
+            }
+            if (err != CTTS_OK) return err;
+        }
 
-    /* Step 3: Apply standard normalization (lowercase) */
-    char* normalized = ctts_normalize(rule_normalized);
-    free(rule_normalized);
-    if (!normalized) return CTTS_ERR_OUT_OF_MEMORY;
+        /* Silence: only its length travels */
+        if (run_end > run_start) {
+            double mapped = contour ? contour_output_pos(contour, (double)run_end)
+                                    : (double)run_end / speed;
+            size_t target = (size_t)(mapped + 0.5);
+            if (target > out_pos) {
+                int err = sink(ctx, NULL, target - out_pos);
+                if (err != CTTS_OK) return err;
+                out_pos = target;
+            }
+        }
+        pos = run_end;
+    }
+    return CTTS_OK;
+}
 
-    /* Initialize output buffer */
-    SampleBuffer buf;
-    int err = buffer_init(&buf, CTTS_SAMPLE_RATE * 10);  /* 10 seconds initial */
+/* Sink that materializes everything into a SampleBuffer */
+static int segment_to_buffer(void* ctx, const int16_t* samples, size_t count) {
+    SampleBuffer* out = (SampleBuffer*)ctx;
+    int err = buffer_grow(out, count);
+    if (err != CTTS_OK) return err;
+    if (samples) {
+        memcpy(out->data + out->count, samples, count * sizeof(int16_t));
+    } else {
+        memset(out->data + out->count, 0, count * sizeof(int16_t));
+    }
+    out->count += count;
+    return CTTS_OK;
+}
+
+/* Time-stretch into one contiguous buffer (caller frees *output) */
+static int stretch_to_buffer(const int16_t* input, size_t count, float speed,
+                             const SpeedContour* contour, int method,
+                             StretchedPiece* stretched_pieces,
+                             int16_t** output, size_t* output_count,
+                             size_t* work_bytes) {
+    SampleBuffer out;
+    size_t expected = contour ? (size_t)contour_output_pos(contour, (double)count)
+                              : (size_t)(count / (speed < CTTS_MIN_SPEED ? CTTS_MIN_SPEED : speed));
+    int err = buffer_init(&out, expected + 1024);
+    if (err != CTTS_OK) return err;
+
+    err = stretch_segments(input, count, speed, contour, method, stretched_pieces,
+                           segment_to_buffer, &out, work_bytes);
     if (err != CTTS_OK) {
-        free(normalized);
+        free(out.data);
         return err;
     }
+    if (work_bytes) *work_bytes += out.capacity * sizeof(int16_t);
+    *output = out.data;
+    *output_count = out.count;
+    return CTTS_OK;
+}
 
-    /* Calculate sample counts from config */
-    size_t word_pause_samples = (size_t)(config->word_pause_ms * CTTS_SAMPLE_RATE / 1000.0f);
-    size_t unknown_silence = (size_t)(config->unknown_silence_ms * CTTS_SAMPLE_RATE / 1000.0f);
+/* ============================================================================
+ * Unit Selection Tokens
+ * ============================================================================ */
 
-    const char* pos = normalized;
-    engine->units_found = 0;
-    engine->units_missing = 0;
+typedef enum {
+    SEL_WORD_BREAK,     /* Whitespace: word pause */
+    SEL_SOFT_BREAK,     /* Hyphen: smooth join without pause */
+    SEL_PUNCT,          /* Punctuation pause */
+    SEL_SKIP,           /* Non-speech character */
+    SEL_UNIT,           /* Matched database unit */
+    SEL_MISSING         /* Character with no unit (fallback silence) */
+} SelectionKind;
 
-    /* Track previous unit for vowel detection and adaptive crossfade */
-    const char* prev_unit_text = NULL;
-    size_t prev_unit_len = 0;
-    int prev_was_word_boundary = 1;  /* Start as if after word boundary */
-    PhonemeType prev_end_phoneme = PHONEME_OTHER;
+typedef struct {
+    SelectionKind kind;
+    const char* text;   /* Start of token in normalized text */
+    size_t len;         /* Byte length */
+    int unit_idx;       /* Unit index for SEL_UNIT */
+} SelectionToken;
 
-    /* Track word position for prosody */
-    int current_word_index = 0;
-    size_t word_start_sample = 0;
+/*
+ * Classify and consume the next token of normalized text.
+ * at_word_start enables the Portuguese word-onset rules in unit matching.
+ */
+static void select_next(CTTS* engine, const char** pos, int at_word_start,
+                        SelectionToken* tok) {
+    const char* p = *pos;
+    tok->text = p;
+    tok->len = 1;
+    tok->unit_idx = -1;
+
+    if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        tok->kind = SEL_WORD_BREAK;
+    } else if (*p == '-') {
+        tok->kind = SEL_SOFT_BREAK;
+    } else if (*p == ',' || *p == ';' || *p == ':' ||
+               *p == '.' || *p == '!' || *p == '?') {
+        tok->kind = SEL_PUNCT;
+    } else if (*p == '(' || *p == ')' || *p == '[' || *p == ']' ||
+               *p == '"' || *p == '\'' || *p == '`') {
+        tok->kind = SEL_SKIP;
+    } else {
+        /* Use greedy matching with look-ahead and Portuguese rules */
+        int unit_idx;
+        size_t match_len = find_best_match_with_lookahead(
+            engine, p, engine->header.max_unit_chars, &unit_idx, at_word_start);
 
-    /* Calculate target RMS for energy normalization */
-    float target_rms = 3000.0f;  /* Target RMS level for consistent volume */
+        if (match_len > 0 && unit_idx >= 0) {
+            tok->kind = SEL_UNIT;
+            tok->len = match_len;
+            tok->unit_idx = unit_idx;
+        } else {
+            tok->kind = SEL_MISSING;
+            tok->len = utf8_char_len(p);
+        }
+    }
 
-    /* Silence removal parameters */
-    size_t min_silence_samples = (size_t)(config->min_silence_ms * CTTS_SAMPLE_RATE / 1000.0f);
+    *pos = p + tok->len;
+}
 
-    while (*pos) {
-        /* Skip whitespace, add word pause (pure silence, no crossfade) */
-        if (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r') {
-            /* Remove silence within the completed word if configured */
-            if (config->remove_word_silence && buf.count > word_start_sample) {
-                size_t word_samples = buf.count - word_start_sample;
-                if (word_samples > min_silence_samples) {
-                    size_t new_word_len = remove_silence_regions(
-                        buf.data + word_start_sample,
-                        word_samples,
-                        config->silence_threshold,
-                        min_silence_samples
-                    );
-                    buf.count = word_start_sample + new_word_len;
-                }
-            }
+/* ============================================================================
+ * Load-Adaptive Quality
+ *
+ * A process-wide governor. Each ctts_synthesize() call feeds its latency and
+ * real-time factor into moving averages; the latency expected for the next
+ * request is the average plus one average per request queued outside the
+ * engine. Rendering reads the level once per request (render_init), so a
+ * request is never rendered at two levels.
+ * ============================================================================ */
 
-            /* Apply prosody effects to completed word using phrase intonation */
-            if (buf.count > word_start_sample) {
-                apply_phrase_intonation(buf.data + word_start_sample,
-                                        buf.count - word_start_sample,
-                                        &prosody.intonation,
-                                        current_word_index, prosody.word_count,
-                                        config->max_pitch_change);
-            }
+#define LOAD_AVG_WEIGHT 0.25        /* Weight of the newest request in the averages */
+#define LOAD_SETTLE_REQUESTS 4      /* Requests between level changes */
+#define LOAD_RECOVER_RATIO 0.6      /* Step up below this share of the target */
+
+static pthread_mutex_t load_lock = PTHREAD_MUTEX_INITIALIZER;
+static int load_enabled = 0;
+static int load_level = CTTS_QUALITY_FULL;
+static uint32_t load_in_flight = 0;
+static uint32_t load_waiting = 0;
+static uint64_t load_since_change = 0;     /* Guarded by load_lock */
+static CTTSLoadStats load_stats;           /* Guarded by load_lock */
+
+/* Level for a request starting now */
+static int load_quality_level(void) {
+    if (!__atomic_load_n(&load_enabled, __ATOMIC_ACQUIRE)) return CTTS_QUALITY_FULL;
+    return __atomic_load_n(&load_level, __ATOMIC_ACQUIRE);
+}
 
-            /* Apply fade-out before silence if we have audio */
-            if (buf.count > 0) {
-                size_t fade_samples = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
-                apply_fade_out(buf.data, buf.count, fade_samples);
-            }
-            buffer_append_silence(&buf, word_pause_samples);
+int ctts_load_control_enable(double target_ms) {
+    if (!(target_ms > 0)) return CTTS_ERR_INVALID_ARG;
 
-            /* Mark start of next word */
-            word_start_sample = buf.count;
-            current_word_index++;
+    pthread_mutex_lock(&load_lock);
+    load_stats.enabled = 1;
+    load_stats.target_ms = target_ms;
+    pthread_mutex_unlock(&load_lock);
+    __atomic_store_n(&load_enabled, 1, __ATOMIC_RELEASE);
+    return CTTS_OK;
+}
 
-            pos++;
-            prev_was_word_boundary = 1;
-            prev_unit_text = NULL;
-            prev_unit_len = 0;
-            prev_end_phoneme = PHONEME_OTHER;
-            continue;
+void ctts_load_control_disable(void) {
+    pthread_mutex_lock(&load_lock);
+    load_stats.enabled = 0;
+    load_stats.level = CTTS_QUALITY_FULL;
+    load_since_change = 0;
+    __atomic_store_n(&load_enabled, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&load_level, CTTS_QUALITY_FULL, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&load_lock);
+}
+
+void ctts_load_control_set_queue_depth(uint32_t depth) {
+    __atomic_store_n(&load_waiting, depth, __ATOMIC_RELAXED);
+}
+
+int ctts_load_control_stats(CTTSLoadStats* stats) {
+    if (!stats) return CTTS_ERR_INVALID_ARG;
+
+    pthread_mutex_lock(&load_lock);
+    *stats = load_stats;
+    stats->queue_depth = __atomic_load_n(&load_waiting, __ATOMIC_RELAXED);
+    stats->in_flight = __atomic_load_n(&load_in_flight, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&load_lock);
+    return CTTS_OK;
+}
+
+/* Move one level and log the event (load_lock held) */
+static void load_change_level(int to, double predicted_ms, uint32_t waiting) {
+    CTTSLoadStats* st = &load_stats;
+    if (st->event_count == CTTS_LOAD_EVENTS) {
+        memmove(st->events, st->events + 1, (CTTS_LOAD_EVENTS - 1) * sizeof(CTTSQualityEvent));
+        st->event_count--;
+    }
+    CTTSQualityEvent* ev = &st->events[st->event_count++];
+    ev->request = st->requests;
+    ev->timestamp = (int64_t)time(NULL);
+    ev->from_level = st->level;
+    ev->to_level = to;
+    ev->predicted_ms = predicted_ms;
+    ev->queue_depth = waiting;
+
+    if (to > st->level) st->step_downs++;
+    else st->step_ups++;
+    st->level = to;
+    load_since_change = 0;
+    __atomic_store_n(&load_level, to, __ATOMIC_RELEASE);
+}
+
+/* Account one finished request rendered at level */
+static void load_observe(int level, double ms, size_t sample_count) {
+    uint32_t waiting = __atomic_load_n(&load_waiting, __ATOMIC_RELAXED);
+    double audio_ms = sample_count * 1000.0 / CTTS_SAMPLE_RATE;
+
+    pthread_mutex_lock(&load_lock);
+    CTTSLoadStats* st = &load_stats;
+    if (!st->enabled) {
+        pthread_mutex_unlock(&load_lock);
+        return;
+    }
+
+    if (st->requests == 0) {
+        st->avg_latency_ms = ms;
+        st->avg_rtf = audio_ms > 0 ? ms / audio_ms : 0.0;
+    } else {
+        st->avg_latency_ms += LOAD_AVG_WEIGHT * (ms - st->avg_latency_ms);
+        if (audio_ms > 0) st->avg_rtf += LOAD_AVG_WEIGHT * (ms / audio_ms - st->avg_rtf);
+    }
+    st->requests++;
+    st->requests_at_level[level]++;
+    load_since_change++;
+
+    double predicted = st->avg_latency_ms * (1.0 + waiting);
+    if (load_since_change >= LOAD_SETTLE_REQUESTS) {
+        if (predicted > st->target_ms && st->level < CTTS_QUALITY_LEVELS - 1) {
+            load_change_level(st->level + 1, predicted, waiting);
+        } else if (predicted < st->target_ms * LOAD_RECOVER_RATIO &&
+                   st->level > CTTS_QUALITY_FULL) {
+            load_change_level(st->level - 1, predicted, waiting);
         }
+    }
+    pthread_mutex_unlock(&load_lock);
+}
 
-        /* Soft syllable separator: hyphen creates smooth transition without pause */
-        /* Used for hiatus and other cases where vowels should flow together */
-        if (*pos == '-') {
-            pos++;
-            /* Don't reset prev_was_word_boundary - allow smooth crossfade to continue */
-            /* Don't add any silence - just skip the separator */
-            continue;
+/* ============================================================================
+ * Text-to-Speech Synthesis
+ * ============================================================================ */
+
+/*
+ * Incremental render state.
+ * Holds everything the unit loop carries from one character to the next so a
+ * text can be rendered in fragments (templates, streaming) with the same
+ * crossfade, pause and prosody decisions as a single ctts_synthesize() call.
+ */
+typedef struct {
+    SampleBuffer buf;
+    ProsodyContext prosody;
+
+    /* Previous unit for vowel detection and adaptive crossfade */
+    const char* prev_unit_text;
+    size_t prev_unit_len;
+    int prev_was_word_boundary;
+    PhonemeType prev_end_phoneme;
+
+    /* Word position for prosody */
+    int current_word_index;
+    size_t word_start_sample;
+
+    int quality;        /* CTTSQualityLevel, fixed when rendering starts */
+} RenderState;
+
+/* Text frontend: numbers, CSV rules and lowercase. Caller frees result. */
+static char* normalize_input(const char* text) {
+    /* Step 1: Expand numbers to words */
+    char* numbers_expanded = expand_numbers(text);
+    if (!numbers_expanded) return NULL;
+
+    /* Step 2: Apply the lexicon (abbreviations, whole words) and CSV rules */
+    load_frontend_rules();
+    char* rule_normalized = ctts_apply_normalization(numbers_expanded);
+    free(numbers_expanded);
+    if (!rule_normalized) return NULL;
+
+    /* Step 3: Apply standard normalization (lowercase) */
+    char* normalized = ctts_normalize(rule_normalized);
+    free(rule_normalized);
+    return normalized;
+}
+
+/* Prepare render state with prosody analyzed from the original (raw) text */
+static int render_init(RenderState* st, const ProsodyContext* prosody,
+                       size_t initial_capacity) {
+    st->prosody = *prosody;
+
+    st->prev_unit_text = NULL;
+    st->prev_unit_len = 0;
+    st->prev_was_word_boundary = 1;  /* Start as if after word boundary */
+    st->prev_end_phoneme = PHONEME_OTHER;
+    st->current_word_index = 0;
+    st->word_start_sample = 0;
+    st->quality = load_quality_level();
+
+    return buffer_init(&st->buf, initial_capacity);
+}
+
+/* Crossfade into a unit that follows another unit within a word */
+static float join_crossfade_ms(const char* prev_text, size_t prev_len,
+                               PhonemeType prev_end, PhonemeType next_start,
+                               const CTTSConfig* config) {
+    /* Use phoneme-aware adaptive crossfade */
+    float crossfade_ms = get_adaptive_crossfade(prev_end, next_start, config);
+
+    /* Also consider special cases from original code for S and R endings */
+    int prev_ends_s = ends_with_s(prev_text, prev_len);
+    int prev_ends_r = ends_with_r(prev_text, prev_len);
+
+    if (prev_ends_s && crossfade_ms > config->crossfade_s_ending_ms) {
+        crossfade_ms = config->crossfade_s_ending_ms;
+    } else if (prev_ends_r && crossfade_ms > config->crossfade_r_ending_ms) {
+        crossfade_ms = config->crossfade_r_ending_ms;
+    }
+    return crossfade_ms;
+}
+
+/* Silence removal and phrase intonation for the word being rendered */
+static void render_finish_word(RenderState* st, const CTTSConfig* config) {
+    SampleBuffer* buf = &st->buf;
+    size_t min_silence_samples = (size_t)(config->min_silence_ms * CTTS_SAMPLE_RATE / 1000.0f);
+
+    /* Remove silence within the completed word if configured */
+    if (config->remove_word_silence && buf->count > st->word_start_sample) {
+        size_t word_samples = buf->count - st->word_start_sample;
+        if (word_samples > min_silence_samples) {
+            size_t new_word_len = remove_silence_regions(
+                buf->data + st->word_start_sample,
+                word_samples,
+                config->silence_threshold,
+                min_silence_samples
+            );
+            buf->count = st->word_start_sample + new_word_len;
         }
+    }
+
+    /* Under load only the last two words carry the phrase contour */
+    if (st->quality >= CTTS_QUALITY_SIMPLE_INTONATION &&
+        st->current_word_index < st->prosody.word_count - 2) {
+        return;
+    }
+
+    /* Apply prosody effects to completed word using phrase intonation */
+    if (buf->count > st->word_start_sample) {
+        apply_phrase_intonation(buf->data + st->word_start_sample,
+                                buf->count - st->word_start_sample,
+                                &st->prosody.intonation,
+                                st->current_word_index, st->prosody.word_count,
+                                config->max_pitch_change, config->pitch_interp);
+    }
+}
+
+/* Close the current word and add pause_samples of silence before the next one */
+static void render_word_break(RenderState* st, const CTTSConfig* config,
+                              size_t pause_samples) {
+    SampleBuffer* buf = &st->buf;
+    size_t fade_samples = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
+
+    render_finish_word(st, config);
+
+    /* Apply fade-out before silence if we have audio */
+    if (buf->count > 0) {
+        apply_fade_out(buf->data, buf->count, fade_samples);
+    }
+    buffer_append_silence(buf, pause_samples);
+
+    /* Mark start of next word */
+    st->word_start_sample = buf->count;
+    st->current_word_index++;
+
+    st->prev_was_word_boundary = 1;
+    st->prev_unit_text = NULL;
+    st->prev_unit_len = 0;
+    st->prev_end_phoneme = PHONEME_OTHER;
+}
+
+/*
+ * Render the first len bytes of normalized text into the state's buffer.
+ * Text past len is only seen by unit look-ahead (streaming input).
+ * The last word is left open; call render_finish_word() when the text ends.
+ */
+static int render_text(CTTS* engine, RenderState* st, const char* normalized,
+                       size_t len) {
+    CTTSConfig* config = &engine->config;
+    SampleBuffer* buf = &st->buf;
+    int err;
+
+    /* Calculate sample counts from config */
+    size_t word_pause_samples = (size_t)(config->word_pause_ms * CTTS_SAMPLE_RATE / 1000.0f);
+    size_t unknown_silence = (size_t)(config->unknown_silence_ms * CTTS_SAMPLE_RATE / 1000.0f);
+    size_t fade_samples = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
+
+    /* Calculate target RMS for energy normalization */
+    float target_rms = 3000.0f;  /* Target RMS level for consistent volume */
 
-        /* Handle punctuation with appropriate pauses */
-        if (*pos == ',' || *pos == ';' || *pos == ':' ||
-            *pos == '.' || *pos == '!' || *pos == '?') {
+    const char* pos = normalized;
+    const char* end = normalized + len;
+
+    while (pos < end) {
+        SelectionToken tok;
+        select_next(engine, &pos, st->prev_was_word_boundary, &tok);
+
+        switch (tok.kind) {
+        case SEL_WORD_BREAK:
+            /* Word pause (pure silence, no crossfade) */
+            render_word_break(st, config, word_pause_samples);
+            break;
 
+        case SEL_SOFT_BREAK:
+            /* Soft syllable separator: hyphen creates smooth transition without pause */
+            /* Used for hiatus and other cases where vowels should flow together */
+            /* Don't reset prev_was_word_boundary - allow smooth crossfade to continue */
+            break;
+
+        case SEL_PUNCT: {
             /* Get punctuation-specific pause duration */
-            float pause_ms = get_punctuation_pause_ms(*pos, config);
+            float pause_ms = get_punctuation_pause_ms(*tok.text, config);
             size_t pause_samples = (size_t)(pause_ms * CTTS_SAMPLE_RATE / 1000.0f);
 
             /* Apply fade-out before pause if we have audio */
-            if (buf.count > 0) {
-                size_t fade_samples = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
-                apply_fade_out(buf.data, buf.count, fade_samples);
+            if (buf->count > 0) {
+                apply_fade_out(buf->data, buf->count, fade_samples);
             }
 
             /* Add punctuation pause */
             if (pause_samples > 0) {
-                buffer_append_silence(&buf, pause_samples);
+                buffer_append_silence(buf, pause_samples);
             }
 
             /* Sentence-ending punctuation resets prosody tracking */
-            if (is_sentence_end(*pos)) {
-                current_word_index = 0;
-                word_start_sample = buf.count;
+            if (is_sentence_end(*tok.text)) {
+                st->current_word_index = 0;
+                st->word_start_sample = buf->count;
             }
 
-            pos++;
-            prev_was_word_boundary = 1;
-            continue;
-        }
-
-        /* Skip other non-speech characters */
-        if (*pos == '(' || *pos == ')' || *pos == '[' || *pos == ']' ||
-            *pos == '"' || *pos == '\'' || *pos == '`') {
-            pos++;
-            continue;
+            st->prev_was_word_boundary = 1;
+            break;
         }
 
-        /* Use greedy matching with look-ahead and Portuguese rules */
-        int unit_idx;
-        size_t match_len = find_best_match_with_lookahead(
-            engine, pos, engine->header.max_unit_chars, &unit_idx, prev_was_word_boundary);
+        case SEL_SKIP:
+            /* Skip other non-speech characters */
+            break;
 
-        if (match_len > 0 && unit_idx >= 0) {
+        case SEL_UNIT: {
             /* Found a match */
             size_t unit_samples;
-            const int16_t* unit_audio = get_unit_samples(engine, unit_idx, &unit_samples);
+            const int16_t* unit_audio = get_unit_samples(engine, tok.unit_idx, &unit_samples);
 
             /* Get unit text for vowel detection */
-            CTTSIndexEntry* entry = &engine->index[unit_idx];
+            CTTSIndexEntry* entry = &engine->index[tok.unit_idx];
             const char* unit_text = engine->strings + entry->string_offset;
 
             /* Debug output if enabled */
@@ -3802,229 +5972,6296 @@ int ctts_synthesize(CTTS* engine, const char* text,
 
             /* Choose crossfade duration using adaptive phoneme-based approach */
             float crossfade_ms;
-            if (!prev_was_word_boundary && prev_unit_text != NULL) {
-                /* Use phoneme-aware adaptive crossfade */
-                crossfade_ms = get_adaptive_crossfade(prev_end_phoneme, curr_start_phoneme, config);
-
-                /* Also consider special cases from original code for S and R endings */
-                int prev_ends_s = ends_with_s(prev_unit_text, prev_unit_len);
-                int prev_ends_r = ends_with_r(prev_unit_text, prev_unit_len);
-
-                if (prev_ends_s && crossfade_ms > config->crossfade_s_ending_ms) {
-                    crossfade_ms = config->crossfade_s_ending_ms;
-                } else if (prev_ends_r && crossfade_ms > config->crossfade_r_ending_ms) {
-                    crossfade_ms = config->crossfade_r_ending_ms;
-                }
+            if (!st->prev_was_word_boundary && st->prev_unit_text != NULL) {
+                crossfade_ms = join_crossfade_ms(st->prev_unit_text, st->prev_unit_len,
+                                                 st->prev_end_phoneme, curr_start_phoneme,
+                                                 config);
             } else {
                 crossfade_ms = config->crossfade_ms;
             }
 
             /* Create normalized copy of unit audio for better concatenation */
             int16_t* unit_copy = malloc(unit_samples * sizeof(int16_t));
-            if (!unit_copy) {
-                free(normalized);
-                free(buf.data);
-                return CTTS_ERR_OUT_OF_MEMORY;
-            }
+            if (!unit_copy) return CTTS_ERR_OUT_OF_MEMORY;
             memcpy(unit_copy, unit_audio, unit_samples * sizeof(int16_t));
 
             /* Apply energy normalization for consistent volume */
             normalize_rms(unit_copy, unit_samples, target_rms);
 
             /* Apply pitch smoothing at boundary if not first unit */
-            if (!prev_was_word_boundary && buf.count > 0) {
+            if (!st->prev_was_word_boundary && buf->count > 0) {
                 size_t boundary_samples = (size_t)(crossfade_ms * CTTS_SAMPLE_RATE / 1000.0f);
-                smooth_pitch_boundary(buf.data, buf.count, unit_copy, unit_samples, boundary_samples);
+                if (st->quality < CTTS_QUALITY_NO_BOUNDARY_SMOOTHING) {
+                    smooth_pitch_boundary(buf->data, buf->count, unit_copy, unit_samples,
+                                          boundary_samples);
+                }
 
                 /* Also match energy at boundary for smoother transitions */
-                match_boundary_energy(buf.data, buf.count, unit_copy, unit_samples, boundary_samples);
+                match_boundary_energy(buf->data, buf->count, unit_copy, unit_samples, boundary_samples);
             }
 
             /* Append with appropriate crossfade (or fade-in if first unit of word) */
-            err = buffer_append_crossfade(&buf, unit_copy, unit_samples, crossfade_ms,
-                                          config, prev_was_word_boundary);
+            err = buffer_append_crossfade(buf, unit_copy, unit_samples, crossfade_ms,
+                                          config, st->prev_was_word_boundary);
             free(unit_copy);
-
-            if (err != CTTS_OK) {
-                free(normalized);
-                free(buf.data);
-                return err;
-            }
+            if (err != CTTS_OK) return err;
 
             /* Update previous unit tracking */
-            prev_unit_text = unit_text;
-            prev_unit_len = entry->string_len;
-            prev_end_phoneme = curr_end_phoneme;
-            prev_was_word_boundary = 0;
+            st->prev_unit_text = unit_text;
+            st->prev_unit_len = entry->string_len;
+            st->prev_end_phoneme = curr_end_phoneme;
+            st->prev_was_word_boundary = 0;
 
-            pos += match_len;
             engine->units_found++;
-        } else {
+            break;
+        }
+
+        case SEL_MISSING:
             /* No match found, add silence and skip character */
-            buffer_append_silence(&buf, unknown_silence);
-            pos += utf8_char_len(pos);
+            buffer_append_silence(buf, unknown_silence);
             engine->units_missing++;
-            prev_unit_text = NULL;
-            prev_unit_len = 0;
-            prev_end_phoneme = PHONEME_OTHER;
+            st->prev_unit_text = NULL;
+            st->prev_unit_len = 0;
+            st->prev_end_phoneme = PHONEME_OTHER;
+            break;
         }
     }
 
-    if (config->print_units) {
-        fprintf(stderr, "\n");
+    return CTTS_OK;
+}
+
+/* ============================================================================
+ * Slow-Request Flight Recorder
+ *
+ * A bounded ring of the most recent requests that exceeded a latency
+ * threshold. Writers claim a ticket with one atomic increment, take the
+ * slot over with a compare-and-swap on its sequence number (odd while being
+ * written) and publish by storing the even value, so recording takes no
+ * lock and readers - including a signal handler - simply skip slots that
+ * change under them. Requests under the threshold only pay for
+ * the stage timestamps, and nothing at all while the recorder is off.
+ * ============================================================================ */
+
+typedef struct {
+    uint64_t seq;               /* 0 = empty, odd = being written, 2 * ticket + 2 = ready */
+    CTTSFlightRecord record;
+} FlightSlot;
+
+static FlightSlot* flight_slots = NULL;
+static size_t flight_capacity = 0;
+static uint64_t flight_head = 0;
+static uint64_t flight_dropped = 0;     /* Lost to a concurrent writer of the same slot */
+static int flight_enabled = 0;
+static double flight_threshold_ms = 0.0;
+static char flight_dump_path[1024];
+
+int ctts_flight_recorder_enable(size_t capacity, double threshold_ms) {
+    if (capacity == 0 || threshold_ms < 0) return CTTS_ERR_INVALID_ARG;
+
+    /* The ring is allocated once; later calls only change the threshold */
+    if (!flight_slots) {
+        flight_slots = calloc(capacity, sizeof(FlightSlot));
+        if (!flight_slots) return CTTS_ERR_OUT_OF_MEMORY;
+        flight_capacity = capacity;
+    }
+    flight_threshold_ms = threshold_ms;
+    __atomic_store_n(&flight_enabled, 1, __ATOMIC_RELEASE);
+    return CTTS_OK;
+}
+
+void ctts_flight_recorder_disable(void) {
+    __atomic_store_n(&flight_enabled, 0, __ATOMIC_RELEASE);
+}
+
+static double flight_ms(const struct timespec* a, const struct timespec* b) {
+    return (double)(b->tv_sec - a->tv_sec) * 1000.0 +
+           (double)(b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static uint32_t flight_float_bits(float f) {
+    uint32_t bits;
+    f += 0.0f;      /* -0.0 and 0.0 hash alike */
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+/*
+ * Fingerprint of the settings that shape the output. Fields are packed one
+ * by one, so struct padding never reaches the hash and equal configs always
+ * fingerprint alike; the debug flags are left out.
+ */
+static uint32_t flight_config_fingerprint(const CTTSConfig* c) {
+    uint32_t v[] = {
+        flight_float_bits(c->crossfade_ms), flight_float_bits(c->crossfade_vowel_ms),
+        flight_float_bits(c->crossfade_s_ending_ms), flight_float_bits(c->crossfade_r_ending_ms),
+        flight_float_bits(c->vowel_to_consonant_factor), flight_float_bits(c->word_pause_ms),
+        flight_float_bits(c->unknown_silence_ms), flight_float_bits(c->fade_in_ms),
+        flight_float_bits(c->fade_out_ms),
+        (uint32_t)c->remove_word_silence, flight_float_bits(c->silence_threshold),
+        flight_float_bits(c->min_silence_ms),
+        (uint32_t)c->remove_dc_offset, flight_float_bits(c->normalize_level),
+        flight_float_bits(c->compression),
+        flight_float_bits(c->default_speed), flight_float_bits(c->min_speed),
+        flight_float_bits(c->max_speed), (uint32_t)c->stretch_mode,
+        flight_float_bits(c->max_pitch_change), (uint32_t)c->pitch_interp
+    };
+    return ctts_hash((const char*)v, sizeof(v));
+}
+
+/* Publish a slow request; text is truncated on a UTF-8 boundary */
+static void flight_record(const CTTS* engine, const char* text, float speed,
+                          const struct timespec* marks, size_t mark_count,
+                          size_t output_samples) {
+    uint64_t ticket = __atomic_fetch_add(&flight_head, 1, __ATOMIC_RELAXED);
+    FlightSlot* slot = &flight_slots[ticket % flight_capacity];
+
+    /*
+     * After a wrap, tickets t and t + capacity share a slot. Take it over
+     * only from a published older record: if another writer holds it (odd)
+     * or a newer ticket is already there, this record is dropped rather
+     * than interleaved with the other one.
+     */
+    uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    do {
+        if ((seq & 1) || seq >= 2 * ticket + 2) {
+            __atomic_fetch_add(&flight_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&slot->seq, &seq, 2 * ticket + 1, 1,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    CTTSFlightRecord* r = &slot->record;
+    memset(r, 0, sizeof(*r));
+    r->sequence = ticket;
+    r->timestamp = (int64_t)time(NULL);
+    r->total_ms = flight_ms(&marks[0], &marks[mark_count - 1]);
+    for (size_t i = 0; i + 1 < mark_count && i < CTTS_STAGE_COUNT; i++) {
+        r->stage_ms[i] = (float)flight_ms(&marks[i], &marks[i + 1]);
+    }
+    r->speed = speed;
+    r->config_fingerprint = flight_config_fingerprint(&engine->config);
+    r->unit_count = engine->units_found + engine->units_missing;
+    r->output_samples = output_samples;
+
+    size_t len = strlen(text);
+    r->text_len = (uint32_t)(len < UINT32_MAX ? len : UINT32_MAX);
+    size_t keep = len < CTTS_FLIGHT_TEXT_MAX - 1 ? len : CTTS_FLIGHT_TEXT_MAX - 1;
+    while (keep > 0 && keep < len && ((unsigned char)text[keep] & 0xC0) == 0x80) keep--;
+    for (size_t i = 0; i < keep; i++) {
+        /* Keep each dumped record on one line */
+        unsigned char c = (unsigned char)text[i];
+        r->text[i] = (c < 0x20 || c == '"' || c == 0x7F) ? ' ' : (char)c;
     }
 
-    /* Remove silence from the last word (if not followed by whitespace) */
-    if (config->remove_word_silence && buf.count > word_start_sample) {
-        size_t word_samples = buf.count - word_start_sample;
-        if (word_samples > min_silence_samples) {
-            size_t new_word_len = remove_silence_regions(
-                buf.data + word_start_sample,
-                word_samples,
-                config->silence_threshold,
-                min_silence_samples
-            );
-            buf.count = word_start_sample + new_word_len;
+    __atomic_store_n(&slot->seq, 2 * ticket + 2, __ATOMIC_RELEASE);
+}
+
+/* Copy a consistent record out of a slot; returns 0 if empty or mid-write */
+static int flight_read_slot(const FlightSlot* slot, CTTSFlightRecord* out) {
+    uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (before == 0 || (before & 1)) return 0;
+    memcpy(out, &slot->record, sizeof(*out));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == before;
+}
+
+size_t ctts_flight_recorder_snapshot(CTTSFlightRecord* records, size_t max_records) {
+    if (!flight_slots || !records) return 0;
+
+    uint64_t head = __atomic_load_n(&flight_head, __ATOMIC_ACQUIRE);
+    uint64_t first = head > flight_capacity ? head - flight_capacity : 0;
+    size_t n = 0;
+    for (uint64_t t = first; t < head && n < max_records; t++) {
+        if (flight_read_slot(&flight_slots[t % flight_capacity], &records[n]) &&
+            records[n].sequence == t) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/*
+ * Dump formatting uses only write(2) and stack buffers so the same code
+ * runs from the SIGUSR1 handler.
+ */
+typedef struct {
+    char buf[512];
+    size_t len;
+    int fd;
+    int failed;
+} FlightWriter;
+
+static void fw_flush(FlightWriter* w) {
+    size_t off = 0;
+    while (off < w->len) {
+        ssize_t n = write(w->fd, w->buf + off, w->len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            w->failed = 1;
+            break;
+        }
+        off += (size_t)n;
+    }
+    w->len = 0;
+}
+
+static void fw_str(FlightWriter* w, const char* s) {
+    while (*s) {
+        if (w->len == sizeof(w->buf)) fw_flush(w);
+        w->buf[w->len++] = *s++;
+    }
+}
+
+static void fw_uint(FlightWriter* w, uint64_t v) {
+    char digits[24];
+    size_t n = 0;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    char out[24];
+    for (size_t i = 0; i < n; i++) out[i] = digits[n - 1 - i];
+    out[n] = '\0';
+    fw_str(w, out);
+}
+
+static void fw_hex32(FlightWriter* w, uint32_t v) {
+    char out[11] = "0x";
+    for (int i = 0; i < 8; i++) out[2 + i] = "0123456789abcdef"[(v >> (28 - 4 * i)) & 0xF];
+    out[10] = '\0';
+    fw_str(w, out);
+}
+
+/* Non-negative value with a fixed number of decimals */
+static void fw_fixed(FlightWriter* w, double v, int decimals) {
+    uint64_t scale = 1;
+    for (int i = 0; i < decimals; i++) scale *= 10;
+    uint64_t scaled = (uint64_t)(v * (double)scale + 0.5);
+    fw_uint(w, scaled / scale);
+    if (decimals == 0) return;
+    fw_str(w, ".");
+    uint64_t frac = scaled % scale;
+    for (uint64_t s = scale / 10; s > 1 && frac < s; s /= 10) fw_str(w, "0");
+    fw_uint(w, frac);
+}
+
+static const char* const flight_stage_names[CTTS_STAGE_COUNT] = {
+    "normalize", "prosody", "render", "finish", "stretch"
+};
+
+int ctts_flight_recorder_dump(int fd) {
+    if (fd < 0) return CTTS_ERR_INVALID_ARG;
+
+    FlightWriter w;
+    w.len = 0;
+    w.fd = fd;
+    w.failed = 0;
+
+    fw_str(&w, "# ctts slow requests over ");
+    fw_fixed(&w, flight_threshold_ms, 1);
+    fw_str(&w, " ms, ");
+    fw_uint(&w, __atomic_load_n(&flight_dropped, __ATOMIC_RELAXED));
+    fw_str(&w, " dropped\n");
+
+    if (flight_slots) {
+        uint64_t head = __atomic_load_n(&flight_head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > flight_capacity ? head - flight_capacity : 0;
+        for (uint64_t t = first; t < head; t++) {
+            CTTSFlightRecord r;
+            if (!flight_read_slot(&flight_slots[t % flight_capacity], &r) || r.sequence != t) {
+                continue;
+            }
+            fw_str(&w, "seq=");
+            fw_uint(&w, r.sequence);
+            fw_str(&w, " time=");
+            fw_uint(&w, r.timestamp > 0 ? (uint64_t)r.timestamp : 0);
+            fw_str(&w, " total_ms=");
+            fw_fixed(&w, r.total_ms, 2);
+            for (int s = 0; s < CTTS_STAGE_COUNT; s++) {
+                fw_str(&w, " ");
+                fw_str(&w, flight_stage_names[s]);
+                fw_str(&w, "=");
+                fw_fixed(&w, r.stage_ms[s], 2);
+            }
+            fw_str(&w, " speed=");
+            fw_fixed(&w, r.speed, 2);
+            fw_str(&w, " config=");
+            fw_hex32(&w, r.config_fingerprint);
+            fw_str(&w, " units=");
+            fw_uint(&w, r.unit_count);
+            fw_str(&w, " samples=");
+            fw_uint(&w, r.output_samples);
+            fw_str(&w, " text_len=");
+            fw_uint(&w, r.text_len);
+            fw_str(&w, " text=\"");
+            fw_str(&w, r.text);
+            fw_str(&w, "\"\n");
         }
     }
 
-    /* Apply prosody effects to the final word using phrase intonation */
-    if (buf.count > word_start_sample) {
-        apply_phrase_intonation(buf.data + word_start_sample,
-                                buf.count - word_start_sample,
-                                &prosody.intonation,
-                                current_word_index, prosody.word_count,
-                                config->max_pitch_change);
+    fw_flush(&w);
+    return w.failed ? CTTS_ERR_FILE_WRITE : CTTS_OK;
+}
+
+static void flight_signal_handler(int sig) {
+    (void)sig;
+    int saved_errno = errno;
+    int fd = open(flight_dump_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd >= 0) {
+        ctts_flight_recorder_dump(fd);
+        close(fd);
+    }
+    errno = saved_errno;
+}
+
+int ctts_flight_recorder_install_signal(const char* path) {
+    if (!path || strlen(path) >= sizeof(flight_dump_path)) return CTTS_ERR_INVALID_ARG;
+    strcpy(flight_dump_path, path);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = flight_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    return sigaction(SIGUSR1, &sa, NULL) == 0 ? CTTS_OK : CTTS_ERR_INVALID_ARG;
+}
+
+static int synthesize_text(CTTS* engine, const char* text, int16_t** samples,
+                           size_t* sample_count, float speed, int quality) {
+    /* Stage timestamps, only taken while the flight recorder is on */
+    int timed = __atomic_load_n(&flight_enabled, __ATOMIC_ACQUIRE);
+    struct timespec marks[CTTS_STAGE_COUNT + 1];
+    if (timed) clock_gettime(CLOCK_MONOTONIC, &marks[0]);
+
+    /* Initialize lookup tables (once) */
+    init_fade_luts();
+
+    /* Get config */
+    CTTSConfig* config = &engine->config;
+
+    /* Load duration rules (if not already loaded) */
+    load_duration_rules("duration_rules.csv");
+
+    /* Normalize text (numbers, CSV rules, lowercase) */
+    char* normalized = normalize_input(text);
+    if (!normalized) return CTTS_ERR_OUT_OF_MEMORY;
+    if (timed) clock_gettime(CLOCK_MONOTONIC, &marks[CTTS_STAGE_NORMALIZE + 1]);
+
+    /* Analyze prosody context from original text (with pitch limit from config) */
+    ProsodyContext prosody;
+    analyze_prosody(text, &prosody, config->max_pitch_change);
+    if (timed) clock_gettime(CLOCK_MONOTONIC, &marks[CTTS_STAGE_PROSODY + 1]);
+
+    /* Initialize render state */
+    RenderState st;
+    int err = render_init(&st, &prosody, CTTS_SAMPLE_RATE * 10);  /* 10 seconds initial */
+    if (err != CTTS_OK) {
+        free(normalized);
+        return err;
     }
+    st.quality = quality;
+
+    engine->units_found = 0;
+    engine->units_missing = 0;
+    engine->peak_stretch_bytes = 0;
 
+    err = render_text(engine, &st, normalized, strlen(normalized));
     free(normalized);
+    if (err != CTTS_OK) {
+        free(st.buf.data);
+        return err;
+    }
+
+    if (config->print_units) {
+        fprintf(stderr, "\n");
+    }
+    if (timed) clock_gettime(CLOCK_MONOTONIC, &marks[CTTS_STAGE_RENDER + 1]);
+
+    /* Silence removal and prosody for the last word (if not followed by whitespace) */
+    render_finish_word(&st, config);
 
     /* Apply final fade-out */
     size_t final_fade = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
-    buffer_finalize(&buf, final_fade);
+    buffer_finalize(&st.buf, final_fade);
+    engine->peak_buffer_bytes = st.buf.capacity * sizeof(int16_t);
+    if (timed) clock_gettime(CLOCK_MONOTONIC, &marks[CTTS_STAGE_FINISH + 1]);
 
     /* Apply time stretching if needed */
     if (speed != 1.0f) {
         int16_t* stretched;
         size_t stretched_count;
-        err = time_stretch(buf.data, buf.count, &stretched, &stretched_count, speed);
+        err = stretch_to_buffer(st.buf.data, st.buf.count, speed, NULL,
+                                stretch_method(st.quality, config->stretch_mode), NULL,
+                                &stretched, &stretched_count, &engine->peak_stretch_bytes);
         if (err != CTTS_OK) {
-            free(buf.data);
+            free(st.buf.data);
             return err;
         }
-        free(buf.data);
+        free(st.buf.data);
         *samples = stretched;
         *sample_count = stretched_count;
     } else {
-        *samples = buf.data;
-        *sample_count = buf.count;
+        *samples = st.buf.data;
+        *sample_count = st.buf.count;
+    }
+
+    if (timed) {
+        clock_gettime(CLOCK_MONOTONIC, &marks[CTTS_STAGE_STRETCH + 1]);
+        if (flight_ms(&marks[0], &marks[CTTS_STAGE_COUNT]) > flight_threshold_ms) {
+            flight_record(engine, text, speed, marks, CTTS_STAGE_COUNT + 1, *sample_count);
+        }
     }
 
     return CTTS_OK;
 }
 
-/* ============================================================================
- * Main Program (Command Line Interface)
- * ============================================================================ */
+int ctts_synthesize(CTTS* engine, const char* text,
+                    int16_t** samples, size_t* sample_count, float speed) {
+    if (!engine || !text || !samples || !sample_count) {
+        return CTTS_ERR_INVALID_ARG;
+    }
 
-static void print_usage(const char* progname) {
-    fprintf(stderr, "CTTS - Concatenative Text-to-Speech Engine\n\n");
-    fprintf(stderr, "Usage:\n");
-    fprintf(stderr, "  Build database:\n");
-    fprintf(stderr, "    %s build <dataset_dir> <output.db>\n\n", progname);
-    fprintf(stderr, "  Synthesize speech:\n");
-    fprintf(stderr, "    %s synth <database.db> \"text\" <output.wav> [speed]\n\n", progname);
-    fprintf(stderr, "  Options:\n");
-    fprintf(stderr, "    speed  - Playback speed (0.5 to 2.0, default 1.0)\n");
-}
+    int quality = load_quality_level();
+    if (!__atomic_load_n(&load_enabled, __ATOMIC_ACQUIRE)) {
+        return synthesize_text(engine, text, samples, sample_count, speed, quality);
+    }
 
-int main(int argc, char* argv[]) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    __atomic_add_fetch(&load_in_flight, 1, __ATOMIC_RELAXED);
+    int err = synthesize_text(engine, text, samples, sample_count, speed, quality);
+    __atomic_sub_fetch(&load_in_flight, 1, __ATOMIC_RELAXED);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (err == CTTS_OK) load_observe(quality, flight_ms(&t0, &t1), *sample_count);
+    return err;
+}
+
+/*
+ * A span of text at its own speed, and what separates it from the previous
+ * one: a plain word pause (break_ms < 0) or an explicit break of break_ms.
+ */
+typedef struct {
+    const char* text;
+    float speed;
+    float break_ms;
+} SpeechPart;
+
+/*
+ * Parts are normalized one by one and rendered as a single text joined by
+ * word pauses or their breaks; each speed change sits in the middle of the
+ * pause before its part. Consecutive parts at the same speed share one
+ * contour step.
+ */
+static int synthesize_parts(CTTS* engine, const SpeechPart* parts, size_t part_count,
+                            int16_t** samples, size_t* sample_count) {
+    init_fade_luts();
+    CTTSConfig* config = &engine->config;
+    load_duration_rules("duration_rules.csv");
+
+    /* Raw text (for prosody) and normalized text, parts joined by spaces */
+    size_t raw_len = 0;
+    for (size_t i = 0; i < part_count; i++) raw_len += strlen(parts[i].text) + 1;
+    char* raw = malloc(raw_len + 1);
+    size_t* norm_starts = malloc((part_count + 1) * sizeof(size_t));
+    size_t* starts = malloc((part_count + 1) * sizeof(size_t));
+    float* speeds = malloc((part_count + 1) * sizeof(float));
+    char* norm = NULL;
+    size_t norm_len = 0, norm_cap = 0;
+    int err = (raw && norm_starts && starts && speeds) ? CTTS_OK : CTTS_ERR_OUT_OF_MEMORY;
+
+    size_t raw_pos = 0;
+    for (size_t i = 0; err == CTTS_OK && i < part_count; i++) {
+        size_t len = strlen(parts[i].text);
+        if (i > 0) raw[raw_pos++] = ' ';
+        memcpy(raw + raw_pos, parts[i].text, len);
+        raw_pos += len;
+
+        char* part = normalize_input(parts[i].text);
+        if (!part) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+            break;
+        }
+        size_t part_len = strlen(part);
+        if (norm_len + part_len + 2 > norm_cap) {
+            size_t cap = norm_cap ? norm_cap : 256;
+            while (cap < norm_len + part_len + 2) cap *= 2;
+            char* grown = realloc(norm, cap);
+            if (!grown) {
+                free(part);
+                err = CTTS_ERR_OUT_OF_MEMORY;
+                break;
+            }
+            norm = grown;
+            norm_cap = cap;
+        }
+        if (i > 0) norm[norm_len++] = ' ';     /* Ends the previous part */
+        norm_starts[i] = norm_len;
+        memcpy(norm + norm_len, part, part_len);
+        norm_len += part_len;
+        norm[norm_len] = '\0';
+        free(part);
+    }
+    if (raw) raw[raw_pos] = '\0';
+    if (norm_starts) norm_starts[part_count] = norm_len;
+
+    RenderState st;
+    st.buf.data = NULL;
+    if (err == CTTS_OK) {
+        ProsodyContext prosody;
+        analyze_prosody(raw, &prosody, config->max_pitch_change);
+        err = render_init(&st, &prosody, CTTS_SAMPLE_RATE * 10);
+    }
+
+    size_t steps = 0;
+    if (err == CTTS_OK) {
+        size_t word_pause_samples = (size_t)(config->word_pause_ms * CTTS_SAMPLE_RATE / 1000.0f);
+        engine->units_found = 0;
+        engine->units_missing = 0;
+        engine->peak_stretch_bytes = 0;
+
+        for (size_t i = 0; err == CTTS_OK && i < part_count; i++) {
+            /* Pause before the part; the space separator was rendered with the
+               previous part unless an explicit break replaces it */
+            size_t pause_samples = word_pause_samples;
+            if (parts[i].break_ms >= 0) {
+                /* Scaled so the break keeps its length once stretched */
+                float prev_speed = i > 0 ? parts[i - 1].speed : parts[i].speed;
+                double rate = 0.5 / segment_speed(prev_speed) +
+                              0.5 / segment_speed(parts[i].speed);
+                pause_samples = (size_t)(parts[i].break_ms * CTTS_SAMPLE_RATE / 1000.0 / rate);
+                if (st.buf.count == 0) {
+                    buffer_append_silence(&st.buf, pause_samples);
+                    st.word_start_sample = st.buf.count;
+                } else {
+                    render_word_break(&st, config, pause_samples);
+                }
+            }
+
+            size_t boundary = 0;
+            if (i > 0) {
+                boundary = (st.buf.count > pause_samples / 2) ?
+                           st.buf.count - pause_samples / 2 : 0;
+            }
+            if (steps > 0 && boundary <= starts[steps - 1]) {
+                speeds[steps - 1] = parts[i].speed;    /* Previous part rendered nothing */
+            } else if (steps == 0 || parts[i].speed != speeds[steps - 1]) {
+                starts[steps] = steps ? boundary : 0;
+                speeds[steps] = parts[i].speed;
+                steps++;
+            }
+
+            size_t chunk_end = norm_starts[i + 1];
+            if (i + 1 < part_count && parts[i + 1].break_ms >= 0) chunk_end--;
+            if (chunk_end > norm_starts[i]) {
+                err = render_text(engine, &st, norm + norm_starts[i],
+                                  chunk_end - norm_starts[i]);
+            }
+        }
+        if (steps == 0) {
+            starts[0] = 0;
+            speeds[0] = 1.0f;
+            steps = 1;
+        }
+    }
+
+    if (err == CTTS_OK) {
+        render_finish_word(&st, config);
+        size_t final_fade = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
+        buffer_finalize(&st.buf, final_fade);
+        engine->peak_buffer_bytes = st.buf.capacity * sizeof(int16_t);
+
+        if (steps == 1 && segment_speed(speeds[0]) == 1.0f) {
+            *samples = st.buf.data;
+            *sample_count = st.buf.count;
+            st.buf.data = NULL;
+        } else {
+            /* Collapse merged steps that ended up equal */
+            size_t n = 1;
+            for (size_t i = 1; i < steps; i++) {
+                if (speeds[i] != speeds[n - 1]) {
+                    starts[n] = starts[i];
+                    speeds[n++] = speeds[i];
+                }
+            }
+            SpeedContour contour = {starts, speeds, n};
+            err = stretch_to_buffer(st.buf.data, st.buf.count, speeds[0],
+                                    n > 1 ? &contour : NULL,
+                                    stretch_method(st.quality, config->stretch_mode), NULL,
+                                    samples, sample_count, &engine->peak_stretch_bytes);
+        }
+    }
+
+    free(st.buf.data);
+    free(norm);
+    free(raw);
+    free(norm_starts);
+    free(starts);
+    free(speeds);
+    return err;
+}
+
+int ctts_synthesize_speeds(CTTS* engine, const CTTSSpeedSpan* spans, size_t span_count,
+                           int16_t** samples, size_t* sample_count) {
+    if (!engine || (!spans && span_count > 0) || !samples || !sample_count) {
+        return CTTS_ERR_INVALID_ARG;
+    }
+    SpeechPart* parts = malloc((span_count ? span_count : 1) * sizeof(SpeechPart));
+    if (!parts) return CTTS_ERR_OUT_OF_MEMORY;
+    for (size_t i = 0; i < span_count; i++) {
+        if (!spans[i].text) {
+            free(parts);
+            return CTTS_ERR_INVALID_ARG;
+        }
+        parts[i].text = spans[i].text;
+        parts[i].speed = spans[i].speed;
+        parts[i].break_ms = -1.0f;
+    }
+    int err = synthesize_parts(engine, parts, span_count, samples, sample_count);
+    free(parts);
+    return err;
+}
+
+/* ============================================================================
+ * SSML Subset
+ *
+ * <speak>, <break time|strength>, <prosody rate> and <say-as
+ * interpret-as="digits|characters|date">. One walker reports text, pauses
+ * and rate changes in document order. ctts_synthesize_ssml() collects them
+ * into parts for synthesize_parts(), where rate changes become speed
+ * contour steps and breaks explicit pauses; sessions apply them as the
+ * markup arrives (see ctts_session_feed_ssml). say-as content is
+ * verbalized ahead of the text frontend. Other elements are skipped; their
+ * text is spoken.
+ * ============================================================================ */
+
+#define SSML_MAX_DEPTH 16
+#define SSML_MAX_BREAK_MS 10000.0f
+
+static const char* letter_names_pt[] = {
+    "á", "bê", "cê", "dê", "é", "efe", "gê", "agá", "i", "jota", "cá", "ele", "eme",
+    "ene", "ó", "pê", "quê", "erre", "esse", "tê", "u", "vê", "dáblio", "xis",
+    "ípsilon", "zê"
+};
+
+typedef struct {
+    SpeechPart* parts;
+    size_t count;
+    size_t capacity;
+    TextBuilder text;           /* Text of the part being collected */
+    float pending_break_ms;     /* Break before the next part, < 0 for none */
+    float speed;                /* Caller's speed */
+    float rate;                 /* Prosody rate of the part being collected */
+    int failed;
+} SsmlBuilder;
+
+/* Close the part being collected (if it has any text) at the given speed */
+static void ssml_flush(SsmlBuilder* b, float speed) {
+    const char* t = b->text.data ? b->text.data : "";
+    while (*t == ' ' || *t == '\t' || *t == '\n' || *t == '\r') t++;
+    if (*t == '\0') {
+        b->text.len = 0;
+        return;
+    }
+    if (b->count == b->capacity) {
+        size_t cap = b->capacity ? b->capacity * 2 : 8;
+        SpeechPart* grown = realloc(b->parts, cap * sizeof(SpeechPart));
+        if (!grown) {
+            b->failed = 1;
+            return;
+        }
+        b->parts = grown;
+        b->capacity = cap;
+    }
+    char* copy = strdup(t);
+    if (!copy) {
+        b->failed = 1;
+        return;
+    }
+    b->parts[b->count].text = copy;
+    b->parts[b->count].speed = speed;
+    b->parts[b->count].break_ms = b->pending_break_ms;
+    b->count++;
+    b->pending_break_ms = -1.0f;
+    b->text.len = 0;
+    b->text.data[0] = '\0';
+}
+
+/* Value of attribute name in a tag body, copied to out; 0 if absent */
+static int ssml_attr(const char* tag, size_t tag_len, const char* name,
+                     char* out, size_t out_size) {
+    size_t name_len = strlen(name);
+    for (size_t i = 0; i + name_len + 2 < tag_len; i++) {
+        if ((i > 0 && !isspace((unsigned char)tag[i - 1])) ||
+            strncmp(tag + i, name, name_len) != 0 || tag[i + name_len] != '=') {
+            continue;
+        }
+        char quote = tag[i + name_len + 1];
+        if (quote != '"' && quote != '\'') return 0;
+        const char* v = tag + i + name_len + 2;
+        const char* end = memchr(v, quote, tag_len - (size_t)(v - tag));
+        if (!end || (size_t)(end - v) >= out_size) return 0;
+        memcpy(out, v, (size_t)(end - v));
+        out[end - v] = '\0';
+        return 1;
+    }
+    return 0;
+}
+
+/* Decode the entity at p into tb; returns the bytes consumed */
+static size_t ssml_entity(TextBuilder* tb, const char* p) {
+    static const struct { const char* name; const char* text; } entities[] = {
+        {"&amp;", "&"}, {"&lt;", "<"}, {"&gt;", ">"}, {"&quot;", "\""}, {"&apos;", "'"}
+    };
+    for (size_t i = 0; i < sizeof(entities) / sizeof(entities[0]); i++) {
+        size_t n = strlen(entities[i].name);
+        if (strncmp(p, entities[i].name, n) == 0) {
+            tb_append(tb, entities[i].text, 1);
+            return n;
+        }
+    }
+    tb_append(tb, p, 1);
+    return 1;
+}
+
+/* Copy len bytes of SSML character data into tb, decoding entities */
+static void ssml_text(TextBuilder* tb, const char* p, size_t len) {
+    const char* end = p + len;
+    while (p < end) {
+        const char* amp = memchr(p, '&', (size_t)(end - p));
+        if (!amp) amp = end;
+        tb_append(tb, p, (size_t)(amp - p));
+        p = amp;
+        if (p < end) p += ssml_entity(tb, p);
+    }
+}
+
+/* rate="x-slow|slow|medium|fast|x-fast|N%|+N%|-N%|N" against the enclosing rate */
+static float ssml_rate(const char* v, float current) {
+    static const struct { const char* name; float rate; } labels[] = {
+        {"x-slow", 0.5f}, {"slow", 0.75f}, {"medium", 1.0f}, {"default", 1.0f},
+        {"fast", 1.25f}, {"x-fast", 1.5f}
+    };
+    for (size_t i = 0; i < sizeof(labels) / sizeof(labels[0]); i++) {
+        if (strcmp(v, labels[i].name) == 0) return labels[i].rate;
+    }
+    char* end;
+    float n = strtof(v, &end);
+    if (end == v) return current;
+    int relative = (v[0] == '+' || v[0] == '-');
+    if (*end == '%') return relative ? current * (1.0f + n / 100.0f) : n / 100.0f;
+    return relative ? current + n : n;
+}
+
+/* <break time="500ms|2s" strength="none|x-weak|weak|medium|strong|x-strong"/> */
+static float ssml_break_ms(const char* tag, size_t tag_len, const CTTSConfig* config) {
+    char v[32];
+    if (ssml_attr(tag, tag_len, "time", v, sizeof(v))) {
+        char* end;
+        float t = strtof(v, &end);
+        if (strcmp(end, "s") == 0) t *= 1000.0f;
+        if (t < 0) t = 0;
+        return t > SSML_MAX_BREAK_MS ? SSML_MAX_BREAK_MS : t;
+    }
+    if (!ssml_attr(tag, tag_len, "strength", v, sizeof(v))) strcpy(v, "medium");
+    if (strcmp(v, "none") == 0) return 0.0f;
+    if (strcmp(v, "x-weak") == 0) return config->word_pause_ms;
+    if (strcmp(v, "weak") == 0) return get_punctuation_pause_ms(',', config);
+    if (strcmp(v, "strong") == 0) return get_punctuation_pause_ms('.', config);
+    if (strcmp(v, "x-strong") == 0) return get_punctuation_pause_ms('!', config);
+    return get_punctuation_pause_ms(';', config);
+}
+
+/*
+ * Dates for the number expander: d/m/y in the order given by format
+ * (dmy by default, ymd when the first field has four digits, dm for two
+ * fields; mdy and md on request).
+ * Falls back to the text as written.
+ */
+static void ssml_say_date(TextBuilder* tb, const char* text, const char* format) {
+    int fields[3];
+    size_t widths[3];
+    size_t n = 0;
+    const char* p = text;
+    while (*p && n < 3) {
+        while (*p && !isdigit((unsigned char)*p)) p++;
+        if (!*p) break;
+        size_t w = count_digits(p);
+        fields[n] = (w <= 4) ? digits_value(p, w) : -1;
+        widths[n++] = w;
+        p += w;
+    }
+
+    int day = -1, month = -1, year = -1, year_width = 4;
+    if (!format[0]) format = (n == 2) ? "dm" : (n == 3 && widths[0] == 4) ? "ymd" : "dmy";
+    if (strlen(format) == n) {
+        for (size_t i = 0; i < n; i++) {
+            if (format[i] == 'd') day = fields[i];
+            else if (format[i] == 'm') month = fields[i];
+            else if (format[i] == 'y') {
+                year = fields[i];
+                year_width = (widths[i] == 2) ? 2 : 4;
+            }
+        }
+    }
+
+    char date[32];
+    if (day >= 1 && day <= 31 && month >= 1 && month <= 12) {
+        if (year >= 0) {
+            snprintf(date, sizeof(date), " %d/%d/%0*d ", day, month, year_width, year);
+            tb_append(tb, date, strlen(date));
+        } else {
+            /* A bare d/m is not read as a date by the expander, so spell it here */
+            pthread_once(&number_words_once, init_number_words);
+            tb_append(tb, " ", 1);
+            verbalize_day_month(tb, day, month);
+            tb_append(tb, " ", 1);
+        }
+    } else {
+        tb_append(tb, " ", 1);
+        tb_append(tb, text, strlen(text));
+        tb_append(tb, " ", 1);
+    }
+}
+
+/* Verbalize say-as content into tb */
+static void ssml_say_as(TextBuilder* tb, const char* interpret_as, const char* format,
+                        const char* text) {
+    if (strcmp(interpret_as, "date") == 0) {
+        ssml_say_date(tb, text, format);
+        return;
+    }
+    int characters = (strcmp(interpret_as, "characters") == 0 ||
+                      strcmp(interpret_as, "spell-out") == 0);
+    if (!characters && strcmp(interpret_as, "digits") != 0) {
+        tb_append(tb, text, strlen(text));
+        return;
+    }
+
+    tb_append(tb, " ", 1);
+    for (const char* p = text; *p; ) {
+        unsigned char c = (unsigned char)*p;
+        if (isdigit(c)) {
+            tb_words(tb, digits_pt[c - '0']);
+            p++;
+        } else if (characters && isalpha(c)) {
+            tb_words(tb, letter_names_pt[tolower(c) - 'a']);
+            p++;
+        } else if (characters && c >= 0x80) {
+            /* Accented letters are read as written */
+            size_t n = 1;
+            while ((p[n] & 0xC0) == 0x80) n++;
+            tb_word(tb, p, n);
+            p += n;
+        } else {
+            if (!characters && !isspace(c) && !ispunct(c)) tb_word(tb, p, 1);
+            p++;
+        }
+    }
+    tb_append(tb, " ", 1);
+}
+
+/* Prosody nesting while walking a document */
+typedef struct {
+    float rates[SSML_MAX_DEPTH];
+    size_t depth;
+    float rate;                 /* Multiplier of the caller's speed */
+} SsmlState;
+
+/* What the walker reports, in document order */
+typedef struct {
+    int (*text)(void* ctx, const char* text, size_t len);
+    int (*pause)(void* ctx, float ms);
+    int (*rate)(void* ctx, float rate);     /* At every prosody tag, changed or not */
+} SsmlEvents;
+
+static void ssml_state_init(SsmlState* ps) {
+    ps->depth = 0;
+    ps->rate = 1.0f;
+}
+
+/*
+ * Walk the NUL-terminated markup at p and report its events. Unless final,
+ * stop before anything not complete yet (a tag without its '>', say-as
+ * without its closing tag, a partial entity at the end) and set *consumed
+ * to where the next call resumes. With final, those are format errors.
+ */
+static int ssml_walk(SsmlState* ps, const char* p, int final, const CTTSConfig* config,
+                     const SsmlEvents* ev, void* ctx, size_t* consumed) {
+    const char* start = p;
+    TextBuilder tb = {NULL, 0, 0, 0};
+    tb_append(&tb, "", 0);
+    int err = tb.failed ? CTTS_ERR_OUT_OF_MEMORY : CTTS_OK;
+
+    while (*p && err == CTTS_OK) {
+        if (*p != '<') {
+            const char* lt = strchr(p, '<');
+            size_t n = lt ? (size_t)(lt - p) : strlen(p);
+            if (!lt && !final) {
+                /* Entities are at most 6 bytes; hold back a trailing "&am" */
+                for (size_t i = n; i-- > 0 && n - i <= 6; ) {
+                    if (p[i] == ';') break;
+                    if (p[i] == '&') {
+                        n = i;
+                        break;
+                    }
+                }
+                if (n == 0) break;
+            }
+            tb.len = 0;
+            ssml_text(&tb, p, n);
+            err = tb.failed ? CTTS_ERR_OUT_OF_MEMORY : ev->text(ctx, tb.data, tb.len);
+            p += n;
+            continue;
+        }
+        if (strncmp(p, "<!--", 4) == 0 || strncmp(p, "<?", 2) == 0) {
+            const char* close = strstr(p, p[1] == '!' ? "-->" : "?>");
+            if (!close) {
+                if (final) err = CTTS_ERR_INVALID_FORMAT;
+                break;
+            }
+            p = close + (p[1] == '!' ? 3 : 2);
+            continue;
+        }
+
+        const char* gt = strchr(p, '>');
+        if (!gt) {
+            if (final) err = CTTS_ERR_INVALID_FORMAT;
+            break;
+        }
+        const char* tag = p + 1;
+        size_t tag_len = (size_t)(gt - tag);
+        int closing = (tag[0] == '/');
+        const char* name = tag + closing;
+        size_t name_len = strcspn(name, " \t\r\n/>");
+
+        if (name_len == 5 && strncmp(name, "break", 5) == 0 && !closing) {
+            err = ev->pause(ctx, ssml_break_ms(tag, tag_len, config));
+        } else if (name_len == 7 && strncmp(name, "prosody", 7) == 0) {
+            if (closing) {
+                if (ps->depth > 0) ps->rate = ps->rates[--ps->depth];
+            } else if (tag[tag_len - 1] != '/') {
+                char v[32];
+                if (ps->depth < SSML_MAX_DEPTH) ps->rates[ps->depth++] = ps->rate;
+                if (ssml_attr(tag, tag_len, "rate", v, sizeof(v))) ps->rate = ssml_rate(v, ps->rate);
+            }
+            err = ev->rate(ctx, ps->rate);
+        } else if (name_len == 6 && strncmp(name, "say-as", 6) == 0 && !closing) {
+            const char* close = strstr(gt + 1, "</say-as>");
+            if (!close) {
+                if (final) err = CTTS_ERR_INVALID_FORMAT;
+                break;
+            }
+            char interpret_as[32] = "", format[16] = "";
+            ssml_attr(tag, tag_len, "interpret-as", interpret_as, sizeof(interpret_as));
+            ssml_attr(tag, tag_len, "format", format, sizeof(format));
+            TextBuilder content = {NULL, 0, 0, 0};
+            tb_append(&content, "", 0);
+            ssml_text(&content, gt + 1, (size_t)(close - gt - 1));
+            tb.len = 0;
+            if (!content.failed) ssml_say_as(&tb, interpret_as, format, content.data);
+            err = (content.failed || tb.failed) ? CTTS_ERR_OUT_OF_MEMORY
+                                                : ev->text(ctx, tb.data, tb.len);
+            free(content.data);
+            p = close + strlen("</say-as>");
+            continue;
+        }
+        /* Other elements (speak, p, s, ...) only contribute their text */
+        p = gt + 1;
+    }
+
+    free(tb.data);
+    *consumed = (size_t)(p - start);
+    return err;
+}
+
+/* Collecting a whole document into parts for synthesize_parts() */
+static int ssml_build_text(void* ctx, const char* text, size_t len) {
+    SsmlBuilder* b = (SsmlBuilder*)ctx;
+    tb_append(&b->text, text, len);
+    return b->text.failed ? CTTS_ERR_OUT_OF_MEMORY : CTTS_OK;
+}
+
+static int ssml_build_pause(void* ctx, float ms) {
+    SsmlBuilder* b = (SsmlBuilder*)ctx;
+    ssml_flush(b, b->speed * b->rate);
+    b->pending_break_ms = (b->pending_break_ms > 0 ? b->pending_break_ms : 0.0f) + ms;
+    return b->failed ? CTTS_ERR_OUT_OF_MEMORY : CTTS_OK;
+}
+
+static int ssml_build_rate(void* ctx, float rate) {
+    SsmlBuilder* b = (SsmlBuilder*)ctx;
+    ssml_flush(b, b->speed * b->rate);
+    b->rate = rate;
+    return b->failed ? CTTS_ERR_OUT_OF_MEMORY : CTTS_OK;
+}
+
+static const SsmlEvents ssml_build_events = {
+    ssml_build_text, ssml_build_pause, ssml_build_rate
+};
+
+int ctts_synthesize_ssml(CTTS* engine, const char* ssml, int16_t** samples,
+                         size_t* sample_count, float speed) {
+    if (!engine || !ssml || !samples || !sample_count) return CTTS_ERR_INVALID_ARG;
+
+    SsmlBuilder b;
+    memset(&b, 0, sizeof(b));
+    b.pending_break_ms = -1.0f;
+    b.speed = speed;
+    b.rate = 1.0f;
+    tb_append(&b.text, "", 0);
+
+    SsmlState ps;
+    ssml_state_init(&ps);
+    size_t consumed;
+    int err = ssml_walk(&ps, ssml, 1, &engine->config, &ssml_build_events, &b, &consumed);
+
+    if (err == CTTS_OK) ssml_flush(&b, speed * b.rate);
+    if (err == CTTS_OK && b.pending_break_ms >= 0) {
+        /* Trailing break: an empty part that is only its pause */
+        ssml_flush(&b, speed * b.rate);
+        if (b.count == b.capacity) {
+            SpeechPart* grown = realloc(b.parts, (b.capacity + 1) * sizeof(SpeechPart));
+            if (grown) {
+                b.parts = grown;
+                b.capacity++;
+            } else {
+                b.failed = 1;
+            }
+        }
+        if (!b.failed) {
+            b.parts[b.count].text = strdup("");
+            b.parts[b.count].speed = speed * b.rate;
+            b.parts[b.count].break_ms = b.pending_break_ms;
+            if (b.parts[b.count].text) b.count++;
+            else b.failed = 1;
+        }
+    }
+    if (err == CTTS_OK && (b.failed || b.text.failed)) err = CTTS_ERR_OUT_OF_MEMORY;
+
+    if (err == CTTS_OK) err = synthesize_parts(engine, b.parts, b.count, samples, sample_count);
+
+    for (size_t i = 0; i < b.count; i++) free((char*)b.parts[i].text);
+    free(b.parts);
+    free(b.text.data);
+    return err;
+}
+
+/* ============================================================================
+ * Batch Synthesis
+ *
+ * Many short prompts are run stage by stage instead of request by request:
+ * the text frontend for every text, then selection and concatenation, then
+ * time stretching of the voiced pieces, where identical pieces across the
+ * batch are stretched once and copied. Each stage's rules, tables and code
+ * stay hot across the batch, and the output of every text is the same as
+ * from ctts_synthesize().
+ * ============================================================================ */
+
+/*
+ * Stretch every voiced piece of the batch. Templated prompts repeat pieces
+ * (a greeting, the words before a number), so identical pieces are stretched
+ * once and copied. On error no pieces are returned and each text falls back
+ * to stretching on its own.
+ */
+static int batch_stretch_pieces(RenderState* st, size_t count,
+                                const size_t* first_piece, size_t piece_count,
+                                float speed, int method, StretchedPiece** out) {
+    *out = NULL;
+    if (piece_count == 0) return CTTS_OK;
+
+    size_t* starts = malloc(piece_count * sizeof(size_t));
+    size_t* lengths = malloc(piece_count * sizeof(size_t));
+    const int16_t** data = malloc(piece_count * sizeof(int16_t*));
+    uint32_t* hashes = malloc(piece_count * sizeof(uint32_t));
+    size_t table_size = 16;
+    while (table_size < piece_count * 2) table_size *= 2;
+    size_t* table = malloc(table_size * sizeof(size_t));     /* Piece index + 1, 0 = empty */
+    StretchedPiece* pieces = calloc(piece_count, sizeof(StretchedPiece));
+    int err = (starts && lengths && data && hashes && table && pieces) ?
+              CTTS_OK : CTTS_ERR_OUT_OF_MEMORY;
+
+    if (err == CTTS_OK) {
+        memset(table, 0, table_size * sizeof(size_t));
+        for (size_t i = 0; i < count; i++) {
+            if (first_piece[i + 1] == first_piece[i]) continue;
+            segment_voiced_pieces(st[i].buf.data, st[i].buf.count, speed,
+                                  starts + first_piece[i], lengths + first_piece[i]);
+            for (size_t j = first_piece[i]; j < first_piece[i + 1]; j++) {
+                data[j] = st[i].buf.data + starts[j];
+            }
+        }
+    }
+    for (size_t j = 0; j < piece_count && err == CTTS_OK; j++) {
+        hashes[j] = ctts_hash((const char*)data[j], lengths[j] * sizeof(int16_t));
+
+        /* Earlier identical piece? */
+        size_t slot = hashes[j] & (table_size - 1);
+        size_t same = 0;
+        while (table[slot]) {
+            size_t k = table[slot] - 1;
+            if (hashes[k] == hashes[j] && lengths[k] == lengths[j] &&
+                memcmp(data[k], data[j], lengths[j] * sizeof(int16_t)) == 0) {
+                same = k + 1;
+                break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (same) {
+            const StretchedPiece* src = &pieces[same - 1];
+            pieces[j].samples = malloc((src->count ? src->count : 1) * sizeof(int16_t));
+            if (!pieces[j].samples) {
+                err = CTTS_ERR_OUT_OF_MEMORY;
+                break;
+            }
+            memcpy(pieces[j].samples, src->samples, src->count * sizeof(int16_t));
+            pieces[j].count = src->count;
+        } else {
+            table[slot] = j + 1;
+            err = time_stretch(data[j], lengths[j], &pieces[j].samples, &pieces[j].count,
+                               speed, method, NULL);
+        }
+    }
+
+    if (err != CTTS_OK && pieces) {
+        for (size_t j = 0; j < piece_count; j++) free(pieces[j].samples);
+        free(pieces);
+        pieces = NULL;
+    }
+    free(starts);
+    free(lengths);
+    free(data);
+    free(hashes);
+    free(table);
+    *out = pieces;
+    return err;
+}
+
+int ctts_synthesize_batch(CTTS* engine, const char* const* texts, size_t count,
+                          float speed, CTTSBatchItem* results) {
+    if (!engine || (count > 0 && (!texts || !results))) return CTTS_ERR_INVALID_ARG;
+
+    init_fade_luts();
+    load_duration_rules("duration_rules.csv");
+
+    CTTSConfig* config = &engine->config;
+    int quality = load_quality_level();
+    int method = stretch_method(quality, config->stretch_mode);
+
+    RenderState* st = calloc(count ? count : 1, sizeof(RenderState));
+    char** normalized = calloc(count ? count : 1, sizeof(char*));
+    size_t* first_piece = calloc(count + 1, sizeof(size_t));
+    StretchedPiece* pieces = NULL;
+    if (!st || !normalized || !first_piece) {
+        free(st);
+        free(normalized);
+        free(first_piece);
+        return CTTS_ERR_OUT_OF_MEMORY;
+    }
+    for (size_t i = 0; i < count; i++) {
+        results[i].samples = NULL;
+        results[i].sample_count = 0;
+        results[i].status = texts[i] ? CTTS_OK : CTTS_ERR_INVALID_ARG;
+    }
+
+    /* Stage 1: text frontend and prosody */
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].status != CTTS_OK) continue;
+        normalized[i] = normalize_input(texts[i]);
+        if (!normalized[i]) {
+            results[i].status = CTTS_ERR_OUT_OF_MEMORY;
+            continue;
+        }
+        ProsodyContext prosody;
+        analyze_prosody(texts[i], &prosody, config->max_pitch_change);
+
+        /* Sized from the text instead of ctts_synthesize()'s 10 seconds */
+        size_t capacity = (strlen(normalized[i]) + 4) * (CTTS_SAMPLE_RATE / 8);
+        results[i].status = render_init(&st[i], &prosody, capacity);
+        st[i].quality = quality;
+    }
+
+    /* Stage 2: unit selection, concatenation, last word and final fade */
+    engine->units_found = 0;
+    engine->units_missing = 0;
+    size_t final_fade = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].status == CTTS_OK) {
+            results[i].status = render_text(engine, &st[i], normalized[i],
+                                            strlen(normalized[i]));
+        }
+        free(normalized[i]);
+        if (results[i].status != CTTS_OK) continue;
+        render_finish_word(&st[i], config);
+        buffer_finalize(&st[i].buf, final_fade);
+    }
+    free(normalized);
+
+    /* Stage 3: WSOLA over the batch's distinct voiced pieces */
+    size_t piece_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        first_piece[i] = piece_count;
+        if (results[i].status == CTTS_OK && speed != 1.0f) {
+            piece_count += segment_voiced_pieces(st[i].buf.data, st[i].buf.count, speed,
+                                                 NULL, NULL);
+        }
+    }
+    first_piece[count] = piece_count;
+
+    int err = batch_stretch_pieces(st, count, first_piece, piece_count,
+                                   speed, method, &pieces);
+
+    /* Stage 4: splice stretched pieces and scaled silence into each output */
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].status != CTTS_OK) {
+            free(st[i].buf.data);
+            continue;
+        }
+        if (speed == 1.0f) {
+            results[i].samples = st[i].buf.data;
+            results[i].sample_count = st[i].buf.count;
+            continue;
+        }
+        int ready = (err == CTTS_OK && first_piece[i + 1] > first_piece[i]);
+        results[i].status = stretch_to_buffer(st[i].buf.data, st[i].buf.count, speed, NULL,
+                                              method, ready ? pieces + first_piece[i] : NULL,
+                                              &results[i].samples, &results[i].sample_count,
+                                              NULL);
+        free(st[i].buf.data);
+    }
+
+    /* Pieces left over by texts that failed while splicing */
+    if (pieces) {
+        for (size_t j = 0; j < piece_count; j++) free(pieces[j].samples);
+    }
+    free(pieces);
+    free(first_piece);
+    free(st);
+
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].status != CTTS_OK) return results[i].status;
+    }
+    return CTTS_OK;
+}
+
+/* ============================================================================
+ * Scatter-Gather Output
+ *
+ * At speed 1.0 with the per-unit DSP left out, almost every output sample is
+ * a verbatim copy of mapped unit audio. This renderer returns the output as
+ * a list of spans instead: references into the database for untouched
+ * audio, the shared zero block for pauses, and small owned chunks only
+ * where samples are computed (crossfades and fades). Memory traffic per
+ * request then follows the number of joins, not the duration.
+ * ============================================================================ */
+
+typedef struct {
+    const int16_t* base;    /* Database or zero block; NULL = owned arena */
+    size_t offset;          /* Into base, or into the arena */
+    size_t count;
+} SpanEntry;
+
+typedef struct {
+    SpanEntry* spans;
+    size_t span_count;
+    size_t span_capacity;
+    SampleBuffer owned;     /* Arena for computed samples */
+    size_t total;           /* Output samples so far */
+} SpanBuilder;
+
+static const int16_t* span_data(const SpanBuilder* sb, const SpanEntry* e) {
+    return (e->base ? e->base : sb->owned.data) + e->offset;
+}
+
+/* Append a span, merging it into the last one when contiguous */
+static int span_push(SpanBuilder* sb, const int16_t* base, size_t offset, size_t count) {
+    if (count == 0) return CTTS_OK;
+    sb->total += count;
+
+    if (sb->span_count > 0) {
+        SpanEntry* last = &sb->spans[sb->span_count - 1];
+        if (last->base == base && last->offset + last->count == offset) {
+            last->count += count;
+            return CTTS_OK;
+        }
+    }
+    if (sb->span_count == sb->span_capacity) {
+        size_t cap = sb->span_capacity ? sb->span_capacity * 2 : 64;
+        SpanEntry* grown = realloc(sb->spans, cap * sizeof(SpanEntry));
+        if (!grown) return CTTS_ERR_OUT_OF_MEMORY;
+        sb->spans = grown;
+        sb->span_capacity = cap;
+    }
+    SpanEntry* e = &sb->spans[sb->span_count++];
+    e->base = base;
+    e->offset = offset;
+    e->count = count;
+    return CTTS_OK;
+}
+
+static int span_push_silence(SpanBuilder* sb, size_t count) {
+    while (count > 0) {
+        size_t n = count < SILENCE_BLOCK_LEN ? count : SILENCE_BLOCK_LEN;
+        int err = span_push(sb, silence_block, 0, n);
+        if (err != CTTS_OK) return err;
+        count -= n;
+    }
+    return CTTS_OK;
+}
+
+/*
+ * Make the last n output samples writable: they are moved into one owned
+ * chunk (unless they already are) and its arena offset is returned.
+ */
+static int span_own_tail(SpanBuilder* sb, size_t n, size_t* offset) {
+    SpanEntry* last = sb->span_count ? &sb->spans[sb->span_count - 1] : NULL;
+    if (last && !last->base && last->count >= n) {
+        *offset = last->offset + last->count - n;
+        return CTTS_OK;
+    }
+
+    int err = buffer_grow(&sb->owned, n);
+    if (err != CTTS_OK) return err;
+    size_t dst = sb->owned.count;
+    size_t remaining = n;
+    while (remaining > 0) {
+        last = &sb->spans[sb->span_count - 1];
+        size_t take = last->count < remaining ? last->count : remaining;
+        memcpy(sb->owned.data + dst + remaining - take,
+               span_data(sb, last) + last->count - take, take * sizeof(int16_t));
+        last->count -= take;
+        if (last->count == 0) sb->span_count--;
+        remaining -= take;
+    }
+    sb->owned.count += n;
+    sb->total -= n;
+    *offset = dst;
+    return span_push(sb, NULL, dst, n);
+}
+
+/* Fade out the end of the output; pauses are already silent */
+static int span_fade_out(SpanBuilder* sb, size_t fade_samples) {
+    if (sb->total == 0 || fade_samples == 0) return CTTS_OK;
+    if (sb->spans[sb->span_count - 1].base == silence_block) return CTTS_OK;
+    if (fade_samples > sb->total) fade_samples = sb->total;
+
+    size_t offset;
+    int err = span_own_tail(sb, fade_samples, &offset);
+    if (err != CTTS_OK) return err;
+    apply_fade_out(sb->owned.data + offset, fade_samples, fade_samples);
+    return CTTS_OK;
+}
+
+/* Append a unit: fade-in after a boundary, else crossfade with the output */
+static int span_append_unit(SpanBuilder* sb, const int16_t* unit, size_t count,
+                            size_t crossfade_samples, size_t fade_in_samples,
+                            int after_word_boundary, const int16_t* audio) {
+    size_t head = 0;
+    int err;
+
+    if (sb->total == 0 || after_word_boundary) {
+        head = fade_in_samples < count ? fade_in_samples : count;
+        if (head > 0) {
+            err = buffer_grow(&sb->owned, head);
+            if (err != CTTS_OK) return err;
+            int16_t* dst = sb->owned.data + sb->owned.count;
+            memcpy(dst, unit, head * sizeof(int16_t));
+            apply_fade_in(dst, head, head);
+            err = span_push(sb, NULL, sb->owned.count, head);
+            sb->owned.count += head;
+            if (err != CTTS_OK) return err;
+        }
+    } else if (crossfade_samples > 0) {
+        head = crossfade_samples;
+        if (head > sb->total) head = sb->total;
+        if (head > count) head = count;
+        if (head > 0) {
+            size_t offset;
+            err = span_own_tail(sb, head, &offset);
+            if (err != CTTS_OK) return err;
+
+            /* Same mix as buffer_mix_crossfade() */
+            int16_t* mix = sb->owned.data + offset;
+            float inv_crossfade = 1.0f / (float)head;
+            for (size_t i = 0; i < head; i++) {
+                float t = (float)i * inv_crossfade;
+                int32_t mixed = (int32_t)(mix[i] * fast_fade_out(t) + unit[i] * fast_fade_in(t));
+                if (mixed > 32767) mixed = 32767;
+                else if (mixed < -32768) mixed = -32768;
+                mix[i] = (int16_t)mixed;
+            }
+        }
+    }
+
+    return span_push(sb, audio, (size_t)(unit - audio) + head, count - head);
+}
+
+int ctts_synthesize_spans(CTTS* engine, const char* text, CTTSSpanList* out) {
+    if (!engine || !text || !out) return CTTS_ERR_INVALID_ARG;
+    memset(out, 0, sizeof(*out));
+
+    init_fade_luts();
+    CTTSConfig* config = &engine->config;
+
+    char* normalized = normalize_input(text);
+    if (!normalized) return CTTS_ERR_OUT_OF_MEMORY;
+
+    SpanBuilder sb;
+    memset(&sb, 0, sizeof(sb));
+    int err = buffer_init(&sb.owned, CTTS_SAMPLE_RATE / 4);
+    if (err != CTTS_OK) {
+        free(normalized);
+        return err;
+    }
+
+    size_t word_pause_samples = (size_t)(config->word_pause_ms * CTTS_SAMPLE_RATE / 1000.0f);
+    size_t unknown_silence = (size_t)(config->unknown_silence_ms * CTTS_SAMPLE_RATE / 1000.0f);
+    size_t fade_samples = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
+    size_t fade_in_samples = (size_t)(config->fade_in_ms * CTTS_SAMPLE_RATE / 1000.0f);
+
+    const char* prev_unit_text = NULL;
+    size_t prev_unit_len = 0;
+    int prev_was_word_boundary = 1;
+    PhonemeType prev_end_phoneme = PHONEME_OTHER;
+    engine->units_found = 0;
+    engine->units_missing = 0;
+
+    const char* pos = normalized;
+    const char* end = normalized + strlen(normalized);
+    while (pos < end && err == CTTS_OK) {
+        SelectionToken tok;
+        select_next(engine, &pos, prev_was_word_boundary, &tok);
+
+        switch (tok.kind) {
+        case SEL_WORD_BREAK:
+            err = span_fade_out(&sb, fade_samples);
+            if (err == CTTS_OK) err = span_push_silence(&sb, word_pause_samples);
+            prev_was_word_boundary = 1;
+            prev_unit_text = NULL;
+            prev_unit_len = 0;
+            prev_end_phoneme = PHONEME_OTHER;
+            break;
+
+        case SEL_SOFT_BREAK:
+        case SEL_SKIP:
+            break;
+
+        case SEL_PUNCT: {
+            float pause_ms = get_punctuation_pause_ms(*tok.text, config);
+            err = span_fade_out(&sb, fade_samples);
+            if (err == CTTS_OK) {
+                err = span_push_silence(&sb, (size_t)(pause_ms * CTTS_SAMPLE_RATE / 1000.0f));
+            }
+            prev_was_word_boundary = 1;
+            break;
+        }
+
+        case SEL_UNIT: {
+            size_t unit_samples;
+            const int16_t* unit_audio = get_unit_samples(engine, tok.unit_idx, &unit_samples);
+            CTTSIndexEntry* entry = &engine->index[tok.unit_idx];
+            const char* unit_text = engine->strings + entry->string_offset;
+
+            PhonemeType curr_start_phoneme = classify_first_phoneme(unit_text, entry->string_len);
+            float crossfade_ms = config->crossfade_ms;
+            if (!prev_was_word_boundary && prev_unit_text != NULL) {
+                crossfade_ms = join_crossfade_ms(prev_unit_text, prev_unit_len,
+                                                 prev_end_phoneme, curr_start_phoneme, config);
+            }
+
+            err = span_append_unit(&sb, unit_audio, unit_samples,
+                                   (size_t)(crossfade_ms * CTTS_SAMPLE_RATE / 1000.0f),
+                                   fade_in_samples, prev_was_word_boundary, engine->audio);
+
+            prev_unit_text = unit_text;
+            prev_unit_len = entry->string_len;
+            prev_end_phoneme = classify_last_phoneme(unit_text, entry->string_len);
+            prev_was_word_boundary = 0;
+            engine->units_found++;
+            break;
+        }
+
+        case SEL_MISSING:
+            err = span_push_silence(&sb, unknown_silence);
+            engine->units_missing++;
+            prev_unit_text = NULL;
+            prev_unit_len = 0;
+            prev_end_phoneme = PHONEME_OTHER;
+            break;
+        }
+    }
+    free(normalized);
+    if (err == CTTS_OK) err = span_fade_out(&sb, fade_samples);
+
+    if (err == CTTS_OK) {
+        out->spans = malloc((sb.span_count ? sb.span_count : 1) * sizeof(CTTSSpan));
+        if (!out->spans) err = CTTS_ERR_OUT_OF_MEMORY;
+    }
+    if (err != CTTS_OK) {
+        free(sb.spans);
+        free(sb.owned.data);
+        memset(out, 0, sizeof(*out));
+        return err;
+    }
+
+    /* The arena no longer moves: resolve offsets to pointers */
+    for (size_t i = 0; i < sb.span_count; i++) {
+        const SpanEntry* e = &sb.spans[i];
+        out->spans[i].samples = span_data(&sb, e);
+        out->spans[i].sample_count = e->count;
+        if (!e->base) out->owned_samples += e->count;
+        else if (e->base == silence_block) out->silence_samples += e->count;
+        else out->referenced_samples += e->count;
+    }
+    out->span_count = sb.span_count;
+    out->sample_count = sb.total;
+    out->owned = sb.owned.data;
+    free(sb.spans);
+    return CTTS_OK;
+}
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+int ctts_write_wav_spans(int fd, const CTTSSpanList* list, int sample_rate) {
+    if (fd < 0 || !list) return CTTS_ERR_INVALID_ARG;
+
+    uint8_t header[CTTS_WAV_HEADER_SIZE];
+    wav_fill_header(header, list->sample_count, sample_rate);
+
+    /* Header plus up to IOV_MAX - 1 spans per call, resumed after short writes */
+    struct iovec iov[IOV_MAX];
+    size_t next = 0;
+    int with_header = 1;
+    while (with_header || next < list->span_count) {
+        int n = 0;
+        if (with_header) {
+            iov[n].iov_base = header;
+            iov[n].iov_len = sizeof(header);
+            n++;
+        }
+        while (n < IOV_MAX && next < list->span_count) {
+            iov[n].iov_base = (void*)list->spans[next].samples;
+            iov[n].iov_len = list->spans[next].sample_count * sizeof(int16_t);
+            n++;
+            next++;
+        }
+        with_header = 0;
+
+        struct iovec* v = iov;
+        while (n > 0) {
+            ssize_t written = writev(fd, v, n);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return CTTS_ERR_FILE_WRITE;
+            }
+            while (n > 0 && (size_t)written >= v->iov_len) {
+                written -= (ssize_t)v->iov_len;
+                v++;
+                n--;
+            }
+            if (n > 0) {
+                v->iov_base = (uint8_t*)v->iov_base + written;
+                v->iov_len -= (size_t)written;
+            }
+        }
+    }
+    return CTTS_OK;
+}
+
+void ctts_free_spans(CTTSSpanList* list) {
+    if (!list) return;
+    free(list->spans);
+    free(list->owned);
+    memset(list, 0, sizeof(*list));
+}
+
+/* ============================================================================
+ * Memfd Audio Handoff
+ *
+ * Audio is rendered into an anonymous memory file holding a complete WAV,
+ * then sealed so it can never change again. Local consumers receive the fd
+ * over a Unix socket and mmap it read-only: no file on disk, no copy through
+ * the socket, and one sealed fd can be handed to any number of clients.
+ * ============================================================================ */
+
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS)
+#define CTTS_HAVE_MEMFD 1
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+/* Sealed memfd holding samples as a WAV file */
+static int samples_to_memfd(const int16_t* samples, size_t count, int* fd) {
+#ifdef CTTS_HAVE_MEMFD
+    size_t size = CTTS_WAV_HEADER_SIZE + count * sizeof(int16_t);
+    int mfd = memfd_create("ctts-audio", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mfd < 0) return CTTS_ERR_OUT_OF_MEMORY;
+
+    /* Size once, fill through a shared mapping, then drop the mapping:
+       F_SEAL_WRITE is refused while a writable mapping exists */
+    uint8_t* map = MAP_FAILED;
+    if (ftruncate(mfd, (off_t)size) == 0) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+    }
+    if (map == MAP_FAILED) {
+        close(mfd);
+        return CTTS_ERR_OUT_OF_MEMORY;
+    }
+    wav_fill_header(map, count, CTTS_SAMPLE_RATE);
+    memcpy(map + CTTS_WAV_HEADER_SIZE, samples, count * sizeof(int16_t));
+    munmap(map, size);
+
+    if (fcntl(mfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+                                F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+        close(mfd);
+        return CTTS_ERR_FILE_WRITE;
+    }
+    *fd = mfd;
+    return CTTS_OK;
+#else
+    (void)samples;
+    (void)count;
+    (void)fd;
+    return CTTS_ERR_UNSUPPORTED;
+#endif
+}
+
+int ctts_synthesize_to_memfd(CTTS* engine, const char* text, float speed,
+                             int* fd, size_t* sample_count) {
+    if (!engine || !text || !fd) return CTTS_ERR_INVALID_ARG;
+    *fd = -1;
+
+#ifndef CTTS_HAVE_MEMFD
+    (void)speed;
+    (void)sample_count;
+    return CTTS_ERR_UNSUPPORTED;
+#else
+    int16_t* samples;
+    size_t count;
+    int err = ctts_synthesize(engine, text, &samples, &count, speed);
+    if (err != CTTS_OK) return err;
+
+    err = samples_to_memfd(samples, count, fd);
+    ctts_free_samples(samples);
+    if (err == CTTS_OK && sample_count) *sample_count = count;
+    return err;
+#endif
+}
+
+int ctts_send_fd(int socket_fd, int fd, const void* data, size_t len) {
+    if (socket_fd < 0 || (!data && len > 0)) return CTTS_ERR_INVALID_ARG;
+
+    /* At least one byte of payload must accompany the descriptor */
+    char dummy = 0;
+    struct iovec iov;
+    iov.iov_base = len > 0 ? (void*)data : &dummy;
+    iov.iov_len = len > 0 ? len : 1;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (fd >= 0) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (ssize_t)iov.iov_len ? CTTS_OK : CTTS_ERR_FILE_WRITE;
+}
+
+int ctts_recv_fd(int socket_fd, int* fd, void* data, size_t len) {
+    if (socket_fd < 0 || !fd || !data || len == 0) return CTTS_ERR_INVALID_ARG;
+    *fd = -1;
+
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = len;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t got;
+    do {
+        got = recvmsg(socket_fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (got < 0 && errno == EINTR);
+    if (got <= 0) return CTTS_ERR_FILE_READ;
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if ((size_t)got != len || (msg.msg_flags & MSG_CTRUNC)) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+        return CTTS_ERR_INVALID_FORMAT;
+    }
+    return CTTS_OK;
+}
+
+int ctts_map_memfd(int fd, uint64_t sample_count, const uint8_t** map, size_t* size) {
+    if (fd < 0 || !map || !size) return CTTS_ERR_INVALID_ARG;
+    *map = NULL;
+    *size = 0;
+    if (sample_count > (SIZE_MAX - CTTS_WAV_HEADER_SIZE) / sizeof(int16_t)) {
+        return CTTS_ERR_INVALID_FORMAT;
+    }
+
+#ifndef CTTS_HAVE_MEMFD
+    return CTTS_ERR_UNSUPPORTED;
+#else
+    /* Only a sealed file is immutable: otherwise the sender could rewrite
+       the audio after handoff, or shrink it under our mapping (SIGBUS) */
+    int required = F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW;
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & required) != required) return CTTS_ERR_INVALID_FORMAT;
+
+    size_t needed = CTTS_WAV_HEADER_SIZE + (size_t)sample_count * sizeof(int16_t);
+    struct stat st;
+    if (fstat(fd, &st) != 0) return CTTS_ERR_FILE_READ;
+    if (st.st_size < 0 || (uint64_t)st.st_size < needed) return CTTS_ERR_INVALID_FORMAT;
+
+    void* m = mmap(NULL, needed, PROT_READ, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) return CTTS_ERR_OUT_OF_MEMORY;
+    *map = (const uint8_t*)m;
+    *size = needed;
+    return CTTS_OK;
+#endif
+}
+
+/* ============================================================================
+ * Memory Accounting
+ * ============================================================================ */
+
+/* Mapped and resident bytes of db[offset, offset + len) */
+static void mapped_range_usage(const CTTS* engine, size_t offset, size_t len,
+                               size_t* mapped, size_t* resident) {
+    *mapped = len;
+    *resident = 0;
+    if (len == 0 || offset >= engine->db_size) return;
+    if (offset + len > engine->db_size) len = engine->db_size - offset;
+
+#ifdef __linux__
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t first = offset / page;
+    size_t last = (offset + len - 1) / page;
+    size_t pages = last - first + 1;
+    unsigned char* vec = malloc(pages);
+    if (!vec) return;
+    if (mincore(engine->db_data + first * page, pages * page > engine->db_size - first * page ?
+                engine->db_size - first * page : pages * page, vec) == 0) {
+        for (size_t i = 0; i < pages; i++) {
+            if (!(vec[i] & 1)) continue;
+            /* Count only the part of each page inside the range */
+            size_t lo = (first + i) * page, hi = lo + page;
+            if (lo < offset) lo = offset;
+            if (hi > offset + len) hi = offset + len;
+            *resident += hi - lo;
+        }
+    }
+    free(vec);
+#endif
+}
+
+int ctts_memory_report(const CTTS* engine, CTTSMemoryReport* report) {
+    if (!engine || !report) return CTTS_ERR_INVALID_ARG;
+    memset(report, 0, sizeof(*report));
+
+    /* Database sections: header, index and hash table, strings, audio */
+    const CTTSHeader* h = &engine->header;
+    size_t strings_end = h->audio_offset;
+    mapped_range_usage(engine, 0, engine->db_size,
+                       &report->db_mapped_bytes, &report->db_resident_bytes);
+    mapped_range_usage(engine, 0, h->strings_offset,
+                       &report->index_mapped_bytes, &report->index_resident_bytes);
+    mapped_range_usage(engine, h->strings_offset, strings_end - h->strings_offset,
+                       &report->strings_mapped_bytes, &report->strings_resident_bytes);
+    mapped_range_usage(engine, h->audio_offset, engine->db_size - h->audio_offset,
+                       &report->audio_mapped_bytes, &report->audio_resident_bytes);
+
+    /* Text frontend */
+    report->regex_rule_count = norm_rule_count;
+    report->regex_bytes = sizeof(norm_rules) + norm_regex_heap_bytes;
+    report->lexicon_entries = lexicon_count;
+    report->lexicon_bytes = lexicon_capacity * sizeof(LexiconEntry) + lexicon_pool.cap;
+    report->number_cache_bytes = number_words_ready ?
+                                 sizeof(number_words) + sizeof(number_words_len) : 0;
+
+    /* Fixed tables, whether or not they have been touched yet */
+    report->lut_bytes = sizeof(fade_out_lut) + sizeof(fade_in_lut) + sizeof(sine_fade_lut) +
+                        sizeof(hanning_window) + sizeof(duration_rules);
+    report->flight_recorder_bytes = flight_capacity * sizeof(FlightSlot);
+
+    report->engine_bytes = sizeof(CTTS);
+    report->request_buffer_peak_bytes = engine->peak_buffer_bytes;
+    report->request_stretch_peak_bytes = engine->peak_stretch_bytes;
+    return CTTS_OK;
+}
+
+/* ============================================================================
+ * Database Inspection
+ * ============================================================================ */
+
+/* Samples at or below this level count as silence at unit edges (~-50 dBFS) */
+#define INFO_SILENCE_LEVEL 100
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+int ctts_database_info(const CTTS* engine, CTTSDatabaseInfo* info) {
+    if (!engine || !info) return CTTS_ERR_INVALID_ARG;
+    memset(info, 0, sizeof(*info));
+
+    const CTTSHeader* h = &engine->header;
+    info->file_bytes = engine->db_size;
+    info->unit_count = h->unit_count;
+    info->hash_table_size = h->hash_table_size;
+    info->index_offset = h->index_offset;
+    info->index_bytes = (size_t)h->unit_count * sizeof(CTTSIndexEntry);
+    info->hash_offset = h->hash_table_offset;
+    info->hash_bytes = (size_t)h->hash_table_size * sizeof(uint32_t);
+    info->strings_offset = h->strings_offset;
+    info->strings_bytes = h->audio_offset >= h->strings_offset ?
+                          h->audio_offset - h->strings_offset : 0;
+    info->audio_offset = h->audio_offset;
+    info->audio_bytes = engine->db_size >= h->audio_offset ?
+                        engine->db_size - h->audio_offset : 0;
+
+    if (info->index_offset + info->index_bytes > engine->db_size ||
+        info->hash_offset + info->hash_bytes > engine->db_size ||
+        h->hash_table_size == 0) {
+        return CTTS_ERR_INVALID_FORMAT;
+    }
+
+    /* Hash table: chain length per slot, probes for lookups that miss */
+    uint64_t chained = 0;
+    for (uint32_t slot = 0; slot < h->hash_table_size; slot++) {
+        uint32_t length = 0;
+        for (uint32_t idx = engine->hash_table[slot];
+             idx != 0xFFFFFFFF && idx < h->unit_count && length <= h->unit_count;
+             idx = engine->index[idx].next_hash) {
+            length++;
+        }
+        if (length > 0) info->slots_used++;
+        if (length > info->max_chain) info->max_chain = length;
+        info->chain_histogram[length < CTTS_INFO_CHAIN_BINS ? length : CTTS_INFO_CHAIN_BINS - 1]++;
+        chained += length;
+    }
+    info->load_factor = (double)h->unit_count / h->hash_table_size;
+    info->avg_probes_miss = (double)chained / h->hash_table_size;
+    info->max_probes_miss = info->max_chain;
+
+    /* Per unit: probes to find it, length class, audio */
+    uint32_t* durations = malloc((h->unit_count ? h->unit_count : 1) * sizeof(uint32_t));
+    if (!durations) return CTTS_ERR_OUT_OF_MEMORY;
+
+    size_t audio_samples = info->audio_bytes / sizeof(int16_t);
+    uint64_t probes_total = 0, unit_samples = 0, edge_silence = 0;
+    uint32_t valid = 0;
+    for (uint32_t i = 0; i < h->unit_count; i++) {
+        const CTTSIndexEntry* e = &engine->index[i];
+
+        uint32_t probes = 0;
+        uint32_t idx = engine->hash_table[e->hash % h->hash_table_size];
+        while (idx != 0xFFFFFFFF && idx < h->unit_count && probes <= h->unit_count) {
+            probes++;
+            if (idx == i) break;
+            idx = engine->index[idx].next_hash;
+        }
+        probes_total += probes;
+        if (probes > info->max_probes_hit) info->max_probes_hit = probes;
+        if (idx != i) info->unreachable_units++;
+
+        info->units_by_chars[e->char_count <= CTTS_MAX_UNIT_LEN ?
+                             e->char_count : CTTS_MAX_UNIT_LEN + 1]++;
+
+        if ((uint64_t)e->audio_offset + e->sample_count > audio_samples ||
+            (uint64_t)e->string_offset + e->string_len > info->strings_bytes) {
+            info->broken_units++;
+            continue;
+        }
+        if (e->sample_count == 0) info->empty_units++;
+
+        const int16_t* a = engine->audio + e->audio_offset;
+        uint32_t lead = 0, trail = 0;
+        while (lead < e->sample_count && abs(a[lead]) <= INFO_SILENCE_LEVEL) lead++;
+        while (trail < e->sample_count - lead &&
+               abs(a[e->sample_count - 1 - trail]) <= INFO_SILENCE_LEVEL) trail++;
+        edge_silence += lead + trail;
+
+        durations[valid++] = e->sample_count;
+        unit_samples += e->sample_count;
+    }
+    info->avg_probes_hit = h->unit_count ? (double)probes_total / h->unit_count : 0.0;
+
+    if (valid > 0) {
+        qsort(durations, valid, sizeof(uint32_t), compare_u32);
+        const double ms = 1000.0 / CTTS_SAMPLE_RATE;
+        info->min_unit_ms = durations[0] * ms;
+        info->median_unit_ms = durations[valid / 2] * ms;
+        info->max_unit_ms = durations[valid - 1] * ms;
+        info->mean_unit_ms = (double)unit_samples / valid * ms;
+        info->edge_silence_ratio = unit_samples ? (double)edge_silence / unit_samples : 0.0;
+    }
+    info->total_audio_sec = (double)audio_samples / CTTS_SAMPLE_RATE;
+    info->unreferenced_samples = audio_samples > unit_samples ? audio_samples - unit_samples : 0;
+
+    free(durations);
+    return CTTS_OK;
+}
+
+/* ============================================================================
+ * Prompt Templates
+ *
+ * Static text around "{}" slots is rendered once at compile time, using the
+ * prosody of the whole prompt. Rendering synthesizes only the slot values and
+ * stitches them to the cached audio with the configured pauses and crossfades.
+ * ============================================================================ */
+
+/* Stand-in word used for slots when analyzing template prosody */
+#define TEMPLATE_SLOT_WORD "x"
+
+typedef struct {
+    int16_t* samples;
+    size_t count;
+} TemplatePiece;
+
+struct CTTSTemplate {
+    CTTS* engine;
+    float speed;
+    ProsodyContext prosody;     /* Prosody of the full prompt */
+    size_t slot_count;
+    TemplatePiece* statics;     /* slot_count + 1 pre-rendered segments */
+    int* slot_word_index;       /* Word index at which each slot starts */
+    uint8_t* slot_glue_before;  /* Slot continues the word before it */
+    uint8_t* slot_glue_after;   /* Slot continues into the word after it */
+};
+
+/* Characters that end a word for template stitching purposes */
+static int is_template_boundary(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+           c == ',' || c == ';' || c == ':' ||
+           c == '.' || c == '!' || c == '?';
+}
+
+/* Render one fragment of a template starting at the given word index */
+static int template_render_fragment(CTTSTemplate* tpl, const char* text,
+                                    int word_index, int* end_word_index,
+                                    int finalize, TemplatePiece* piece) {
+    CTTS* engine = tpl->engine;
+    CTTSConfig* config = &engine->config;
+
+    char* normalized = normalize_input(text);
+    if (!normalized) return CTTS_ERR_OUT_OF_MEMORY;
+
+    RenderState st;
+    int err = render_init(&st, &tpl->prosody, CTTS_SAMPLE_RATE);
+    if (err != CTTS_OK) {
+        free(normalized);
+        return err;
+    }
+    st.current_word_index = word_index;
+
+    err = render_text(engine, &st, normalized, strlen(normalized));
+    free(normalized);
+    if (err != CTTS_OK) {
+        free(st.buf.data);
+        return err;
+    }
+    render_finish_word(&st, config);
+
+    if (finalize) {
+        size_t fade = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
+        buffer_finalize(&st.buf, fade);
+    }
+    if (end_word_index) *end_word_index = st.current_word_index;
+
+    err = stretch_to_buffer(st.buf.data, st.buf.count, tpl->speed, NULL,
+                            stretch_method(st.quality, config->stretch_mode), NULL,
+                            &piece->samples, &piece->count, NULL);
+    free(st.buf.data);
+    return err;
+}
+
+void ctts_template_free(CTTSTemplate* tpl) {
+    if (!tpl) return;
+    if (tpl->statics) {
+        for (size_t i = 0; i <= tpl->slot_count; i++) {
+            free(tpl->statics[i].samples);
+        }
+    }
+    free(tpl->statics);
+    free(tpl->slot_word_index);
+    free(tpl->slot_glue_before);
+    free(tpl->slot_glue_after);
+    free(tpl);
+}
+
+CTTSTemplate* ctts_template_compile(CTTS* engine, const char* pattern, float speed) {
+    if (!engine || !pattern) return NULL;
+
+    init_fade_luts();
+    load_duration_rules("duration_rules.csv");
+
+    if (speed < CTTS_MIN_SPEED) speed = CTTS_MIN_SPEED;
+    if (speed > CTTS_MAX_SPEED) speed = CTTS_MAX_SPEED;
+
+    /* Count slots */
+    size_t slot_count = 0;
+    for (const char* p = pattern; (p = strchr(p, '{')) != NULL; ) {
+        const char* close = strchr(p, '}');
+        if (!close) break;
+        slot_count++;
+        p = close + 1;
+    }
+
+    CTTSTemplate* tpl = calloc(1, sizeof(CTTSTemplate));
+    if (!tpl) return NULL;
+    tpl->engine = engine;
+    tpl->speed = speed;
+    tpl->slot_count = slot_count;
+    tpl->statics = calloc(slot_count + 1, sizeof(TemplatePiece));
+    tpl->slot_word_index = calloc(slot_count + 1, sizeof(int));
+    tpl->slot_glue_before = calloc(slot_count + 1, 1);
+    tpl->slot_glue_after = calloc(slot_count + 1, 1);
+
+    /* Split into static segments; build prosody text with stand-in slots */
+    size_t pattern_len = strlen(pattern);
+    char** statics = calloc(slot_count + 1, sizeof(char*));
+    char* prosody_text = malloc(pattern_len + slot_count * sizeof(TEMPLATE_SLOT_WORD) + 1);
+    if (!tpl->statics || !tpl->slot_word_index || !tpl->slot_glue_before ||
+        !tpl->slot_glue_after || !statics || !prosody_text) {
+        free(statics);
+        free(prosody_text);
+        ctts_template_free(tpl);
+        return NULL;
+    }
+
+    const char* p = pattern;
+    char* pt = prosody_text;
+    for (size_t i = 0; i <= slot_count; i++) {
+        const char* open = (i < slot_count) ? strchr(p, '{') : p + strlen(p);
+        size_t seg_len = (size_t)(open - p);
+        statics[i] = malloc(seg_len + 1);
+        if (statics[i]) {
+            memcpy(statics[i], p, seg_len);
+            statics[i][seg_len] = '\0';
+        }
+        memcpy(pt, p, seg_len);
+        pt += seg_len;
+        if (i < slot_count) {
+            memcpy(pt, TEMPLATE_SLOT_WORD, sizeof(TEMPLATE_SLOT_WORD) - 1);
+            pt += sizeof(TEMPLATE_SLOT_WORD) - 1;
+            p = strchr(open, '}') + 1;
+        }
+    }
+    *pt = '\0';
+    analyze_prosody(prosody_text, &tpl->prosody, engine->config.max_pitch_change);
+    free(prosody_text);
+
+    /* Slots join mid-word when the adjacent static text has no boundary */
+    for (size_t i = 0; i < slot_count; i++) {
+        size_t before_len = statics[i] ? strlen(statics[i]) : 0;
+        tpl->slot_glue_before[i] = before_len > 0 &&
+            !is_template_boundary(statics[i][before_len - 1]);
+        tpl->slot_glue_after[i] = statics[i + 1] && statics[i + 1][0] &&
+            !is_template_boundary(statics[i + 1][0]);
+    }
+
+    /* Pre-render static segments with running word positions */
+    int word_index = 0;
+    int ok = 1;
+    for (size_t i = 0; i <= slot_count && ok; i++) {
+        if (!statics[i]) {
+            ok = 0;
+            break;
+        }
+        int end_index = word_index;
+        int finalize = (i == slot_count);
+        if (template_render_fragment(tpl, statics[i], word_index, &end_index,
+                                     finalize, &tpl->statics[i]) != CTTS_OK) {
+            ok = 0;
+            break;
+        }
+        /* Slots are assumed to be one word; multi-word values advance locally */
+        tpl->slot_word_index[i] = end_index;
+        word_index = end_index;
+    }
+
+    for (size_t i = 0; i <= slot_count; i++) free(statics[i]);
+    free(statics);
+
+    if (!ok) {
+        ctts_template_free(tpl);
+        return NULL;
+    }
+    return tpl;
+}
+
+size_t ctts_template_slot_count(const CTTSTemplate* tpl) {
+    return tpl ? tpl->slot_count : 0;
+}
+
+int ctts_template_render(CTTSTemplate* tpl, const char* const* args, size_t arg_count,
+                         int16_t** samples, size_t* sample_count) {
+    if (!tpl || !samples || !sample_count || (arg_count > 0 && !args)) {
+        return CTTS_ERR_INVALID_ARG;
+    }
+    if (arg_count != tpl->slot_count) return CTTS_ERR_INVALID_ARG;
+
+    CTTS* engine = tpl->engine;
+    CTTSConfig* config = &engine->config;
+    engine->units_found = 0;
+    engine->units_missing = 0;
+
+    /* Crossfade used for mid-word joins, in output (stretched) samples */
+    size_t crossfade_samples = (size_t)(config->crossfade_ms * CTTS_SAMPLE_RATE /
+                                        1000.0f / tpl->speed);
+    size_t fade_samples = (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f);
+
+    size_t static_total = 0;
+    for (size_t i = 0; i <= tpl->slot_count; i++) static_total += tpl->statics[i].count;
+
+    SampleBuffer out;
+    int err = buffer_init(&out, static_total + CTTS_SAMPLE_RATE);
+    if (err != CTTS_OK) return err;
+
+    memcpy(out.data, tpl->statics[0].samples, tpl->statics[0].count * sizeof(int16_t));
+    out.count = tpl->statics[0].count;
+
+    for (size_t i = 0; i < tpl->slot_count; i++) {
+        /* Render the slot; finalize when it ends the prompt or precedes a pause */
+        int is_last = (i + 1 == tpl->slot_count) && tpl->statics[i + 1].count == 0;
+        TemplatePiece slot = {NULL, 0};
+        err = template_render_fragment(tpl, args[i] ? args[i] : "",
+                                       tpl->slot_word_index[i], NULL,
+                                       is_last || !tpl->slot_glue_after[i], &slot);
+        if (err != CTTS_OK) {
+            free(out.data);
+            return err;
+        }
+
+        /* Word boundary before the slot: fade out the preceding audio */
+        if (!tpl->slot_glue_before[i] && out.count > 0) {
+            apply_fade_out(out.data, out.count, fade_samples);
+        }
+
+        const TemplatePiece* next = &tpl->statics[i + 1];
+        err = buffer_grow(&out, slot.count + next->count);
+        if (err != CTTS_OK) {
+            free(slot.samples);
+            free(out.data);
+            return err;
+        }
+
+        buffer_mix_crossfade(&out, slot.samples, slot.count,
+                             tpl->slot_glue_before[i] ? crossfade_samples : 0);
+        free(slot.samples);
+        buffer_mix_crossfade(&out, next->samples, next->count,
+                             tpl->slot_glue_after[i] ? crossfade_samples : 0);
+    }
+
+    *samples = out.data;
+    *sample_count = out.count;
+    return CTTS_OK;
+}
+
+/* ============================================================================
+ * Incremental Input Sessions
+ *
+ * Text from an upstream generator is rendered word by word as soon as each
+ * word is followed by whitespace. Audio before a word pause is final (units
+ * after a pause fade in instead of crossfading back), so it is handed to the
+ * callback and dropped from the buffer after every rendered piece.
+ * ============================================================================ */
+
+/* Words assumed to follow the rendered part of a clause still in progress */
+#define SESSION_OPEN_WORDS 3
+
+struct CTTSSession {
+    CTTS* engine;
+    float speed;
+    CTTSAudioCallback callback;
+    CTTSSilenceCallback silence_callback;   /* NULL: silence arrives as zeros */
+    void* user_data;
+    RenderState st;
+    char* pending;          /* Raw text not yet rendered */
+    size_t pending_len;
+    size_t pending_cap;
+    int clause_words;       /* Words already rendered in the current clause */
+    float base_speed;       /* Speed from ctts_session_begin; SSML rates scale it */
+    SsmlState ssml;         /* Prosody nesting of ctts_session_feed_ssml() input */
+    TextBuilder markup;     /* SSML not complete yet (a split tag or say-as) */
+};
+
+static int session_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* Token ends with clause punctuation (ignoring closing quotes and brackets) */
+static int session_closes_clause(const char* tok, size_t len) {
+    while (len > 0 && (tok[len - 1] == '"' || tok[len - 1] == '\'' ||
+                       tok[len - 1] == ')' || tok[len - 1] == ']')) {
+        len--;
+    }
+    if (len == 0) return 0;
+    char c = tok[len - 1];
+    return c == ',' || c == ';' || c == ':' || c == '.' || c == '!' || c == '?';
+}
+
+static int session_count_words(const char* text, size_t len) {
+    int words = 0, in_word = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (session_is_space(text[i])) {
+            in_word = 0;
+        } else if (!in_word) {
+            in_word = 1;
+            words++;
+        }
+    }
+    return words;
+}
+
+/* Forward one segment: silence goes to the silence callback when set */
+static int session_segment(void* ctx, const int16_t* samples, size_t count) {
+    CTTSSession* s = (CTTSSession*)ctx;
+    if (samples) {
+        if (s->callback) s->callback(samples, count, s->user_data);
+    } else if (s->silence_callback) {
+        s->silence_callback(count, s->user_data);
+    } else if (s->callback) {
+        while (count > 0) {
+            size_t n = count < SILENCE_BLOCK_LEN ? count : SILENCE_BLOCK_LEN;
+            s->callback(silence_block, n, s->user_data);
+            count -= n;
+        }
+    }
+    return CTTS_OK;
+}
+
+/* Pass everything rendered so far to the callbacks */
+static int session_emit(CTTSSession* s) {
+    SampleBuffer* buf = &s->st.buf;
+    if (buf->count == 0) return CTTS_OK;
+
+    int method = stretch_method(s->st.quality, s->engine->config.stretch_mode);
+    int err = stretch_segments(buf->data, buf->count, s->speed, NULL, method, NULL,
+                               session_segment, s, NULL);
+    if (err != CTTS_OK) return err;
+
+    buf->count = 0;
+    s->st.word_start_sample = 0;
+    return CTTS_OK;
+}
+
+/*
+ * Render raw text (whole words) as the next part of the current clause.
+ * lookahead is the word after it, used only by unit look-ahead; closes says
+ * whether the clause ends with this piece, which fixes its intonation.
+ */
+static int session_render(CTTSSession* s, const char* text, size_t len,
+                          const char* lookahead, size_t lookahead_len, int closes) {
+    CTTSConfig* config = &s->engine->config;
+
+    char* piece = malloc(len + lookahead_len + 1);
+    if (!piece) return CTTS_ERR_OUT_OF_MEMORY;
+    memcpy(piece, text, len);
+    piece[len] = '\0';
+
+    char* normalized = normalize_input(piece);
+    if (!normalized) {
+        free(piece);
+        return CTTS_ERR_OUT_OF_MEMORY;
+    }
+    size_t render_len = strlen(normalized);
+
+    /* Normalize with the next word too; use it if the piece is a prefix */
+    if (lookahead_len > 0) {
+        memcpy(piece + len, lookahead, lookahead_len);
+        piece[len + lookahead_len] = '\0';
+        char* with_next = normalize_input(piece);
+        piece[len] = '\0';
+        if (with_next && strncmp(with_next, normalized, render_len) == 0) {
+            free(normalized);
+            normalized = with_next;
+        } else {
+            free(with_next);
+        }
+    }
+
+    /* Clause type is known once it closes; until then keep a neutral contour */
+    int words = session_count_words(normalized, render_len);
+    ProsodyContext prosody;
+    analyze_prosody(closes ? piece : "", &prosody, config->max_pitch_change);
+    prosody.word_count = s->clause_words + words + (closes ? 0 : SESSION_OPEN_WORDS);
+    s->st.prosody = prosody;
+    s->st.current_word_index = s->clause_words;
+    s->st.quality = load_quality_level();
+    s->clause_words = closes ? 0 : s->clause_words + words;
+
+    int err = render_text(s->engine, &s->st, normalized, render_len);
+    free(normalized);
+    free(piece);
+    return err;
+}
+
+/*
+ * Render every complete word of the pending text. Without all, the last
+ * complete word is held back unless it closes a clause, and a word without
+ * trailing whitespace may still grow. closes says whether the pending text
+ * ends its clause.
+ */
+static int session_render_pending(CTTSSession* s, int all, int closes) {
+    const char* p = s->pending;
+    size_t n = s->pending_len;
+
+    /* Find the last complete token and where its trailing whitespace ends */
+    size_t last_start = 0, last_end = 0, complete_end = 0;
+    int have_token = 0;
+    size_t i = 0;
+    while (i < n) {
+        while (i < n && session_is_space(p[i])) i++;
+        size_t start = i;
+        while (i < n && !session_is_space(p[i])) i++;
+        if (start == i || (i == n && !all)) break;
+        last_start = start;
+        last_end = i;
+        while (i < n && session_is_space(p[i])) i++;
+        complete_end = i;
+        have_token = 1;
+    }
+    if (!have_token) return CTTS_OK;
+
+    size_t commit;
+    const char* held = NULL;
+    size_t held_len = 0;
+    if (all || session_closes_clause(p + last_start, last_end - last_start)) {
+        commit = complete_end;
+    } else {
+        commit = last_start;
+        held = p + last_start;
+        held_len = last_end - last_start;
+    }
+
+    /* Render clause by clause */
+    int err = CTTS_OK;
+    size_t piece_start = 0;
+    i = 0;
+    while (i < commit && err == CTTS_OK) {
+        while (i < commit && session_is_space(p[i])) i++;
+        size_t start = i;
+        while (i < commit && !session_is_space(p[i])) i++;
+        if (start == i) break;
+        size_t tok_end = i;
+        while (i < commit && session_is_space(p[i])) i++;
+        if (session_closes_clause(p + start, tok_end - start)) {
+            err = session_render(s, p + piece_start, i - piece_start, NULL, 0, 1);
+            piece_start = i;
+        }
+    }
+    if (err == CTTS_OK && piece_start < commit) {
+        err = session_render(s, p + piece_start, commit - piece_start,
+                             held, held_len, closes);
+    }
+    if (err != CTTS_OK) return err;
+
+    memmove(s->pending, s->pending + commit, n - commit);
+    s->pending_len = n - commit;
+    s->pending[s->pending_len] = '\0';
+    return CTTS_OK;
+}
+
+static int session_flush(CTTSSession* s, int at_end) {
+    int err = session_render_pending(s, at_end, at_end);
+    if (err != CTTS_OK) return err;
+
+    if (at_end) {
+        CTTSConfig* config = &s->engine->config;
+        render_finish_word(&s->st, config);
+        buffer_finalize(&s->st.buf, (size_t)(config->fade_out_ms * CTTS_SAMPLE_RATE / 1000.0f));
+    }
+    return session_emit(s);
+}
+
+CTTSSession* ctts_session_begin(CTTS* engine, float speed,
+                                CTTSAudioCallback callback, void* user_data) {
+    if (!engine) return NULL;
+
+    init_fade_luts();
+    load_duration_rules("duration_rules.csv");
+
+    if (speed < CTTS_MIN_SPEED) speed = CTTS_MIN_SPEED;
+    if (speed > CTTS_MAX_SPEED) speed = CTTS_MAX_SPEED;
+
+    CTTSSession* s = calloc(1, sizeof(CTTSSession));
+    if (!s) return NULL;
+    s->engine = engine;
+    s->speed = speed;
+    s->base_speed = speed;
+    ssml_state_init(&s->ssml);
+    s->callback = callback;
+    s->user_data = user_data;
+    s->pending_cap = 256;
+    s->pending = malloc(s->pending_cap);
+
+    ProsodyContext prosody;
+    analyze_prosody("", &prosody, engine->config.max_pitch_change);
+    if (!s->pending || render_init(&s->st, &prosody, CTTS_SAMPLE_RATE) != CTTS_OK) {
+        free(s->pending);
+        free(s);
+        return NULL;
+    }
+    s->pending[0] = '\0';
+
+    engine->units_found = 0;
+    engine->units_missing = 0;
+    return s;
+}
+
+int ctts_session_set_silence_callback(CTTSSession* s, CTTSSilenceCallback callback) {
+    if (!s) return CTTS_ERR_INVALID_ARG;
+    s->silence_callback = callback;
+    return CTTS_OK;
+}
+
+/* Append len bytes of raw text and render what is complete */
+static int session_append(CTTSSession* s, const char* text, size_t len) {
+    if (s->pending_len + len + 1 > s->pending_cap) {
+        size_t cap = s->pending_cap;
+        while (cap < s->pending_len + len + 1) cap *= 2;
+        char* grown = realloc(s->pending, cap);
+        if (!grown) return CTTS_ERR_OUT_OF_MEMORY;
+        s->pending = grown;
+        s->pending_cap = cap;
+    }
+    memcpy(s->pending + s->pending_len, text, len);
+    s->pending_len += len;
+    s->pending[s->pending_len] = '\0';
+
+    return session_flush(s, 0);
+}
+
+int ctts_session_feed(CTTSSession* s, const char* chunk) {
+    if (!s || !chunk) return CTTS_ERR_INVALID_ARG;
+    return session_append(s, chunk, strlen(chunk));
+}
+
+/*
+ * Render all pending text mid-clause, close the last word with
+ * pause_samples of silence (unless it already ended in a pause) and hand
+ * everything to the callbacks at the current speed
+ */
+static int session_boundary(CTTSSession* s, size_t pause_samples) {
+    while (s->pending_len > 0 && session_is_space(s->pending[s->pending_len - 1])) {
+        s->pending[--s->pending_len] = '\0';
+    }
+    int err = session_render_pending(s, 1, 0);
+    if (err != CTTS_OK) return err;
+    if (!s->st.prev_was_word_boundary) {
+        render_word_break(&s->st, &s->engine->config, pause_samples);
+    }
+    return session_emit(s);
+}
+
+/* SSML events: text is fed as it arrives, markup acts at a word boundary */
+static int session_ssml_text(void* ctx, const char* text, size_t len) {
+    return session_append((CTTSSession*)ctx, text, len);
+}
+
+/* A break ends the word and is sent as exactly its length of silence */
+static int session_ssml_pause(void* ctx, float ms) {
+    CTTSSession* s = (CTTSSession*)ctx;
+    int err = session_boundary(s, 0);
+    size_t pause_samples = (size_t)(ms * CTTS_SAMPLE_RATE / 1000.0f);
+    if (err == CTTS_OK && pause_samples > 0) err = session_segment(s, NULL, pause_samples);
+    return err;
+}
+
+/* Text before a rate change is emitted at the old speed, after a word pause */
+static int session_ssml_rate(void* ctx, float rate) {
+    CTTSSession* s = (CTTSSession*)ctx;
+    float speed = s->base_speed * rate;
+    if (speed < CTTS_MIN_SPEED) speed = CTTS_MIN_SPEED;
+    if (speed > CTTS_MAX_SPEED) speed = CTTS_MAX_SPEED;
+    if (speed == s->speed) return CTTS_OK;
+
+    CTTSConfig* config = &s->engine->config;
+    int err = session_boundary(s, (size_t)(config->word_pause_ms * CTTS_SAMPLE_RATE / 1000.0f));
+    if (err == CTTS_OK) s->speed = speed;
+    return err;
+}
+
+static const SsmlEvents session_ssml_events = {
+    session_ssml_text, session_ssml_pause, session_ssml_rate
+};
+
+/* Walk the buffered markup and keep what is not complete yet */
+static int session_walk_markup(CTTSSession* s, int final) {
+    size_t consumed = 0;
+    int err = ssml_walk(&s->ssml, s->markup.data, final, &s->engine->config,
+                        &session_ssml_events, s, &consumed);
+    memmove(s->markup.data, s->markup.data + consumed, s->markup.len - consumed + 1);
+    s->markup.len -= consumed;
+    return err;
+}
+
+int ctts_session_feed_ssml(CTTSSession* s, const char* chunk) {
+    if (!s || !chunk) return CTTS_ERR_INVALID_ARG;
+
+    tb_append(&s->markup, chunk, strlen(chunk));
+    if (s->markup.failed) return CTTS_ERR_OUT_OF_MEMORY;
+    return session_walk_markup(s, 0);
+}
+
+int ctts_session_end(CTTSSession* s) {
+    if (!s) return CTTS_ERR_INVALID_ARG;
+
+    int err = CTTS_OK;
+    if (s->markup.len > 0) err = session_walk_markup(s, 1);
+    int flush_err = session_flush(s, 1);
+    if (err == CTTS_OK) err = flush_err;
+
+    free(s->st.buf.data);
+    free(s->pending);
+    free(s->markup.data);
+    free(s);
+    return err;
+}
+
+/* ============================================================================
+ * Corpus Coverage Analysis
+ *
+ * Runs only the text frontend and unit selection (no audio) over a corpus,
+ * one sentence per line, split across worker threads.
+ * ============================================================================ */
+
+/* String -> count table (open addressing, linear probing) */
+typedef struct {
+    char* key;
+    uint32_t hash;
+    uint64_t count;
+} CountEntry;
+
+typedef struct {
+    CountEntry* slots;
+    size_t capacity;    /* Power of 2 */
+    size_t used;
+} CountTable;
+
+static int count_table_init(CountTable* t, size_t capacity) {
+    t->slots = calloc(capacity, sizeof(CountEntry));
+    t->capacity = capacity;
+    t->used = 0;
+    return t->slots ? CTTS_OK : CTTS_ERR_OUT_OF_MEMORY;
+}
+
+static void count_table_free(CountTable* t) {
+    for (size_t i = 0; i < t->capacity; i++) free(t->slots[i].key);
+    free(t->slots);
+    t->slots = NULL;
+    t->capacity = t->used = 0;
+}
+
+/* Insert into slot array without growing; takes ownership of key */
+static void count_table_place(CountEntry* slots, size_t capacity, CountEntry entry) {
+    size_t i = entry.hash & (capacity - 1);
+    while (slots[i].key) i = (i + 1) & (capacity - 1);
+    slots[i] = entry;
+}
+
+static int count_table_add(CountTable* t, const char* key, size_t len, uint64_t n) {
+    uint32_t hash = ctts_hash(key, len);
+    size_t i = hash & (t->capacity - 1);
+
+    while (t->slots[i].key) {
+        if (t->slots[i].hash == hash && strncmp(t->slots[i].key, key, len) == 0 &&
+            t->slots[i].key[len] == '\0') {
+            t->slots[i].count += n;
+            return CTTS_OK;
+        }
+        i = (i + 1) & (t->capacity - 1);
+    }
+
+    /* Grow before exceeding load factor */
+    if (t->used + 1 > t->capacity * HASH_TABLE_LOAD) {
+        size_t new_cap = t->capacity * 2;
+        CountEntry* slots = calloc(new_cap, sizeof(CountEntry));
+        if (!slots) return CTTS_ERR_OUT_OF_MEMORY;
+        for (size_t j = 0; j < t->capacity; j++) {
+            if (t->slots[j].key) count_table_place(slots, new_cap, t->slots[j]);
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->capacity = new_cap;
+    }
+
+    CountEntry entry;
+    entry.key = malloc(len + 1);
+    if (!entry.key) return CTTS_ERR_OUT_OF_MEMORY;
+    memcpy(entry.key, key, len);
+    entry.key[len] = '\0';
+    entry.hash = hash;
+    entry.count = n;
+    count_table_place(t->slots, t->capacity, entry);
+    t->used++;
+    return CTTS_OK;
+}
+
+/* Per-thread analysis job */
+typedef struct {
+    CTTS* engine;
+    const char* start;      /* Corpus slice (whole lines) */
+    const char* end;
+    uint64_t sentences;
+    uint64_t words;
+    uint64_t units_found;
+    uint64_t units_missing;
+    uint64_t* unit_hits;
+    uint8_t* probed;        /* Optional: units consulted by look-ahead */
+    CountTable missing;
+    int err;
+} AnalyzeJob;
+
+/*
+ * Mark every unit the look-ahead can consult when selecting at pos: for each
+ * unit matching a prefix, the longest match after it. Keeping these in a
+ * subset database leaves the candidate scores, and so the choice, unchanged.
+ */
+static void mark_lookahead_units(CTTS* engine, const char* pos, uint8_t* probed) {
+    size_t max_chars = engine->header.max_unit_chars;
+    const char* end = pos;
+
+    for (size_t c = 0; c < max_chars && *end; c++) {
+        end += utf8_char_len(end);
+        if (find_unit(engine, pos, (size_t)(end - pos)) < 0) continue;
+
+        const char* next_pos = end;
+        while (*next_pos == ' ' || *next_pos == '\t' || *next_pos == '\n') {
+            next_pos++;
+        }
+        int unit_idx;
+        if (*next_pos && find_longest_match(engine, next_pos, max_chars, &unit_idx) > 0) {
+            probed[unit_idx] = 1;
+        }
+    }
+}
+
+/* Run unit selection over one normalized sentence */
+static void analyze_sentence(AnalyzeJob* job, const char* normalized) {
+    const char* pos = normalized;
+    const char* miss_start = NULL;
+    size_t miss_len = 0;
+    int at_word_start = 1;
+    int word_has_units = 0;
+
+    while (1) {
+        SelectionToken tok;
+        int at_end = (*pos == '\0');
+        if (!at_end) select_next(job->engine, &pos, at_word_start, &tok);
+
+        /* Flush a run of consecutive missing characters */
+        if (miss_len > 0 && (at_end || tok.kind != SEL_MISSING)) {
+            if (count_table_add(&job->missing, miss_start, miss_len, 1) != CTTS_OK) {
+                job->err = CTTS_ERR_OUT_OF_MEMORY;
+            }
+            miss_len = 0;
+        }
+
+        if (at_end || tok.kind == SEL_WORD_BREAK) {
+            if (word_has_units) job->words++;
+            word_has_units = 0;
+            if (at_end) break;
+        }
+
+        switch (tok.kind) {
+        case SEL_WORD_BREAK:
+        case SEL_PUNCT:
+            at_word_start = 1;
+            break;
+        case SEL_UNIT:
+            if (job->probed) mark_lookahead_units(job->engine, tok.text, job->probed);
+            job->unit_hits[tok.unit_idx]++;
+            job->units_found++;
+            word_has_units = 1;
+            at_word_start = 0;
+            break;
+        case SEL_MISSING:
+            if (miss_len == 0) miss_start = tok.text;
+            miss_len += tok.len;
+            job->units_missing++;
+            word_has_units = 1;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void* analyze_worker(void* arg) {
+    AnalyzeJob* job = (AnalyzeJob*)arg;
+    size_t line_cap = 1024;
+    char* line = malloc(line_cap);
+    if (!line) {
+        job->err = CTTS_ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
+
+    const char* p = job->start;
+    while (p < job->end && job->err == CTTS_OK) {
+        const char* nl = memchr(p, '\n', (size_t)(job->end - p));
+        const char* line_end = nl ? nl : job->end;
+        size_t len = (size_t)(line_end - p);
+        if (len > 0 && p[len - 1] == '\r') len--;
+
+        if (len > 0) {
+            if (len + 1 > line_cap) {
+                while (line_cap < len + 1) line_cap *= 2;
+                char* grown = realloc(line, line_cap);
+                if (!grown) {
+                    job->err = CTTS_ERR_OUT_OF_MEMORY;
+                    break;
+                }
+                line = grown;
+            }
+            memcpy(line, p, len);
+            line[len] = '\0';
+
+            char* normalized = normalize_input(line);
+            if (normalized) {
+                analyze_sentence(job, normalized);
+                free(normalized);
+                job->sentences++;
+            }
+        }
+        p = nl ? nl + 1 : job->end;
+    }
+
+    free(line);
+    return NULL;
+}
+
+static int compare_missing(const void* a, const void* b) {
+    const CTTSMissingSequence* ma = (const CTTSMissingSequence*)a;
+    const CTTSMissingSequence* mb = (const CTTSMissingSequence*)b;
+    if (ma->count != mb->count) return (ma->count < mb->count) ? 1 : -1;
+    return strcmp(ma->text, mb->text);
+}
+
+void ctts_coverage_report_free(CTTSCoverageReport* report) {
+    if (!report) return;
+    free(report->unit_hits);
+    for (size_t i = 0; i < report->missing_count; i++) free(report->missing[i].text);
+    free(report->missing);
+    memset(report, 0, sizeof(*report));
+}
+
+/*
+ * Corpus analysis worker pool.
+ * If probed is not NULL (unit_count entries) it also collects the units
+ * consulted by look-ahead, for database subsetting.
+ */
+static int analyze_corpus(CTTS* engine, const char* corpus_file, int num_threads,
+                          CTTSCoverageReport* report, uint8_t* probed) {
+    if (!engine || !corpus_file || !report) return CTTS_ERR_INVALID_ARG;
+    memset(report, 0, sizeof(*report));
+
+    if (num_threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = (cpus > 0) ? (int)cpus : 1;
+    }
+
+    int fd = open(corpus_file, O_RDONLY);
+    if (fd < 0) return CTTS_ERR_FILE_NOT_FOUND;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return CTTS_ERR_FILE_READ;
+    }
+    size_t size = (size_t)st.st_size;
+    const char* data = NULL;
+    if (size > 0) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return CTTS_ERR_FILE_READ;
+        }
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    /* Shared, read-only after loading */
+    load_frontend_rules();
+
+    uint32_t unit_count = engine->header.unit_count;
+    AnalyzeJob* jobs = calloc((size_t)num_threads, sizeof(AnalyzeJob));
+    pthread_t* threads = calloc((size_t)num_threads, sizeof(pthread_t));
+    int err = (jobs && threads) ? CTTS_OK : CTTS_ERR_OUT_OF_MEMORY;
+
+    /* Split corpus at line boundaries */
+    const char* cursor = data;
+    const char* data_end = data + size;
+    int started = 0;
+    for (int i = 0; i < num_threads && err == CTTS_OK; i++) {
+        AnalyzeJob* job = &jobs[i];
+        job->engine = engine;
+        job->start = cursor;
+        if (i == num_threads - 1) {
+            job->end = data_end;
+        } else {
+            const char* split = cursor + (size_t)(data_end - cursor) / (size_t)(num_threads - i);
+            const char* nl = (split < data_end) ?
+                memchr(split, '\n', (size_t)(data_end - split)) : NULL;
+            job->end = nl ? nl + 1 : data_end;
+        }
+        cursor = job->end;
+
+        job->unit_hits = calloc(unit_count ? unit_count : 1, sizeof(uint64_t));
+        if (probed) job->probed = calloc(unit_count ? unit_count : 1, 1);
+        if (!job->unit_hits || (probed && !job->probed) ||
+            count_table_init(&job->missing, 64) != CTTS_OK) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+            break;
+        }
+        if (pthread_create(&threads[i], NULL, analyze_worker, job) != 0) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+            break;
+        }
+        started++;
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        if (jobs[i].err != CTTS_OK) err = jobs[i].err;
+    }
+
+    /* Merge per-thread results */
+    CountTable missing = {NULL, 0, 0};
+    if (err == CTTS_OK) {
+        report->unit_hits = calloc(unit_count ? unit_count : 1, sizeof(uint64_t));
+        if (!report->unit_hits || count_table_init(&missing, 64) != CTTS_OK) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+        }
+    }
+    for (int i = 0; i < num_threads && jobs && err == CTTS_OK; i++) {
+        AnalyzeJob* job = &jobs[i];
+        report->sentences += job->sentences;
+        report->words += job->words;
+        report->units_found += job->units_found;
+        report->units_missing += job->units_missing;
+        for (uint32_t u = 0; u < unit_count; u++) report->unit_hits[u] += job->unit_hits[u];
+        if (probed) {
+            for (uint32_t u = 0; u < unit_count; u++) probed[u] |= job->probed[u];
+        }
+        for (size_t j = 0; j < job->missing.capacity && err == CTTS_OK; j++) {
+            CountEntry* e = &job->missing.slots[j];
+            if (e->key) err = count_table_add(&missing, e->key, strlen(e->key), e->count);
+        }
+    }
+
+    if (err == CTTS_OK && missing.used > 0) {
+        report->missing = malloc(missing.used * sizeof(CTTSMissingSequence));
+        if (!report->missing) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+        } else {
+            for (size_t j = 0; j < missing.capacity; j++) {
+                if (!missing.slots[j].key) continue;
+                report->missing[report->missing_count].text = missing.slots[j].key;
+                report->missing[report->missing_count].count = missing.slots[j].count;
+                report->missing_count++;
+                missing.slots[j].key = NULL;  /* Ownership moved to report */
+            }
+            qsort(report->missing, report->missing_count, sizeof(CTTSMissingSequence),
+                  compare_missing);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    report->bytes = size;
+    report->elapsed_sec = (double)(t1.tv_sec - t0.tv_sec) +
+                          (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    if (missing.slots) count_table_free(&missing);
+    for (int i = 0; i < num_threads && jobs; i++) {
+        free(jobs[i].unit_hits);
+        free(jobs[i].probed);
+        if (jobs[i].missing.slots) count_table_free(&jobs[i].missing);
+    }
+    free(jobs);
+    free(threads);
+    if (data) munmap((void*)data, size);
+    close(fd);
+
+    if (err != CTTS_OK) ctts_coverage_report_free(report);
+    return err;
+}
+
+int ctts_analyze_corpus(CTTS* engine, const char* corpus_file, int num_threads,
+                        CTTSCoverageReport* report) {
+    return analyze_corpus(engine, corpus_file, num_threads, report, NULL);
+}
+
+/* ============================================================================
+ * Cache Warming
+ *
+ * Replays the most frequent texts of a request log through the full
+ * pipeline on worker threads: the frontend tables get built, the database
+ * pages those requests need are faulted in, and an optional callback can
+ * keep the rendered audio (e.g. in a prompt cache) before traffic arrives.
+ * ============================================================================ */
+
+#define WARM_DEFAULT_TOP_K 100
+
+/* Shared state of the warming workers */
+typedef struct {
+    CTTS* engine;
+    const CTTSWarmOptions* options;
+    const CountEntry** ranked;      /* Texts to replay, most frequent first */
+    size_t ranked_count;
+    size_t next;                    /* Next ranked text to claim (atomic) */
+    uint8_t* touched;               /* Units selected so far (atomic bytes) */
+    size_t memory_used;             /* Warmed DB audio + delivered audio (atomic) */
+    struct timespec start;
+    pthread_mutex_t callback_lock;
+    int budget_exhausted;           /* CTTS_WARM_BUDGET_* (atomic) */
+    int inline_worker;              /* Running on the caller's thread: keep its priority */
+    int err;
+    uint64_t texts_warmed;          /* Atomic */
+    uint64_t requests_covered;      /* Atomic */
+} WarmState;
+
+/* Text of a log line: a flight-recorder record or the whole line */
+static const char* warm_log_text(const char* line, size_t* len) {
+    const char* quoted = strstr(line, " text=\"");
+    if (quoted) {
+        const char* start = quoted + 7;
+        const char* end = strrchr(start, '"');
+        *len = end ? (size_t)(end - start) : strlen(start);
+        return start;
+    }
+    *len = strlen(line);
+    return line;
+}
+
+static int compare_count_entries(const void* a, const void* b) {
+    const CountEntry* ea = *(const CountEntry* const*)a;
+    const CountEntry* eb = *(const CountEntry* const*)b;
+    if (ea->count != eb->count) return (ea->count < eb->count) ? 1 : -1;
+    return strcmp(ea->key, eb->key);
+}
+
+/* Select units for text and account the audio of units seen for the first time */
+static void warm_mark_units(WarmState* ws, CTTS* engine, const char* text) {
+    char* normalized = normalize_input(text);
+    if (!normalized) return;
+
+    const char* pos = normalized;
+    int at_word_start = 1;
+    while (*pos) {
+        SelectionToken tok;
+        select_next(engine, &pos, at_word_start, &tok);
+        if (tok.kind == SEL_UNIT) {
+            if (__atomic_exchange_n(&ws->touched[tok.unit_idx], 1, __ATOMIC_RELAXED) == 0) {
+                __atomic_fetch_add(&ws->memory_used,
+                                   engine->index[tok.unit_idx].sample_count * sizeof(int16_t),
+                                   __ATOMIC_RELAXED);
+            }
+            at_word_start = 0;
+        } else if (tok.kind == SEL_WORD_BREAK || tok.kind == SEL_PUNCT) {
+            at_word_start = 1;
+        }
+    }
+    free(normalized);
+}
+
+/*
+ * Run the calling thread at idle priority so warming only uses CPU that
+ * serving leaves free: SCHED_IDLE where available, else the thread's nice
+ * value (per thread on Linux)
+ */
+static void lower_thread_priority(void) {
+#if defined(__linux__) && defined(SCHED_IDLE)
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) == 0) return;
+#endif
+#ifdef __linux__
+    (void)setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+#endif
+}
+
+static void* warm_worker(void* arg) {
+    WarmState* ws = (WarmState*)arg;
+    const CTTSWarmOptions* opt = ws->options;
+
+    /* Lowered before the first synthesis; never on the caller's own thread */
+    if (!ws->inline_worker) lower_thread_priority();
+
+    /*
+     * Per-thread view of the engine. db_data, index, hash_table, strings and
+     * audio point into the read-only database mapping and are never written
+     * after ctts_init(), so sharing them is safe; config is copied by value.
+     * ctts_synthesize() writes only the statistics (units_found/missing) and
+     * the peak_* high-water marks, which is why each worker has its own copy.
+     * The lexicon, rules and tables are process-wide and were loaded before
+     * the workers started.
+     */
+    CTTS engine = *ws->engine;
+
+    for (;;) {
+        if (__atomic_load_n(&ws->budget_exhausted, __ATOMIC_RELAXED)) break;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (opt->time_budget_ms > 0 && flight_ms(&ws->start, &now) > opt->time_budget_ms) {
+            __atomic_store_n(&ws->budget_exhausted, CTTS_WARM_BUDGET_TIME, __ATOMIC_RELAXED);
+            break;
+        }
+        if (opt->memory_budget_bytes > 0 &&
+            __atomic_load_n(&ws->memory_used, __ATOMIC_RELAXED) >= opt->memory_budget_bytes) {
+            __atomic_store_n(&ws->budget_exhausted, CTTS_WARM_BUDGET_MEMORY, __ATOMIC_RELAXED);
+            break;
+        }
+
+        size_t i = __atomic_fetch_add(&ws->next, 1, __ATOMIC_RELAXED);
+        if (i >= ws->ranked_count) break;
+        const CountEntry* entry = ws->ranked[i];
+
+        warm_mark_units(ws, &engine, entry->key);
+
+        int16_t* samples;
+        size_t sample_count;
+        if (ctts_synthesize(&engine, entry->key, &samples, &sample_count, opt->speed) != CTTS_OK) {
+            continue;
+        }
+        if (opt->callback) {
+            __atomic_fetch_add(&ws->memory_used, sample_count * sizeof(int16_t), __ATOMIC_RELAXED);
+            pthread_mutex_lock(&ws->callback_lock);
+            opt->callback(entry->key, entry->count, samples, sample_count, opt->user_data);
+            pthread_mutex_unlock(&ws->callback_lock);
+        }
+        ctts_free_samples(samples);
+
+        __atomic_fetch_add(&ws->texts_warmed, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&ws->requests_covered, entry->count, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/* Fault in a mapped range by reading one byte per page */
+static void prefault_range(const uint8_t* data, size_t len) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    volatile uint8_t sink = 0;
+    for (size_t off = 0; off < len; off += page) sink ^= data[off];
+    (void)sink;
+}
+
+int ctts_warm_from_log(CTTS* engine, const char* log_file,
+                       const CTTSWarmOptions* options, CTTSWarmReport* report) {
+    if (!engine || !log_file || !report) return CTTS_ERR_INVALID_ARG;
+    memset(report, 0, sizeof(*report));
+
+    CTTSWarmOptions opt;
+    if (options) {
+        opt = *options;
+    } else {
+        memset(&opt, 0, sizeof(opt));
+    }
+    if (opt.top_k == 0) opt.top_k = WARM_DEFAULT_TOP_K;
+    if (opt.speed <= 0) opt.speed = 1.0f;
+    if (opt.num_threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        opt.num_threads = (cpus > 0) ? (int)cpus : 1;
+    }
+
+    FILE* f = fopen(log_file, "r");
+    if (!f) return CTTS_ERR_FILE_NOT_FOUND;
+
+    WarmState ws;
+    memset(&ws, 0, sizeof(ws));
+    clock_gettime(CLOCK_MONOTONIC, &ws.start);
+
+    /* Count requests per text */
+    CountTable counts;
+    int err = count_table_init(&counts, 1024);
+    char* line = NULL;
+    size_t line_cap = 0;
+    ssize_t got;
+    while (err == CTTS_OK && (got = getline(&line, &line_cap, f)) != -1) {
+        while (got > 0 && (line[got - 1] == '\n' || line[got - 1] == '\r')) line[--got] = '\0';
+        if (got == 0 || line[0] == '#') continue;
+        size_t len;
+        const char* text = warm_log_text(line, &len);
+        if (len == 0) continue;
+        err = count_table_add(&counts, text, len, 1);
+        report->log_requests++;
+    }
+    free(line);
+    fclose(f);
+    if (err != CTTS_OK) {
+        if (counts.slots) count_table_free(&counts);
+        return err;
+    }
+    report->distinct_texts = counts.used;
+
+    uint32_t unit_count = engine->header.unit_count;
+    ws.engine = engine;
+    ws.options = &opt;
+    ws.ranked = malloc((counts.used ? counts.used : 1) * sizeof(CountEntry*));
+    ws.touched = calloc(unit_count ? unit_count : 1, 1);
+    if (!ws.ranked || !ws.touched) {
+        free(ws.ranked);
+        free(ws.touched);
+        count_table_free(&counts);
+        return CTTS_ERR_OUT_OF_MEMORY;
+    }
+    for (size_t i = 0; i < counts.capacity; i++) {
+        if (counts.slots[i].key) ws.ranked[ws.ranked_count++] = &counts.slots[i];
+    }
+    qsort(ws.ranked, ws.ranked_count, sizeof(CountEntry*), compare_count_entries);
+    if (ws.ranked_count > opt.top_k) ws.ranked_count = opt.top_k;
+
+    CTTSMemoryReport mem;
+    ctts_memory_report(engine, &mem);
+    report->db_resident_before = mem.db_resident_bytes;
+
+    /* Lazily built tables are loaded here, before the workers share them */
+    init_fade_luts();
+    init_hanning_window();
+    load_duration_rules("duration_rules.csv");
+    load_frontend_rules();
+
+    /* The index, hash table and strings are consulted by every request */
+    size_t lookup_bytes = engine->header.audio_offset;
+    if (lookup_bytes > engine->db_size) lookup_bytes = engine->db_size;
+    prefault_range(engine->db_data, lookup_bytes);
+    ws.memory_used = lookup_bytes;
+
+    pthread_t* threads = calloc((size_t)opt.num_threads, sizeof(pthread_t));
+    pthread_mutex_init(&ws.callback_lock, NULL);
+    int started = 0;
+    for (int i = 0; threads && i < opt.num_threads; i++) {
+        if (pthread_create(&threads[i], NULL, warm_worker, &ws) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        ws.inline_worker = 1;
+        warm_worker(&ws);
+    }
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&ws.callback_lock);
+    free(threads);
+
+    report->texts_warmed = ws.texts_warmed;
+    report->requests_covered = ws.requests_covered;
+    report->unit_count = unit_count;
+    for (uint32_t u = 0; u < unit_count; u++) report->units_touched += ws.touched[u];
+    report->memory_used = ws.memory_used;
+    report->budget_exhausted = ws.budget_exhausted;
+    ctts_memory_report(engine, &mem);
+    report->db_resident_after = mem.db_resident_bytes;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    report->elapsed_sec = flight_ms(&ws.start, &end) / 1000.0;
+
+    free(ws.ranked);
+    free(ws.touched);
+    count_table_free(&counts);
+    return CTTS_OK;
+}
+
+/* ============================================================================
+ * Domain Subsetting
+ * ============================================================================ */
+
+/* Sentences synthesized on both databases when verifying a subset */
+#define SUBSET_AUDIO_CHECKS 32
+
+/* Compare unit selection for one normalized sentence on two databases */
+static int subset_selection_matches(CTTS* full, CTTS* subset, const char* normalized) {
+    const char* pos_a = normalized;
+    const char* pos_b = normalized;
+    int at_word_start = 1;
+
+    while (*pos_a) {
+        SelectionToken a, b;
+        select_next(full, &pos_a, at_word_start, &a);
+        select_next(subset, &pos_b, at_word_start, &b);
+
+        if (a.kind != b.kind || a.len != b.len) return 0;
+        if (a.kind == SEL_UNIT) {
+            const CTTSIndexEntry* ea = &full->index[a.unit_idx];
+            const CTTSIndexEntry* eb = &subset->index[b.unit_idx];
+            if (ea->sample_count != eb->sample_count ||
+                memcmp(full->audio + ea->audio_offset, subset->audio + eb->audio_offset,
+                       ea->sample_count * sizeof(int16_t)) != 0) {
+                return 0;
+            }
+        }
+
+        if (a.kind == SEL_WORD_BREAK || a.kind == SEL_PUNCT) at_word_start = 1;
+        else if (a.kind == SEL_UNIT) at_word_start = 0;
+    }
+    return 1;
+}
+
+/* Re-select the corpus on both databases and compare a sample of audio */
+static int subset_verify(CTTS* full, CTTS* subset, const char* corpus_file,
+                         CTTSSubsetReport* report) {
+    FILE* f = fopen(corpus_file, "r");
+    if (!f) return CTTS_ERR_FILE_NOT_FOUND;
+
+    char* line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+    int err = CTTS_OK;
+
+    while ((len = getline(&line, &line_cap, f)) >= 0) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+        if (len == 0) continue;
+
+        char* normalized = normalize_input(line);
+        if (!normalized) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+            break;
+        }
+        if (!subset_selection_matches(full, subset, normalized)) {
+            report->selection_mismatches++;
+        }
+        free(normalized);
+        report->sentences_checked++;
+
+        if (report->audio_checked < SUBSET_AUDIO_CHECKS) {
+            int16_t *a = NULL, *b = NULL;
+            size_t na = 0, nb = 0;
+            int ea = ctts_synthesize(full, line, &a, &na, 1.0f);
+            int eb = ctts_synthesize(subset, line, &b, &nb, 1.0f);
+            if (ea != eb || na != nb || (na > 0 && memcmp(a, b, na * sizeof(int16_t)) != 0)) {
+                report->audio_mismatches++;
+            }
+            ctts_free_samples(a);
+            ctts_free_samples(b);
+            report->audio_checked++;
+        }
+    }
+
+    free(line);
+    fclose(f);
+    return err;
+}
+
+int ctts_subset_database(const char* input_db, const char* corpus_file,
+                         const char* output_db, int num_threads,
+                         CTTSSubsetReport* report) {
+    if (!input_db || !corpus_file || !output_db || !report) return CTTS_ERR_INVALID_ARG;
+    memset(report, 0, sizeof(*report));
+
+    CTTS* full = ctts_init(input_db);
+    if (!full) return CTTS_ERR_FILE_READ;
+
+    uint32_t unit_count = full->header.unit_count;
+    uint8_t* probed = calloc(unit_count ? unit_count : 1, 1);
+    BuildUnit* kept = malloc((unit_count ? unit_count : 1) * sizeof(BuildUnit));
+    CTTSCoverageReport coverage;
+    memset(&coverage, 0, sizeof(coverage));
+    int err = (probed && kept) ? CTTS_OK : CTTS_ERR_OUT_OF_MEMORY;
+
+    if (err == CTTS_OK) {
+        err = analyze_corpus(full, corpus_file, num_threads, &coverage, probed);
+    }
+
+    /* Units stay in source order, which is already sorted for longest-match */
+    size_t kept_count = 0;
+    for (uint32_t i = 0; i < unit_count && err == CTTS_OK; i++) {
+        const CTTSIndexEntry* entry = &full->index[i];
+        if (coverage.unit_hits[i] > 0) {
+            report->units_selected++;
+        } else if (probed[i]) {
+            report->units_lookahead++;
+        } else if (entry->char_count == 1) {
+            report->units_fallback++;
+        } else {
+            continue;
+        }
+
+        BuildUnit* unit = &kept[kept_count++];
+        unit->text = full->strings + entry->string_offset;
+        unit->text_len = entry->string_len;
+        unit->char_count = entry->char_count;
+        unit->samples = full->audio + entry->audio_offset;
+        unit->sample_count = entry->sample_count;
+        unit->hash = entry->hash;
+    }
+
+    if (err == CTTS_OK) err = write_database(output_db, kept, kept_count);
+
+    if (err == CTTS_OK) {
+        report->units_before = unit_count;
+        report->units_after = (uint32_t)kept_count;
+        report->bytes_before = full->db_size;
+
+        CTTS* subset = ctts_init(output_db);
+        if (!subset) {
+            err = CTTS_ERR_FILE_READ;
+        } else {
+            report->bytes_after = subset->db_size;
+            err = subset_verify(full, subset, corpus_file, report);
+            ctts_free(subset);
+        }
+    }
+
+    ctts_coverage_report_free(&coverage);
+    free(kept);
+    free(probed);
+    ctts_free(full);
+    return err;
+}
+
+/* ============================================================================
+ * Pitch Flattening
+ *
+ * Units recorded in separate takes drift in pitch, and every join between
+ * two of them that differ by more than 15% is resampled at run time by
+ * smooth_pitch_boundary(). This build pass measures each unit's median F0
+ * and moves the units outside a tolerance band around the voice median
+ * into it with TD-PSOLA (duration and formants kept).
+ * ============================================================================ */
+
+#define FLATTEN_MIN_VOICED 3        /* Voiced blocks needed to trust a median */
+#define FLATTEN_MAX_SHIFT 0.25f     /* Largest pitch change applied to a unit */
+
+/*
+ * Median pitch period of a unit in samples over its voiced analysis
+ * blocks, 0 if too few are voiced. periods holds count / PSOLA_BLOCK + 1
+ * entries.
+ */
+static uint32_t unit_median_period(const int16_t* samples, size_t count, size_t* periods,
+                                   uint32_t* voiced) {
+    size_t blocks = count / PSOLA_BLOCK + 1;
+    psola_track_pitch(samples, count, periods, blocks);
+    size_t n = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        if (periods[b] > 0) voiced[n++] = (uint32_t)periods[b];
+    }
+    if (n < FLATTEN_MIN_VOICED) return 0;
+    qsort(voiced, n, sizeof(uint32_t), compare_u32);
+    return voiced[n / 2];
+}
+
+/*
+ * Shift pitch by factor (> 1 raises it) at the same duration. Two-period
+ * grains around the input pitch marks are laid down period / factor apart,
+ * each taken from the mark nearest its output time. Unvoiced stretches are
+ * copied, and the shifted audio fades in and out over the grain tails at
+ * their edges. output holds count samples.
+ */
+static int psola_shift_pitch(const int16_t* input, size_t count, float factor,
+                             int16_t* output) {
+    size_t blocks = count / PSOLA_BLOCK + 1;
+    size_t max_marks = count / PITCH_MIN_PERIOD + 2;
+    size_t* periods = malloc(blocks * sizeof(size_t));
+    size_t* marks = malloc(max_marks * sizeof(size_t));
+    size_t* mark_periods = malloc(max_marks * sizeof(size_t));
+    float* acc = calloc(count ? count : 1, sizeof(float));
+    float* norm = calloc(count ? count : 1, sizeof(float));
+    int err = (periods && marks && mark_periods && acc && norm) ? CTTS_OK
+                                                                : CTTS_ERR_OUT_OF_MEMORY;
+
+    size_t mark_count = 0;
+    if (err == CTTS_OK) {
+        init_psola_window();
+        psola_track_pitch(input, count, periods, blocks);
+        mark_count = psola_place_marks(input, count, periods, blocks, marks, mark_periods);
+    }
+
+    double t = mark_count > 0 ? (double)marks[0] : (double)count;
+    size_t k = 0;               /* Last mark at or before t */
+    while (err == CTTS_OK && t < (double)count) {
+        while (k + 1 < mark_count && (double)marks[k + 1] <= t) k++;
+        size_t nearest = k;
+        if (k + 1 < mark_count && (double)marks[k + 1] - t < t - (double)marks[k]) {
+            nearest = k + 1;
+        }
+        if (fabs((double)marks[nearest] - t) > (double)mark_periods[nearest]) {
+            /* Past the end of a voiced stretch: resume at the next one */
+            if (k + 1 >= mark_count) break;
+            t = (double)marks[k + 1];
+            continue;
+        }
+
+        size_t period = mark_periods[nearest];
+        size_t grain = 2 * period;
+        const int16_t* src = input + marks[nearest] - period;
+        long out_start = lrint(t) - (long)period;
+        for (size_t i = 0; i < grain; i++) {
+            long o = out_start + (long)i;
+            if (o < 0 || (size_t)o >= count) continue;
+            float w = psola_window[i * PSOLA_WINDOW_RES / grain];
+            acc[o] += src[i] * w;
+            norm[o] += w;
+        }
+        t += (double)period / factor;
+    }
+
+    for (size_t i = 0; err == CTTS_OK && i < count; i++) {
+        /* Full weight wherever grains overlap, fading to the input at the edges */
+        float weight = norm[i] >= 0.5f ? 1.0f : norm[i] / 0.5f;
+        float val = input[i] * (1.0f - weight);
+        if (norm[i] > 0.0f) val += weight * acc[i] / norm[i];
+        if (val > 32767.0f) val = 32767.0f;
+        if (val < -32768.0f) val = -32768.0f;
+        output[i] = (int16_t)val;
+    }
+
+    free(periods);
+    free(marks);
+    free(mark_periods);
+    free(acc);
+    free(norm);
+    return err;
+}
+
+int ctts_flatten_pitch(const char* input_db, const char* output_db, float tolerance,
+                       CTTSFlattenReport* report) {
+    if (!input_db || !output_db || !report || tolerance < 0.0f) return CTTS_ERR_INVALID_ARG;
+    memset(report, 0, sizeof(*report));
+
+    CTTS* src = ctts_init(input_db);
+    if (!src) return CTTS_ERR_FILE_READ;
+
+    uint32_t unit_count = src->header.unit_count;
+    size_t max_samples = 0;
+    for (uint32_t i = 0; i < unit_count; i++) {
+        if (src->index[i].sample_count > max_samples) max_samples = src->index[i].sample_count;
+    }
+    size_t max_blocks = max_samples / PSOLA_BLOCK + 1;
+
+    size_t n_alloc = unit_count ? unit_count : 1;
+    uint32_t* unit_period = calloc(n_alloc, sizeof(uint32_t));
+    uint32_t* sorted = malloc(n_alloc * sizeof(uint32_t));
+    BuildUnit* units = malloc(n_alloc * sizeof(BuildUnit));
+    int16_t** shifted = calloc(n_alloc, sizeof(int16_t*));
+    size_t* periods = malloc(max_blocks * sizeof(size_t));
+    uint32_t* voiced = malloc(max_blocks * sizeof(uint32_t));
+    int err = (unit_period && sorted && units && shifted && periods && voiced)
+              ? CTTS_OK : CTTS_ERR_OUT_OF_MEMORY;
+
+    /* Median period of every unit, then of the voiced units together */
+    size_t voiced_units = 0;
+    for (uint32_t i = 0; i < unit_count && err == CTTS_OK; i++) {
+        const CTTSIndexEntry* entry = &src->index[i];
+        unit_period[i] = unit_median_period(src->audio + entry->audio_offset,
+                                            entry->sample_count, periods, voiced);
+        if (unit_period[i] > 0) sorted[voiced_units++] = unit_period[i];
+    }
+    float median_period = 0.0f;
+    if (err == CTTS_OK && voiced_units > 0) {
+        qsort(sorted, voiced_units, sizeof(uint32_t), compare_u32);
+        median_period = (float)sorted[voiced_units / 2];
+        report->voice_f0_hz = (float)CTTS_SAMPLE_RATE / median_period;
+    }
+
+    /*
+     * The band in period units, as measured. Shifted units aim halfway
+     * between the median and the edge they were beyond: re-measured
+     * periods are whole samples and the tracker jitters by about one, so
+     * aiming at the edge itself left about half of them just outside.
+     */
+    float period_lo = median_period / (1.0f + tolerance);
+    float period_hi = median_period * (1.0f + tolerance);
+    float target_lo = median_period / (1.0f + 0.5f * tolerance);
+    float target_hi = median_period * (1.0f + 0.5f * tolerance);
+    for (uint32_t i = 0; i < unit_count && err == CTTS_OK; i++) {
+        const CTTSIndexEntry* entry = &src->index[i];
+        BuildUnit* unit = &units[i];
+        unit->text = src->strings + entry->string_offset;
+        unit->text_len = entry->string_len;
+        unit->char_count = entry->char_count;
+        unit->samples = src->audio + entry->audio_offset;
+        unit->sample_count = entry->sample_count;
+        unit->hash = entry->hash;
+        if (unit_period[i] == 0) continue;
+
+        report->units_voiced++;
+        float period = (float)unit_period[i];
+        if (period >= period_lo && period <= period_hi) continue;
+        report->outside_before++;
+
+        /* Pitch factor (> 1 raises) toward the median, within the largest safe shift */
+        float factor = period / (period > period_hi ? target_hi : target_lo);
+        if (factor > 1.0f + FLATTEN_MAX_SHIFT) factor = 1.0f + FLATTEN_MAX_SHIFT;
+        if (factor < 1.0f - FLATTEN_MAX_SHIFT) factor = 1.0f - FLATTEN_MAX_SHIFT;
+
+        shifted[i] = malloc(entry->sample_count * sizeof(int16_t));
+        if (!shifted[i]) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+            break;
+        }
+        err = psola_shift_pitch(unit->samples, unit->sample_count, factor, shifted[i]);
+        unit->samples = shifted[i];
+        report->units_shifted++;
+        if (fabsf(factor - 1.0f) > report->max_shift) report->max_shift = fabsf(factor - 1.0f);
+    }
+
+    /* Measure the rewritten units again */
+    for (uint32_t i = 0; i < unit_count && err == CTTS_OK; i++) {
+        if (unit_period[i] == 0) continue;
+        uint32_t period = shifted[i] ? unit_median_period(shifted[i], units[i].sample_count,
+                                                          periods, voiced)
+                                     : unit_period[i];
+        if (period == 0 || period < period_lo || period > period_hi) report->outside_after++;
+    }
+
+    if (err == CTTS_OK) {
+        report->units = unit_count;
+        err = write_database(output_db, units, unit_count);
+    }
+
+    for (uint32_t i = 0; shifted && i < unit_count; i++) free(shifted[i]);
+    free(shifted);
+    free(unit_period);
+    free(sorted);
+    free(units);
+    free(periods);
+    free(voiced);
+    ctts_free(src);
+    return err;
+}
+
+/* ============================================================================
+ * Synthetic Test Voice
+ *
+ * Generates a deterministic dataset directory (letters/ and syllables/ in
+ * the usual layout) without recordings, so database size, page-cache and
+ * lookup scaling can be measured for voices of any size.
+ * ============================================================================ */
+
+/* Syllable grammar: onset + nucleus + coda */
+static const char* const synth_onsets[] = {
+    "", "b", "c", "d", "f", "g", "j", "l", "m", "n", "p", "r", "s", "t",
+    "v", "x", "z", "ch", "lh", "nh", "qu", "gu", "br", "cr", "dr", "fr",
+    "gr", "pr", "tr", "vr", "bl", "cl", "fl", "gl", "pl"
+};
+static const char* const synth_nuclei[] = {
+    "a", "e", "i", "o", "u", "á", "é", "í", "ó", "ú",
+    "â", "ê", "ô", "ã", "õ", "ai", "ei", "oi", "ou", "ão"
+};
+static const char* const synth_codas[] = { "", "s", "r", "l", "m", "n" };
+static const char* const synth_letters[] = {
+    "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
+    "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z",
+    "ç", "á", "é", "í", "ó", "ú", "â", "ê", "ô", "ã", "õ"
+};
+
+#define SYNTH_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+#define SYNTH_SYLLABLES (SYNTH_COUNT(synth_onsets) * SYNTH_COUNT(synth_nuclei) * \
+                         SYNTH_COUNT(synth_codas))
+/* Odd, coprime to the inventory size: scatters two-syllable strings */
+#define SYNTH_PERMUTE 2654435761ULL
+
+/* xorshift32 */
+static uint32_t synth_rand(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Uniform in [-1, 1) */
+static float synth_rand_signed(uint32_t* state) {
+    return (float)(synth_rand(state) >> 8) / 8388608.0f - 1.0f;
+}
+
+static void synth_syllable(size_t idx, char* out) {
+    size_t n_codas = SYNTH_COUNT(synth_codas);
+    size_t n_nuclei = SYNTH_COUNT(synth_nuclei);
+    strcat(out, synth_onsets[idx / (n_nuclei * n_codas)]);
+    strcat(out, synth_nuclei[(idx / n_codas) % n_nuclei]);
+    strcat(out, synth_codas[idx % n_codas]);
+}
+
+/* i-th candidate unit string: single syllables first, then scattered pairs */
+static void synth_unit_text(uint64_t i, char* out) {
+    out[0] = '\0';
+    if (i < SYNTH_SYLLABLES) {
+        synth_syllable((size_t)i, out);
+        return;
+    }
+    uint64_t pairs = (uint64_t)SYNTH_SYLLABLES * SYNTH_SYLLABLES;
+    uint64_t j = ((i - SYNTH_SYLLABLES) * SYNTH_PERMUTE) % pairs;
+    synth_syllable((size_t)(j / SYNTH_SYLLABLES), out);
+    synth_syllable((size_t)(j % SYNTH_SYLLABLES), out);
+}
+
+/*
+ * Render one unit: a harmonic tone with a gliding F0 for each vowel and a
+ * filtered noise burst for each consonant, with short ramps between them.
+ */
+static int16_t* synth_unit_audio(const char* text, uint32_t seed, size_t* out_count) {
+    uint32_t rng = seed * 2654435761U + 0x9E3779B9U;
+    if (rng == 0) rng = 1;
+
+    size_t chars = ctts_utf8_strlen(text);
+    if (chars == 0) chars = 1;
+    float seconds = (chars == 1 ? 0.12f : 0.06f + 0.045f * chars) *
+                    (1.0f + 0.1f * synth_rand_signed(&rng));
+    size_t count = (size_t)(seconds * CTTS_SAMPLE_RATE);
+    int16_t* samples = malloc(count * sizeof(int16_t));
+    if (!samples) return NULL;
+
+    float f0_start = 90.0f + 130.0f * (0.5f + 0.5f * synth_rand_signed(&rng));
+    float f0_end = f0_start * (1.0f + 0.15f * synth_rand_signed(&rng));
+    float noise_pole = 0.2f + 0.6f * (0.5f + 0.5f * synth_rand_signed(&rng));
+    size_t seg_len = count / chars;
+    size_t ramp = CTTS_SAMPLE_RATE / 250;   /* 4 ms */
+    double phase = 0.0;
+    float noise_state = 0.0f;
+
+    const char* p = text;
+    for (size_t c = 0; c < chars; c++) {
+        uint32_t cp = *p ? ctts_utf8_next(&p) : 'a';
+        int voiced = is_vowel(cp);
+        size_t start = c * seg_len;
+        size_t end = (c == chars - 1) ? count : start + seg_len;
+
+        for (size_t i = start; i < end; i++) {
+            float t = (float)i / (float)count;
+            float f0 = f0_start + (f0_end - f0_start) * t;
+            phase += 2.0 * PI * f0 / CTTS_SAMPLE_RATE;
+            if (phase > 2.0 * PI) phase -= 2.0 * PI;
+
+            float v;
+            if (voiced) {
+                v = 0.0f;
+                for (int h = 1; h <= 6; h++) v += sinf((float)(phase * h)) / (float)h;
+                v *= 0.2f;
+            } else {
+                noise_state = noise_pole * noise_state +
+                              (1.0f - noise_pole) * synth_rand_signed(&rng);
+                v = 0.5f * noise_state;
+            }
+
+            /* Ramps at segment borders and unit edges */
+            size_t from_start = i - start, to_end = end - 1 - i;
+            size_t edge = from_start < to_end ? from_start : to_end;
+            if (edge < ramp) v *= (float)edge / (float)ramp;
+
+            samples[i] = (int16_t)(v * 32767.0f);
+        }
+    }
+
+    *out_count = count;
+    return samples;
+}
+
+static int synth_write_set(const char* dir, const char* index_name, const char* prefix,
+                           const char* const* texts, size_t count, uint32_t seed_base) {
+    char path[2048];
+    snprintf(path, sizeof(path), "%s/wavs", dir);
+    if ((mkdir(dir, 0755) != 0 && errno != EEXIST) ||
+        (mkdir(path, 0755) != 0 && errno != EEXIST)) {
+        return CTTS_ERR_FILE_WRITE;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", dir, index_name);
+    FILE* index = fopen(path, "w");
+    if (!index) return CTTS_ERR_FILE_WRITE;
+
+    int err = CTTS_OK;
+    for (size_t i = 0; i < count && err == CTTS_OK; i++) {
+        size_t sample_count;
+        int16_t* samples = synth_unit_audio(texts[i], seed_base + (uint32_t)i, &sample_count);
+        if (!samples) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+            break;
+        }
+        snprintf(path, sizeof(path), "%s/wavs/%s%zu.wav", dir, prefix, i);
+        err = ctts_write_wav(path, samples, sample_count, CTTS_SAMPLE_RATE);
+        free(samples);
+        fprintf(index, "%s%zu|%s|%s\n", prefix, i, texts[i], texts[i]);
+    }
+
+    if (fclose(index) != 0 && err == CTTS_OK) err = CTTS_ERR_FILE_WRITE;
+    return err;
+}
+
+int ctts_make_test_voice(const char* output_dir, size_t unit_count, uint32_t seed) {
+    if (!output_dir) return CTTS_ERR_INVALID_ARG;
+    uint64_t candidates = (uint64_t)SYNTH_SYLLABLES +
+                          (uint64_t)SYNTH_SYLLABLES * SYNTH_SYLLABLES;
+    if ((uint64_t)unit_count > candidates) return CTTS_ERR_INVALID_ARG;
+
+    if (mkdir(output_dir, 0755) != 0 && errno != EEXIST) return CTTS_ERR_FILE_WRITE;
+
+    char letters_dir[1024], syllables_dir[1024];
+    snprintf(letters_dir, sizeof(letters_dir), "%s/letters", output_dir);
+    snprintf(syllables_dir, sizeof(syllables_dir), "%s/syllables", output_dir);
+
+    int err = synth_write_set(letters_dir, "letters.txt", "l", synth_letters,
+                              SYNTH_COUNT(synth_letters), seed);
+    if (err != CTTS_OK) return err;
+
+    /* Generate distinct syllable strings (pairs can spell the same text) */
+    CountTable seen;
+    char** texts = calloc(unit_count ? unit_count : 1, sizeof(char*));
+    if (!texts || count_table_init(&seen, 1024) != CTTS_OK) {
+        free(texts);
+        return CTTS_ERR_OUT_OF_MEMORY;
+    }
+
+    size_t made = 0;
+    char text[64];
+    for (uint64_t i = 0; i < candidates && made < unit_count && err == CTTS_OK; i++) {
+        synth_unit_text(i, text);
+        size_t len = strlen(text);
+        if (ctts_utf8_strlen(text) < 2) continue;   /* Single characters live in letters/ */
+        size_t before = seen.used;
+        err = count_table_add(&seen, text, len, 1);
+        if (err == CTTS_OK && seen.used > before) {
+            texts[made] = malloc(len + 1);
+            if (!texts[made]) {
+                err = CTTS_ERR_OUT_OF_MEMORY;
+                break;
+            }
+            memcpy(texts[made++], text, len + 1);
+        }
+    }
+    if (err == CTTS_OK && made < unit_count) err = CTTS_ERR_INVALID_ARG;
+
+    if (err == CTTS_OK) {
+        err = synth_write_set(syllables_dir, "sillabes.txt", "s", (const char* const*)texts,
+                              made, seed + (uint32_t)SYNTH_COUNT(synth_letters));
+    }
+
+    for (size_t i = 0; i < made; i++) free(texts[i]);
+    free(texts);
+    count_table_free(&seen);
+    return err;
+}
+
+/* ============================================================================
+ * Benchmarks
+ * ============================================================================ */
+
+static double bench_seconds_since(const struct timespec* t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (double)(t1.tv_sec - t0->tv_sec) + (double)(t1.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+/* Number verbalizer throughput on generated billing-style text */
+static int bench_numbers(double megabytes) {
+    size_t target = (size_t)(megabytes * 1024 * 1024);
+    size_t cap = target + 256;
+    char* text = malloc(cap);
+    if (!text) return CTTS_ERR_OUT_OF_MEMORY;
+
+    size_t len = 0, lines = 0;
+    uint32_t rng = 12345;
+    while (len < target) {
+        uint32_t a = synth_rand(&rng), b = synth_rand(&rng);
+        int n = snprintf(text + len, cap - len,
+                         "Fatura de R$ %u.%03u,%02u vence em %02u/%02u/20%02u às %02u:%02u. "
+                         "Ligue (%02u) 9%04u-%04u, desconto de %u,%u%% no %uº mês, %u pontos.\n",
+                         a % 100, b % 1000, a % 100, 1 + a % 28, 1 + b % 12, a % 30,
+                         a % 24, b % 60, 11 + a % 89, b % 10000, a % 10000,
+                         a % 50, b % 10, 1 + b % 12, a % 100000);
+        if (n < 0 || (size_t)n >= cap - len) break;
+        len += (size_t)n;
+        lines++;
+    }
+
+    /* Seven numbers per line: amount, date, time, phone, percent, ordinal, count */
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    char* expanded = expand_numbers(text);
+    double elapsed = bench_seconds_since(&t0);
+    if (!expanded) {
+        free(text);
+        return CTTS_ERR_OUT_OF_MEMORY;
+    }
+
+    printf("Number verbalizer: %.2f MB in, %.2f MB out, %.3f s\n",
+           len / (1024.0 * 1024.0), strlen(expanded) / (1024.0 * 1024.0), elapsed);
+    printf("  %.1f MB/s, %.2f M numbers/s\n",
+           len / (1024.0 * 1024.0) / elapsed, lines * 7 / 1e6 / elapsed);
+
+    free(expanded);
+    free(text);
+    return CTTS_OK;
+}
+
+/* A burst of requests (one workload line each) served by worker threads */
+typedef struct {
+    const CTTS* engine;
+    char** texts;
+    size_t count;
+    float speed;
+    int threads;
+    size_t next;
+    double* service_ms;     /* Per request */
+    double audio_sec;       /* Sum over requests, guarded by lock */
+    pthread_mutex_t lock;
+} BenchLoadState;
+
+static void* bench_load_worker(void* arg) {
+    BenchLoadState* bs = (BenchLoadState*)arg;
+    CTTS engine = *bs->engine;
+
+    for (;;) {
+        size_t i = __atomic_fetch_add(&bs->next, 1, __ATOMIC_RELAXED);
+        if (i >= bs->count) break;
+
+        /* Requests not yet started are the queue, shared by the workers */
+        ctts_load_control_set_queue_depth((uint32_t)((bs->count - i - 1) / (size_t)bs->threads));
+
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int16_t* samples;
+        size_t sample_count;
+        if (ctts_synthesize(&engine, bs->texts[i], &samples, &sample_count, bs->speed) != CTTS_OK) {
+            continue;
+        }
+        bs->service_ms[i] = bench_seconds_since(&t0) * 1000.0;
+        ctts_free_samples(samples);
+
+        pthread_mutex_lock(&bs->lock);
+        bs->audio_sec += (double)sample_count / CTTS_SAMPLE_RATE;
+        pthread_mutex_unlock(&bs->lock);
+    }
+    return NULL;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Serve the whole burst once and print latency figures */
+static int bench_load_pass(BenchLoadState* bs, const char* label) {
+    bs->next = 0;
+    bs->audio_sec = 0.0;
+    memset(bs->service_ms, 0, bs->count * sizeof(double));
+
+    pthread_t* workers = malloc((size_t)bs->threads * sizeof(pthread_t));
+    if (!workers) return CTTS_ERR_OUT_OF_MEMORY;
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int started = 0;
+    for (int t = 0; t < bs->threads; t++) {
+        if (pthread_create(&workers[t], NULL, bench_load_worker, bs) == 0) started++;
+    }
+    if (started == 0) bench_load_worker(bs);
+    for (int t = 0; t < started; t++) pthread_join(workers[t], NULL);
+    double wall = bench_seconds_since(&t0);
+    free(workers);
+
+    qsort(bs->service_ms, bs->count, sizeof(double), compare_double);
+    double sum = 0.0;
+    for (size_t i = 0; i < bs->count; i++) sum += bs->service_ms[i];
+    printf("%s: %zu requests in %.2f s (%.1f req/s, RTF %.3f)\n", label, bs->count, wall,
+           bs->count / wall, bs->audio_sec > 0 ? wall / bs->audio_sec : 0.0);
+    printf("  Service time: mean %.1f ms, p50 %.1f ms, p95 %.1f ms, max %.1f ms\n",
+           sum / bs->count, bs->service_ms[bs->count / 2],
+           bs->service_ms[(bs->count * 95) / 100], bs->service_ms[bs->count - 1]);
+    return CTTS_OK;
+}
+
+static const char* quality_level_name(int level) {
+    static const char* const names[CTTS_QUALITY_LEVELS] = {
+        "full", "no boundary smoothing", "coarse WSOLA", "simple intonation"
+    };
+    return (level >= 0 && level < CTTS_QUALITY_LEVELS) ? names[level] : "?";
+}
+
+/* Non-empty lines of a workload file; the caller frees each line and the array */
+static int bench_read_lines(const char* path, char*** lines, size_t* count) {
+    FILE* f = fopen(path, "r");
+    if (!f) return CTTS_ERR_FILE_NOT_FOUND;
+
+    *lines = NULL;
+    *count = 0;
+    size_t cap = 0;
+    char* line = NULL;
+    size_t line_cap = 0;
+    int err = CTTS_OK;
+    while (getline(&line, &line_cap, f) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') continue;
+        if (*count == cap) {
+            cap = cap ? cap * 2 : 256;
+            char** grown = realloc(*lines, cap * sizeof(char*));
+            if (!grown) {
+                err = CTTS_ERR_OUT_OF_MEMORY;
+                break;
+            }
+            *lines = grown;
+        }
+        if (!((*lines)[*count] = strdup(line))) {
+            err = CTTS_ERR_OUT_OF_MEMORY;
+            break;
+        }
+        (*count)++;
+    }
+    free(line);
+    fclose(f);
+    return err;
+}
+
+/* Same burst at full quality, then with load-adaptive quality */
+static int bench_load(const char* db_path, const char* workload, double target_ms,
+                      int threads, float speed) {
+    BenchLoadState bs;
+    memset(&bs, 0, sizeof(bs));
+    int err = bench_read_lines(workload, &bs.texts, &bs.count);
+
+    CTTS* engine = NULL;
+    if (err == CTTS_OK && bs.count == 0) err = CTTS_ERR_INVALID_ARG;
+    if (err == CTTS_OK && !(bs.service_ms = malloc(bs.count * sizeof(double)))) {
+        err = CTTS_ERR_OUT_OF_MEMORY;
+    }
+    if (err == CTTS_OK && !(engine = ctts_init(db_path))) err = CTTS_ERR_FILE_NOT_FOUND;
+
+    if (err == CTTS_OK) {
+        ctts_load_config(&engine->config, "config.yaml");
+        bs.engine = engine;
+        bs.speed = speed;
+        bs.threads = threads;
+        pthread_mutex_init(&bs.lock, NULL);
+
+        /* Warm-up so neither pass pays for page faults and rule loading */
+        int16_t* samples;
+        size_t sample_count;
+        if (ctts_synthesize(engine, bs.texts[0], &samples, &sample_count, speed) == CTTS_OK) {
+            ctts_free_samples(samples);
+        }
+
+        printf("Burst of %zu requests, %d threads, speed %.2f, target %.0f ms\n\n",
+               bs.count, threads, speed, target_ms);
+        err = bench_load_pass(&bs, "Full quality");
+        if (err == CTTS_OK) {
+            ctts_load_control_enable(target_ms);
+            err = bench_load_pass(&bs, "Load-adaptive");
+            ctts_load_control_set_queue_depth(0);
+        }
+
+        CTTSLoadStats stats;
+        if (err == CTTS_OK && ctts_load_control_stats(&stats) == CTTS_OK) {
+            printf("  Level now: %s (avg latency %.1f ms, RTF %.3f)\n",
+                   quality_level_name(stats.level), stats.avg_latency_ms, stats.avg_rtf);
+            printf("  Steps down: %llu, up: %llu\n",
+                   (unsigned long long)stats.step_downs, (unsigned long long)stats.step_ups);
+            for (int l = 0; l < CTTS_QUALITY_LEVELS; l++) {
+                printf("  %-22s %llu requests\n", quality_level_name(l),
+                       (unsigned long long)stats.requests_at_level[l]);
+            }
+            for (size_t i = 0; i < stats.event_count; i++) {
+                const CTTSQualityEvent* ev = &stats.events[i];
+                printf("  after request %llu: %s -> %s (estimate %.0f ms, queue %u)\n",
+                       (unsigned long long)ev->request, quality_level_name(ev->from_level),
+                       quality_level_name(ev->to_level), ev->predicted_ms, ev->queue_depth);
+            }
+        }
+        ctts_load_control_disable();
+        pthread_mutex_destroy(&bs.lock);
+    }
+
+    for (size_t i = 0; i < bs.count; i++) free(bs.texts[i]);
+    free(bs.texts);
+    free(bs.service_ms);
+    if (engine) ctts_free(engine);
+    return err;
+}
+
+/* N independent ctts_synthesize() calls against batches of batch_size */
+static int bench_batch(const char* db_path, const char* workload, size_t batch_size,
+                       float speed) {
+    char** texts = NULL;
+    size_t count = 0;
+    int err = bench_read_lines(workload, &texts, &count);
+    if (err == CTTS_OK && count == 0) err = CTTS_ERR_INVALID_ARG;
+
+    CTTS* engine = NULL;
+    CTTSBatchItem* single = NULL;
+    CTTSBatchItem* batched = NULL;
+    if (err == CTTS_OK) {
+        single = calloc(count, sizeof(CTTSBatchItem));
+        batched = calloc(count, sizeof(CTTSBatchItem));
+        if (!single || !batched) err = CTTS_ERR_OUT_OF_MEMORY;
+    }
+    if (err == CTTS_OK && !(engine = ctts_init(db_path))) err = CTTS_ERR_FILE_NOT_FOUND;
+
+    if (err == CTTS_OK) {
+        ctts_load_config(&engine->config, "config.yaml");
+
+        /* Warm-up so neither run pays for page faults and rule loading */
+        int16_t* samples;
+        size_t sample_count;
+        if (ctts_synthesize(engine, texts[0], &samples, &sample_count, speed) == CTTS_OK) {
+            ctts_free_samples(samples);
+        }
+
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (size_t i = 0; i < count; i++) {
+            single[i].status = ctts_synthesize(engine, texts[i], &single[i].samples,
+                                               &single[i].sample_count, speed);
+        }
+        double single_sec = bench_seconds_since(&t0);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (size_t i = 0; i < count; i += batch_size) {
+            size_t n = (count - i < batch_size) ? count - i : batch_size;
+            ctts_synthesize_batch(engine, (const char* const*)texts + i, n, speed, batched + i);
+        }
+        double batch_sec = bench_seconds_since(&t0);
+
+        double audio_sec = 0.0;
+        size_t mismatched = 0;
+        for (size_t i = 0; i < count; i++) {
+            audio_sec += (double)single[i].sample_count / CTTS_SAMPLE_RATE;
+            if (single[i].status != batched[i].status ||
+                single[i].sample_count != batched[i].sample_count ||
+                (single[i].sample_count > 0 &&
+                 memcmp(single[i].samples, batched[i].samples,
+                        single[i].sample_count * sizeof(int16_t)) != 0)) {
+                mismatched++;
+            }
+        }
+
+        printf("%zu prompts, %.1f s of audio, speed %.2f\n", count, audio_sec, speed);
+        printf("  Independent calls: %.3f s (%.1f prompts/s, %.0fx real time)\n",
+               single_sec, count / single_sec, audio_sec / single_sec);
+        printf("  Batches of %-6zu  %.3f s (%.1f prompts/s, %.0fx real time)\n",
+               batch_size, batch_sec, count / batch_sec, audio_sec / batch_sec);
+        printf("  Speedup: %.2fx, outputs %s\n", single_sec / batch_sec,
+               mismatched ? "DIFFER" : "identical");
+        if (mismatched) printf("  %zu prompts differ\n", mismatched);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (single) ctts_free_samples(single[i].samples);
+        if (batched) ctts_free_samples(batched[i].samples);
+        free(texts[i]);
+    }
+    free(single);
+    free(batched);
+    free(texts);
+    if (engine) ctts_free(engine);
+    return err;
+}
+
+/* ============================================================================
+ * Stretch benchmark: WSOLA against PSOLA at 0.5x-2.0x. Quality is the
+ * round-trip log-spectral distance: stretch by s, then by 1/s, and compare
+ * 512-sample magnitude spectra with the original (lower is better; 0 would
+ * be a perfect round trip).
+ * ============================================================================ */
+
+#define LSD_FRAME 512
+
+/* In-place radix-2 FFT of LSD_FRAME points */
+static void bench_fft(float* re, float* im) {
+    static float twiddle_re[LSD_FRAME / 2], twiddle_im[LSD_FRAME / 2];
+    static int twiddles_ready = 0;
+    if (!twiddles_ready) {
+        for (size_t k = 0; k < LSD_FRAME / 2; k++) {
+            twiddle_re[k] = (float)cos(-2.0 * M_PI * k / LSD_FRAME);
+            twiddle_im[k] = (float)sin(-2.0 * M_PI * k / LSD_FRAME);
+        }
+        twiddles_ready = 1;
+    }
+    for (size_t i = 1, j = 0; i < LSD_FRAME; i++) {
+        size_t bit = LSD_FRAME >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (size_t len = 2; len <= LSD_FRAME; len <<= 1) {
+        size_t stride = LSD_FRAME / len;
+        for (size_t i = 0; i < LSD_FRAME; i += len) {
+            for (size_t k = 0; k < len / 2; k++) {
+                float wr = twiddle_re[k * stride], wi = twiddle_im[k * stride];
+                float xr = re[i + k + len / 2] * wr - im[i + k + len / 2] * wi;
+                float xi = re[i + k + len / 2] * wi + im[i + k + len / 2] * wr;
+                re[i + k + len / 2] = re[i + k] - xr;
+                im[i + k + len / 2] = im[i + k] - xi;
+                re[i + k] += xr;
+                im[i + k] += xi;
+            }
+        }
+    }
+}
+
+/* Power spectrum (dB) of one Hann-windowed frame, bins 1..LSD_FRAME/2 */
+static void bench_frame_db(const int16_t* x, float* db) {
+    float re[LSD_FRAME], im[LSD_FRAME];
+    for (size_t i = 0; i < LSD_FRAME; i++) {
+        re[i] = x[i] * hanning(i, LSD_FRAME);
+        im[i] = 0.0f;
+    }
+    bench_fft(re, im);
+    for (size_t k = 1; k <= LSD_FRAME / 2; k++) {
+        db[k - 1] = 10.0f * log10f(re[k] * re[k] + im[k] * im[k] + 1e3f);
+    }
+}
+
+/* Sum of per-frame log-spectral distances over voiced frames of a; *frames counts them */
+static double bench_lsd(const int16_t* a, size_t a_count, const int16_t* b, size_t b_count,
+                        size_t* frames) {
+    size_t n = a_count < b_count ? a_count : b_count;
+    float da[LSD_FRAME / 2], dbb[LSD_FRAME / 2];
+    double total = 0.0;
+    for (size_t pos = 0; pos + LSD_FRAME <= n; pos += LSD_FRAME / 2) {
+        double energy = 0.0;
+        for (size_t i = 0; i < LSD_FRAME; i++) energy += (double)a[pos + i] * a[pos + i];
+        if (energy < LSD_FRAME * 250.0 * 250.0) continue;     /* Skip pauses */
+        bench_frame_db(a + pos, da);
+        bench_frame_db(b + pos, dbb);
+        double sum = 0.0;
+        for (size_t k = 0; k < LSD_FRAME / 2; k++) {
+            double d = da[k] - dbb[k];
+            sum += d * d;
+        }
+        total += sqrt(sum / (LSD_FRAME / 2));
+        (*frames)++;
+    }
+    return total;
+}
+
+static int bench_stretch(const char* db_path, const char* workload) {
+    static const float speeds[] = {0.5f, 0.75f, 1.25f, 1.5f, 2.0f};
+    static const int methods[] = {STRETCH_WSOLA, STRETCH_PSOLA};
+    char** texts = NULL;
+    size_t count = 0;
+    int err = bench_read_lines(workload, &texts, &count);
+    if (err == CTTS_OK && count == 0) err = CTTS_ERR_INVALID_ARG;
+
+    CTTS* engine = NULL;
+    CTTSBatchItem* rendered = NULL;
+    if (err == CTTS_OK && !(rendered = calloc(count, sizeof(CTTSBatchItem)))) {
+        err = CTTS_ERR_OUT_OF_MEMORY;
+    }
+    if (err == CTTS_OK && !(engine = ctts_init(db_path))) err = CTTS_ERR_FILE_NOT_FOUND;
+
+    double audio_sec = 0.0;
+    if (err == CTTS_OK) {
+        ctts_load_config(&engine->config, "config.yaml");
+        for (size_t i = 0; i < count && err == CTTS_OK; i++) {
+            err = ctts_synthesize(engine, texts[i], &rendered[i].samples,
+                                  &rendered[i].sample_count, 1.0f);
+            audio_sec += (double)rendered[i].sample_count / CTTS_SAMPLE_RATE;
+        }
+    }
+
+    if (err == CTTS_OK) {
+        printf("%zu prompts, %.1f s of audio rendered at speed 1.0\n", count, audio_sec);
+        printf("  speed  method  stretch time    x real time  round-trip LSD  length error\n");
+    }
+    for (size_t s = 0; err == CTTS_OK && s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+        for (size_t m = 0; err == CTTS_OK && m < sizeof(methods) / sizeof(methods[0]); m++) {
+            double seconds = 0.0, lsd = 0.0, length_error = 0.0;
+            size_t frames = 0;
+            for (size_t i = 0; i < count && err == CTTS_OK; i++) {
+                int16_t* once = NULL;
+                int16_t* back = NULL;
+                size_t once_count = 0, back_count = 0;
+                struct timespec t0;
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                err = stretch_to_buffer(rendered[i].samples, rendered[i].sample_count,
+                                        speeds[s], NULL, methods[m], NULL,
+                                        &once, &once_count, NULL);
+                seconds += bench_seconds_since(&t0);
+                if (err == CTTS_OK) {
+                    err = stretch_to_buffer(once, once_count, 1.0f / speeds[s], NULL,
+                                            methods[m], NULL, &back, &back_count, NULL);
+                }
+                if (err == CTTS_OK) {
+                    lsd += bench_lsd(rendered[i].samples, rendered[i].sample_count,
+                                     back, back_count, &frames);
+                    length_error += fabs((double)once_count -
+                                         rendered[i].sample_count / speeds[s]);
+                }
+                free(once);
+                free(back);
+            }
+            if (err != CTTS_OK) break;
+            printf("  %4.2fx  %-6s  %9.1f ms  %12.0fx  %11.2f dB  %10.2f%%\n", speeds[s],
+                   methods[m] == STRETCH_PSOLA ? "PSOLA" : "WSOLA", seconds * 1000.0,
+                   audio_sec / seconds, frames ? lsd / frames : 0.0,
+                   100.0 * length_error / (audio_sec * CTTS_SAMPLE_RATE / speeds[s]));
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (rendered) ctts_free_samples(rendered[i].samples);
+        free(texts[i]);
+    }
+    free(rendered);
+    free(texts);
+    if (engine) ctts_free(engine);
+    return err;
+}
+
+/*
+ * Silence removal kernel: the run-based remove_silence_regions() against
+ * the sample-at-a-time reference, on word-sized windows of rendered
+ * prompts (rendered with word silence kept so the windows contain it).
+ */
+static int bench_silence(const char* db_path, const char* workload) {
+    const size_t window = CTTS_SAMPLE_RATE * 3 / 10;    /* About one word */
+    const int rounds = 20;
+    char** texts = NULL;
+    size_t count = 0;
+    int err = bench_read_lines(workload, &texts, &count);
+    if (err == CTTS_OK && count == 0) err = CTTS_ERR_INVALID_ARG;
+
+    CTTS* engine = NULL;
+    SampleBuffer audio = {0};
+    if (err == CTTS_OK && !(engine = ctts_init(db_path))) err = CTTS_ERR_FILE_NOT_FOUND;
+    if (err == CTTS_OK) err = buffer_init(&audio, CTTS_SAMPLE_RATE);
+    if (err == CTTS_OK) {
+        ctts_load_config(&engine->config, "config.yaml");
+        engine->config.remove_word_silence = 0;
+        for (size_t i = 0; i < count && err == CTTS_OK; i++) {
+            int16_t* samples;
+            size_t sample_count;
+            err = ctts_synthesize(engine, texts[i], &samples, &sample_count, 1.0f);
+            if (err == CTTS_OK) {
+                err = buffer_grow(&audio, sample_count);
+                if (err == CTTS_OK) {
+                    memcpy(audio.data + audio.count, samples, sample_count * sizeof(int16_t));
+                    audio.count += sample_count;
+                }
+                ctts_free_samples(samples);
+            }
+        }
+    }
+
+    int16_t* work = NULL;
+    if (err == CTTS_OK && !(work = malloc(window * sizeof(int16_t)))) err = CTTS_ERR_OUT_OF_MEMORY;
+    if (err == CTTS_OK && audio.count < window) err = CTTS_ERR_INVALID_ARG;
+
+    if (err == CTTS_OK) {
+        const CTTSConfig* config = &engine->config;
+        size_t min_silence = (size_t)(config->min_silence_ms * CTTS_SAMPLE_RATE / 1000.0f);
+        size_t windows = audio.count / window;
+        double seconds[2] = {0.0, 0.0};
+        size_t kept[2] = {0, 0};
+        size_t mismatches = 0;
+        int16_t* reference = malloc(window * sizeof(int16_t));
+        if (!reference) err = CTTS_ERR_OUT_OF_MEMORY;
+
+        for (size_t w = 0; err == CTTS_OK && w < windows; w++) {
+            const int16_t* in = audio.data + w * window;
+            size_t out_count[2] = {0, 0};
+            for (int k = 0; k < 2; k++) {
+                struct timespec t0;
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                for (int r = 0; r < rounds; r++) {
+                    memcpy(work, in, window * sizeof(int16_t));
+                    if (k == 0) {
+                        int16_t peak = 0;
+                        for (size_t i = 0; i < window; i++) {
+                            int16_t abs_val = work[i] > 0 ? work[i] : -work[i];
+                            if (abs_val > peak) peak = abs_val;
+                        }
+                        out_count[k] = (peak == 0) ? window :
+                            remove_silence_samplewise(work, window,
+                                                      (int16_t)(peak * config->silence_threshold),
+                                                      min_silence);
+                    } else {
+                        out_count[k] = remove_silence_regions(work, window,
+                                                              config->silence_threshold,
+                                                              min_silence);
+                    }
+                }
+                seconds[k] += bench_seconds_since(&t0);
+                kept[k] += out_count[k];
+                if (k == 0) memcpy(reference, work, out_count[k] * sizeof(int16_t));
+            }
+            if (out_count[0] != out_count[1] ||
+                memcmp(reference, work, out_count[0] * sizeof(int16_t)) != 0) {
+                mismatches++;
+            }
+        }
+        free(reference);
+
+        if (err == CTTS_OK) {
+            double total = (double)windows * window * rounds;
+            printf("%zu windows of %zu samples, %d rounds (memcpy of the input included)\n",
+                   windows, window, rounds);
+            printf("  kernel       ns/sample  Msamples/s  kept\n");
+            for (int k = 0; k < 2; k++) {
+                printf("  %-11s  %9.3f  %10.1f  %5.1f%%\n", k == 0 ? "sample-wise" : "run-based",
+                       seconds[k] * 1e9 / total, total / seconds[k] / 1e6,
+                       100.0 * kept[k] / ((double)windows * window));
+            }
+            printf("  speedup %.2fx, %zu mismatching windows\n", seconds[0] / seconds[1], mismatches);
+            if (mismatches) err = CTTS_ERR_INVALID_FORMAT;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) free(texts[i]);
+    free(texts);
+    free(work);
+    free(audio.data);
+    if (engine) ctts_free(engine);
+    return err;
+}
+
+/*
+ * Pitch contour stage on word-sized windows of rendered prompts: linear
+ * and cubic resampling, a 0.95 -> 1.05 contour per window.
+ */
+static int bench_pitch(const char* db_path, const char* workload) {
+    const size_t window = CTTS_SAMPLE_RATE * 3 / 10;    /* About one word */
+    const int rounds = 20;
+    char** texts = NULL;
+    size_t count = 0;
+    int err = bench_read_lines(workload, &texts, &count);
+    if (err == CTTS_OK && count == 0) err = CTTS_ERR_INVALID_ARG;
+
+    CTTS* engine = NULL;
+    SampleBuffer audio = {0};
+    if (err == CTTS_OK && !(engine = ctts_init(db_path))) err = CTTS_ERR_FILE_NOT_FOUND;
+    if (err == CTTS_OK) err = buffer_init(&audio, CTTS_SAMPLE_RATE);
+    if (err == CTTS_OK) {
+        ctts_load_config(&engine->config, "config.yaml");
+        for (size_t i = 0; i < count && err == CTTS_OK; i++) {
+            int16_t* samples;
+            size_t sample_count;
+            err = ctts_synthesize(engine, texts[i], &samples, &sample_count, 1.0f);
+            if (err == CTTS_OK) {
+                err = buffer_grow(&audio, sample_count);
+                if (err == CTTS_OK) {
+                    memcpy(audio.data + audio.count, samples, sample_count * sizeof(int16_t));
+                    audio.count += sample_count;
+                }
+                ctts_free_samples(samples);
+            }
+        }
+    }
+
+    int16_t* work = NULL;
+    if (err == CTTS_OK && !(work = malloc(window * sizeof(int16_t)))) err = CTTS_ERR_OUT_OF_MEMORY;
+    if (err == CTTS_OK && audio.count < window) err = CTTS_ERR_INVALID_ARG;
+
+    if (err == CTTS_OK) {
+        static const int modes[] = {CTTS_PITCH_LINEAR, CTTS_PITCH_CUBIC};
+        size_t windows = audio.count / window;
+        double total = (double)windows * window * rounds;
+        printf("%zu windows of %zu samples, %d rounds (memcpy of the input included)\n",
+               windows, window, rounds);
+        printf("  stage                ns/sample  Msamples/s\n");
+        for (size_t m = 0; m < 3; m++) {
+            struct timespec t0;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            for (size_t w = 0; w < windows; w++) {
+                for (int r = 0; r < rounds; r++) {
+                    memcpy(work, audio.data + w * window, window * sizeof(int16_t));
+                    if (m < 2) apply_smooth_pitch_contour(work, window, 0.95f, 1.05f, modes[m]);
+                    else apply_pitch_shift(work, window, 1.05f);
+                }
+            }
+            double seconds = bench_seconds_since(&t0);
+            printf("  %-19s  %9.3f  %10.1f\n",
+                   m == 0 ? "contour (linear)" : m == 1 ? "contour (cubic)" : "pitch shift",
+                   seconds * 1e9 / total, total / seconds / 1e6);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) free(texts[i]);
+    free(texts);
+    free(work);
+    free(audio.data);
+    if (engine) ctts_free(engine);
+    return err;
+}
+
+/* ============================================================================
+ * RTP Streaming
+ *
+ * Paced RTP over UDP for SIP media servers. An input session synthesizes
+ * incrementally and encodes into a queue; a sender thread cuts the queue
+ * into ptime packets and sends each one at its slot on the monotonic clock,
+ * a small lead ahead of real time so the far end's jitter buffer starts
+ * full. PCMU is resampled to 8 kHz in-process; L16 goes out at the native
+ * rate under a dynamic payload type (L16/22050/1).
+ * ============================================================================ */
+
+#define RTP_HEADER_SIZE 12
+#define RTP_PT_PCMU 0
+#define RTP_PT_L16 96
+#define RTP_MAX_PAYLOAD 1400
+#define RTP_QUEUE_SECONDS 30        /* How far synthesis may run ahead */
+#define RTP_MAX_JUMP_SECONDS 10     /* How far past the received audio a packet may land */
+
+/* 22050 Hz to 8000 Hz is 160/441: one windowed-sinc filter per output phase */
+#define RS8K_PHASES 160
+#define RS8K_STEP 441
+#define RS8K_HALF_TAPS 16
+#define RS8K_CUTOFF_HZ 3600.0
+
+typedef enum {
+    RTP_CODEC_PCMU,
+    RTP_CODEC_L16
+} RtpCodec;
+
+typedef struct {
+    float taps[RS8K_PHASES][2 * RS8K_HALF_TAPS];
+    int16_t* input;
+    size_t input_count;
+    size_t input_capacity;
+    uint64_t input_base;        /* Absolute index of input[0] */
+    uint64_t next_output;
+} Resampler8k;
+
+static void resampler_8k_init(Resampler8k* rs) {
+    double fc = 2.0 * RS8K_CUTOFF_HZ / CTTS_SAMPLE_RATE;
+    for (int p = 0; p < RS8K_PHASES; p++) {
+        double frac = (double)p / RS8K_PHASES;
+        double sum = 0.0;
+        for (int j = 0; j < 2 * RS8K_HALF_TAPS; j++) {
+            /* Tap j reads input q + j - (HALF_TAPS - 1) for output at q + frac */
+            double x = (double)(j - (RS8K_HALF_TAPS - 1)) - frac;
+            double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(M_PI * fc * x) / (M_PI * fc * x);
+            double w = (x + RS8K_HALF_TAPS) / (2.0 * RS8K_HALF_TAPS);
+            double blackman = 0.42 - 0.5 * cos(2.0 * M_PI * w) + 0.08 * cos(4.0 * M_PI * w);
+            double h = fc * sinc * blackman;
+            rs->taps[p][j] = (float)h;
+            sum += h;
+        }
+        for (int j = 0; j < 2 * RS8K_HALF_TAPS; j++) rs->taps[p][j] = (float)(rs->taps[p][j] / sum);
+    }
+    rs->input = NULL;
+    rs->input_count = rs->input_capacity = 0;
+    rs->input_base = 0;
+    rs->next_output = 0;
+}
+
+/*
+ * Append native-rate input and emit every 8 kHz sample it completes into
+ * out (room for count * 160 / 441 + 1). samples NULL appends zeros.
+ * Returns the number of samples written, or -1 on allocation failure.
+ */
+static long resampler_8k_push(Resampler8k* rs, const int16_t* samples, size_t count,
+                              int16_t* out) {
+    if (rs->input_count + count > rs->input_capacity) {
+        size_t cap = rs->input_capacity ? rs->input_capacity : 4096;
+        while (cap < rs->input_count + count) cap *= 2;
+        int16_t* grown = realloc(rs->input, cap * sizeof(int16_t));
+        if (!grown) return -1;
+        rs->input = grown;
+        rs->input_capacity = cap;
+    }
+    if (samples) memcpy(rs->input + rs->input_count, samples, count * sizeof(int16_t));
+    else memset(rs->input + rs->input_count, 0, count * sizeof(int16_t));
+    rs->input_count += count;
+
+    uint64_t input_end = rs->input_base + rs->input_count;
+    long produced = 0;
+    for (;;) {
+        uint64_t pos = rs->next_output * RS8K_STEP;
+        uint64_t q = pos / RS8K_PHASES;
+        if (q + RS8K_HALF_TAPS >= input_end) break;
+        const float* taps = rs->taps[pos % RS8K_PHASES];
+        float acc = 0.0f;
+        for (int j = 0; j < 2 * RS8K_HALF_TAPS; j++) {
+            int64_t idx = (int64_t)q + j - (RS8K_HALF_TAPS - 1) - (int64_t)rs->input_base;
+            if (idx >= 0) acc += taps[j] * rs->input[idx];
+        }
+        long v = lrintf(acc);
+        out[produced++] = (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+        rs->next_output++;
+    }
+
+    /* Keep only the history the next output still reads */
+    uint64_t keep_from = (rs->next_output * RS8K_STEP) / RS8K_PHASES;
+    keep_from = (keep_from >= RS8K_HALF_TAPS - 1) ? keep_from - (RS8K_HALF_TAPS - 1) : 0;
+    if (keep_from > rs->input_base) {
+        size_t drop = (size_t)(keep_from - rs->input_base);
+        if (drop > rs->input_count) drop = rs->input_count;
+        memmove(rs->input, rs->input + drop, (rs->input_count - drop) * sizeof(int16_t));
+        rs->input_count -= drop;
+        rs->input_base += drop;
+    }
+    return produced;
+}
+
+/* G.711 mu-law */
+static uint8_t linear_to_ulaw(int16_t sample) {
+    int pcm = sample;
+    int sign = (pcm < 0) ? 0x80 : 0x00;
+    if (pcm < 0) pcm = -pcm;
+    if (pcm > 32635) pcm = 32635;
+    pcm += 0x84;
+    int exponent = 7;
+    for (int mask = 0x4000; exponent > 0 && !(pcm & mask); mask >>= 1) exponent--;
+    int mantissa = (pcm >> (exponent + 3)) & 0x0F;
+    return (uint8_t)~(sign | (exponent << 4) | mantissa);
+}
+
+static int16_t ulaw_to_linear(uint8_t code) {
+    code = (uint8_t)~code;
+    int t = (((code & 0x0F) << 3) + 0x84) << ((code & 0x70) >> 4);
+    return (int16_t)((code & 0x80) ? 0x84 - t : t - 0x84);
+}
+
+/* Encoded payload bytes, filled by synthesis and drained by the sender */
+typedef struct {
+    uint8_t* data;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    int done;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} RtpQueue;
+
+typedef struct {
+    RtpCodec codec;
+    int sock;
+    const struct sockaddr* dest;
+    socklen_t dest_len;
+    RtpQueue queue;
+    Resampler8k* resampler;     /* PCMU only */
+    int16_t* scratch;           /* Resampler output before encoding */
+    size_t scratch_capacity;
+    uint8_t* encoded;
+    size_t encoded_capacity;
+    int failed;
+
+    uint32_t clock_rate;
+    uint32_t samples_per_packet;
+    size_t payload_bytes;
+    double ptime_ms;
+    double lead_ms;
+    uint16_t seq;
+    uint32_t timestamp;
+    uint32_t ssrc;
+
+    /* Sender report */
+    struct timespec start;
+    double first_packet_ms;     /* From start to the first send */
+    size_t packets;
+    size_t send_errors;
+    size_t late_packets;        /* Sent more than 1 ms after their slot */
+    double max_late_ms;
+    size_t intervals;
+    double interval_dev_sum_ms;
+    double interval_dev_max_ms;
+    double rfc3550_jitter_ms;
+    size_t silence_samples;
+} RtpStream;
+
+static double rtp_ms_between(const struct timespec* a, const struct timespec* b) {
+    return (double)(b->tv_sec - a->tv_sec) * 1000.0 + (double)(b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+/* Queue encoded bytes, waiting while the sender is a full queue behind */
+static void rtp_queue_push(RtpQueue* q, const uint8_t* bytes, size_t count) {
+    pthread_mutex_lock(&q->lock);
+    while (count > 0) {
+        while (q->count == q->capacity) pthread_cond_wait(&q->cond, &q->lock);
+        size_t tail = (q->head + q->count) % q->capacity;
+        size_t n = q->capacity - q->count;
+        if (n > q->capacity - tail) n = q->capacity - tail;
+        if (n > count) n = count;
+        memcpy(q->data + tail, bytes, n);
+        q->count += n;
+        bytes += n;
+        count -= n;
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* Encode native-rate samples (NULL for silence) and queue them */
+static void rtp_stream_encode(RtpStream* rs, const int16_t* samples, size_t count) {
+    if (rs->failed || count == 0) return;
+    const int16_t* pcm = samples;
+    size_t pcm_count = count;
+    if (rs->codec == RTP_CODEC_PCMU) {
+        size_t room = count * RS8K_PHASES / RS8K_STEP + 2;
+        if (room > rs->scratch_capacity) {
+            int16_t* grown = realloc(rs->scratch, room * sizeof(int16_t));
+            if (!grown) { rs->failed = 1; return; }
+            rs->scratch = grown;
+            rs->scratch_capacity = room;
+        }
+        long got = resampler_8k_push(rs->resampler, samples, count, rs->scratch);
+        if (got < 0) { rs->failed = 1; return; }
+        pcm = rs->scratch;
+        pcm_count = (size_t)got;
+    }
+
+    size_t bytes = pcm_count * (rs->codec == RTP_CODEC_PCMU ? 1 : 2);
+    if (bytes > rs->encoded_capacity) {
+        uint8_t* grown = realloc(rs->encoded, bytes);
+        if (!grown) { rs->failed = 1; return; }
+        rs->encoded = grown;
+        rs->encoded_capacity = bytes;
+    }
+    if (rs->codec == RTP_CODEC_PCMU) {
+        for (size_t i = 0; i < pcm_count; i++) rs->encoded[i] = linear_to_ulaw(pcm[i]);
+    } else if (pcm) {
+        for (size_t i = 0; i < pcm_count; i++) {
+            uint16_t v = (uint16_t)pcm[i];
+            rs->encoded[2 * i] = (uint8_t)(v >> 8);
+            rs->encoded[2 * i + 1] = (uint8_t)v;
+        }
+    } else {
+        memset(rs->encoded, 0, bytes);
+    }
+    rtp_queue_push(&rs->queue, rs->encoded, bytes);
+}
+
+static void rtp_session_audio(const int16_t* samples, size_t count, void* user_data) {
+    rtp_stream_encode((RtpStream*)user_data, samples, count);
+}
+
+static void rtp_session_silence(size_t count, void* user_data) {
+    RtpStream* rs = (RtpStream*)user_data;
+    rs->silence_samples += count;
+    rtp_stream_encode(rs, NULL, count);
+}
+
+/* Flush the resampler tail and let the sender drain the queue */
+static void rtp_stream_finish(RtpStream* rs) {
+    if (rs->codec == RTP_CODEC_PCMU) rtp_stream_encode(rs, NULL, RS8K_HALF_TAPS * 3);
+    pthread_mutex_lock(&rs->queue.lock);
+    rs->queue.done = 1;
+    pthread_cond_broadcast(&rs->queue.cond);
+    pthread_mutex_unlock(&rs->queue.lock);
+}
+
+/*
+ * Sender thread. Packet k is due at first + k * ptime - lead, so the first
+ * lead / ptime packets leave back to back and the rest keep that lead. A
+ * packet whose audio is not ready yet goes out late and keeps its
+ * timestamp; the timeline never stretches to hide an underrun.
+ */
+static void* rtp_sender_thread(void* arg) {
+    RtpStream* rs = (RtpStream*)arg;
+    uint8_t packet[RTP_HEADER_SIZE + RTP_MAX_PAYLOAD];
+    uint8_t fill = (rs->codec == RTP_CODEC_PCMU) ? linear_to_ulaw(0) : 0;
+    struct timespec first = {0, 0};
+    struct timespec prev = {0, 0};
+    int64_t lead_ns = (int64_t)(rs->lead_ms * 1e6);
+    int64_t ptime_ns = (int64_t)(rs->ptime_ms * 1e6);
+    size_t lead_packets = (size_t)(rs->lead_ms / rs->ptime_ms);
+
+    for (size_t k = 0;; k++) {
+        /* Wait for a full packet, or whatever is left at the end */
+        RtpQueue* q = &rs->queue;
+        pthread_mutex_lock(&q->lock);
+        while (q->count < rs->payload_bytes && !q->done) pthread_cond_wait(&q->cond, &q->lock);
+        if (q->count == 0) {
+            pthread_mutex_unlock(&q->lock);
+            break;
+        }
+        size_t take = q->count < rs->payload_bytes ? q->count : rs->payload_bytes;
+        for (size_t i = 0; i < take; i++) {
+            packet[RTP_HEADER_SIZE + i] = q->data[(q->head + i) % q->capacity];
+        }
+        q->head = (q->head + take) % q->capacity;
+        q->count -= take;
+        pthread_cond_broadcast(&q->cond);
+        pthread_mutex_unlock(&q->lock);
+        memset(packet + RTP_HEADER_SIZE + take, fill, rs->payload_bytes - take);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (k == 0) {
+            first = now;
+        } else {
+            int64_t due_ns = (int64_t)k * ptime_ns - lead_ns;
+            struct timespec due = first;
+            if (due_ns > 0) {
+                due.tv_sec += (time_t)(due_ns / 1000000000);
+                due.tv_nsec += (long)(due_ns % 1000000000);
+                if (due.tv_nsec >= 1000000000) {
+                    due.tv_sec++;
+                    due.tv_nsec -= 1000000000;
+                }
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {}
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            double late_ms = rtp_ms_between(&due, &now);
+            if (due_ns > 0 && late_ms > 1.0) rs->late_packets++;
+            if (due_ns > 0 && late_ms > rs->max_late_ms) rs->max_late_ms = late_ms;
+        }
+
+        uint32_t ts = rs->timestamp + (uint32_t)(k * rs->samples_per_packet);
+        packet[0] = 0x80;                                   /* V=2, no padding/extension/CSRC */
+        packet[1] = (uint8_t)((k == 0 ? 0x80 : 0x00) |      /* Marker on the first packet */
+                              (rs->codec == RTP_CODEC_PCMU ? RTP_PT_PCMU : RTP_PT_L16));
+        uint16_t seq = (uint16_t)(rs->seq + k);
+        packet[2] = (uint8_t)(seq >> 8);
+        packet[3] = (uint8_t)seq;
+        packet[4] = (uint8_t)(ts >> 24);
+        packet[5] = (uint8_t)(ts >> 16);
+        packet[6] = (uint8_t)(ts >> 8);
+        packet[7] = (uint8_t)ts;
+        packet[8] = (uint8_t)(rs->ssrc >> 24);
+        packet[9] = (uint8_t)(rs->ssrc >> 16);
+        packet[10] = (uint8_t)(rs->ssrc >> 8);
+        packet[11] = (uint8_t)rs->ssrc;
+        if (sendto(rs->sock, packet, RTP_HEADER_SIZE + rs->payload_bytes, 0,
+                   rs->dest, rs->dest_len) < 0) {
+            rs->send_errors++;
+        }
+
+        if (k == 0) {
+            rs->first_packet_ms = rtp_ms_between(&rs->start, &now);
+        } else if (k > lead_packets) {
+            /* Spacing once pacing has taken over from the initial burst */
+            double interval = rtp_ms_between(&prev, &now);
+            double dev = fabs(interval - rs->ptime_ms);
+            rs->intervals++;
+            rs->interval_dev_sum_ms += dev;
+            if (dev > rs->interval_dev_max_ms) rs->interval_dev_max_ms = dev;
+            rs->rfc3550_jitter_ms += (dev - rs->rfc3550_jitter_ms) / 16.0;
+        }
+        prev = now;
+        rs->packets++;
+    }
+    return NULL;
+}
+
+/* Resolve host:port for UDP; 0 on success */
+static int rtp_resolve(const char* host_port, struct sockaddr_storage* addr, socklen_t* len) {
+    char host[256];
+    const char* colon = strrchr(host_port, ':');
+    if (!colon || colon == host_port || (size_t)(colon - host_port) >= sizeof(host)) return -1;
+    memcpy(host, host_port, (size_t)(colon - host_port));
+    host[colon - host_port] = '\0';
+    /* Bracketed IPv6 literal */
+    char* h = host;
+    size_t hl = strlen(h);
+    if (hl >= 2 && h[0] == '[' && h[hl - 1] == ']') {
+        h[hl - 1] = '\0';
+        h++;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* res = NULL;
+    if (getaddrinfo(h, colon + 1, &hints, &res) != 0 || !res) return -1;
+    memcpy(addr, res->ai_addr, res->ai_addrlen);
+    *len = (socklen_t)res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+/*
+ * stream-rtp: synthesize text (or stdin as it arrives) and send it as
+ * paced RTP to dest. Reports time to first packet and send-side jitter.
+ */
+static int stream_rtp(const char* db_path, const char* dest, RtpCodec codec, double ptime_ms,
+                      double lead_ms, float speed, const char* text) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+    if (rtp_resolve(dest, &addr, &addr_len) != 0) {
+        fprintf(stderr, "Cannot resolve destination %s (expected host:port)\n", dest);
+        return CTTS_ERR_INVALID_ARG;
+    }
+
+    RtpStream rs;
+    memset(&rs, 0, sizeof(rs));
+    rs.codec = codec;
+    rs.clock_rate = (codec == RTP_CODEC_PCMU) ? 8000 : CTTS_SAMPLE_RATE;
+    rs.samples_per_packet = (uint32_t)lrint(rs.clock_rate * ptime_ms / 1000.0);
+    rs.payload_bytes = rs.samples_per_packet * (codec == RTP_CODEC_PCMU ? 1 : 2);
+    rs.ptime_ms = 1000.0 * rs.samples_per_packet / rs.clock_rate;
+    rs.lead_ms = lead_ms;
+    if (rs.samples_per_packet == 0 || rs.payload_bytes > RTP_MAX_PAYLOAD) {
+        fprintf(stderr, "ptime %.1f ms does not fit a %d-byte payload\n", ptime_ms,
+                RTP_MAX_PAYLOAD);
+        return CTTS_ERR_INVALID_ARG;
+    }
+
+    /* Random starting sequence number, timestamp and SSRC (RFC 3550 5.1) */
+    struct timespec seed_time;
+    clock_gettime(CLOCK_REALTIME, &seed_time);
+    uint32_t h1 = ctts_hash((const char*)&seed_time, sizeof(seed_time));
+    uint32_t h2 = (h1 * 2654435761u) ^ (uint32_t)getpid();
+    rs.seq = (uint16_t)(h2 >> 16);
+    rs.timestamp = h1;
+    rs.ssrc = (h2 * 2246822519u) ^ (h1 >> 13);
+
+    CTTS* engine = ctts_init(db_path);
+    if (!engine) {
+        fprintf(stderr, "Failed to load database: %s\n", db_path);
+        return CTTS_ERR_FILE_NOT_FOUND;
+    }
+    ctts_load_config(&engine->config, "config.yaml");
+    if (speed <= 0) speed = engine->config.default_speed;
+
+    int err = CTTS_OK;
+    rs.sock = socket(addr.ss_family, SOCK_DGRAM, 0);
+    if (rs.sock < 0) err = CTTS_ERR_FILE_WRITE;
+    rs.dest = (const struct sockaddr*)&addr;
+    rs.dest_len = addr_len;
+    rs.queue.capacity = (size_t)(rs.clock_rate * RTP_QUEUE_SECONDS) *
+                        (codec == RTP_CODEC_PCMU ? 1 : 2);
+    if (err == CTTS_OK && !(rs.queue.data = malloc(rs.queue.capacity))) {
+        err = CTTS_ERR_OUT_OF_MEMORY;
+    }
+    if (err == CTTS_OK && codec == RTP_CODEC_PCMU) {
+        if (!(rs.resampler = malloc(sizeof(Resampler8k)))) err = CTTS_ERR_OUT_OF_MEMORY;
+        else resampler_8k_init(rs.resampler);
+    }
+    if (err != CTTS_OK) {
+        if (rs.sock >= 0) close(rs.sock);
+        free(rs.queue.data);
+        free(rs.resampler);
+        ctts_free(engine);
+        return err;
+    }
+    pthread_mutex_init(&rs.queue.lock, NULL);
+    pthread_cond_init(&rs.queue.cond, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &rs.start);
+    pthread_t sender;
+    int sender_started = pthread_create(&sender, NULL, rtp_sender_thread, &rs) == 0;
+    if (!sender_started) err = CTTS_ERR_OUT_OF_MEMORY;
+
+    CTTSSession* session = NULL;
+    if (err == CTTS_OK) {
+        session = ctts_session_begin(engine, speed, rtp_session_audio, &rs);
+        if (!session) err = CTTS_ERR_OUT_OF_MEMORY;
+    }
+    if (session) {
+        ctts_session_set_silence_callback(session, rtp_session_silence);
+        if (text) {
+            err = ctts_session_feed(session, text);
+        } else {
+            /* Feed whatever arrives; the session waits for complete words */
+            char chunk[4096];
+            ssize_t got;
+            while (err == CTTS_OK && (got = read(STDIN_FILENO, chunk, sizeof(chunk) - 1)) > 0) {
+                chunk[got] = '\0';
+                err = ctts_session_feed(session, chunk);
+            }
+        }
+        int end_err = ctts_session_end(session);
+        if (err == CTTS_OK) err = end_err;
+    }
+    struct timespec synth_done;
+    clock_gettime(CLOCK_MONOTONIC, &synth_done);
+    double synth_ms = rtp_ms_between(&rs.start, &synth_done);
+
+    rtp_stream_finish(&rs);
+    if (sender_started) pthread_join(sender, NULL);
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (err == CTTS_OK && rs.failed) err = CTTS_ERR_OUT_OF_MEMORY;
+
+    if (err == CTTS_OK) {
+        double audio_ms = rs.packets * rs.ptime_ms;
+        printf("Streamed %zu packets to %s (%s, %.0f ms ptime, %u Hz, SSRC %08x)\n",
+               rs.packets, dest, codec == RTP_CODEC_PCMU ? "PCMU" : "L16", rs.ptime_ms,
+               rs.clock_rate, rs.ssrc);
+        printf("  Audio: %.2f s, synthesis done after %.1f ms, stream done after %.1f ms\n",
+               audio_ms / 1000.0, synth_ms, rtp_ms_between(&rs.start, &end));
+        printf("  Time to first packet: %.1f ms (lead %.0f ms)\n", rs.first_packet_ms,
+               rs.lead_ms);
+        printf("  Inter-packet jitter: mean %.3f ms, max %.3f ms, RFC 3550 %.3f ms\n",
+               rs.intervals ? rs.interval_dev_sum_ms / rs.intervals : 0.0,
+               rs.interval_dev_max_ms, rs.rfc3550_jitter_ms);
+        printf("  Late packets (> 1 ms past slot): %zu, worst %.1f ms\n", rs.late_packets,
+               rs.max_late_ms);
+        printf("  Silence carried as runs: %.2f s\n",
+               (double)rs.silence_samples / CTTS_SAMPLE_RATE);
+        if (rs.send_errors) printf("  Send errors: %zu\n", rs.send_errors);
+    }
+
+    pthread_mutex_destroy(&rs.queue.lock);
+    pthread_cond_destroy(&rs.queue.cond);
+    close(rs.sock);
+    free(rs.queue.data);
+    if (rs.resampler) free(rs.resampler->input);
+    free(rs.resampler);
+    free(rs.scratch);
+    free(rs.encoded);
+    ctts_free(engine);
+    return err;
+}
+
+/*
+ * recv-rtp: a local receiver for checking stream-rtp. Decodes PCMU or L16
+ * into a WAV, places each packet by its timestamp (gaps stay silent), and
+ * reports loss, reordering and RFC 3550 interarrival jitter. Stops after
+ * idle_ms without packets once the stream has started.
+ */
+static int recv_rtp(const char* listen_addr, const char* out_path, double idle_ms) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+    if (rtp_resolve(listen_addr, &addr, &addr_len) != 0) {
+        fprintf(stderr, "Cannot resolve %s (expected host:port)\n", listen_addr);
+        return CTTS_ERR_INVALID_ARG;
+    }
+    int sock = socket(addr.ss_family, SOCK_DGRAM, 0);
+    if (sock < 0 || bind(sock, (struct sockaddr*)&addr, addr_len) != 0) {
+        fprintf(stderr, "Failed to bind %s: %s\n", listen_addr, strerror(errno));
+        if (sock >= 0) close(sock);
+        return CTTS_ERR_FILE_NOT_FOUND;
+    }
+    printf("Listening on %s\n", listen_addr);
+    fflush(stdout);
+
+    int16_t* samples = NULL;
+    size_t sample_count = 0;
+    size_t sample_capacity = 0;
+    int err = CTTS_OK;
+    int payload_type = -1;
+    uint32_t clock_rate = 0;
+    uint32_t base_ts = 0;
+    uint16_t max_seq = 0;
+    size_t packets = 0;
+    size_t reordered = 0;
+    size_t late = 0;                /* Timestamp before the first packet's */
+    size_t jumped = 0;              /* Timestamp too far past the audio so far */
+    size_t expected = 0;
+    double jitter = 0.0;            /* RFC 3550 A.8, in timestamp units */
+    double prev_transit = 0.0;
+    struct timespec first_arrival = {0, 0};
+    struct timespec last_arrival = {0, 0};
+    uint8_t packet[65536];
+
+    for (;;) {
+        struct pollfd pfd = {sock, POLLIN, 0};
+        int ready = poll(&pfd, 1, packets ? (int)idle_ms : -1);
+        if (ready <= 0) break;
+        ssize_t got = recv(sock, packet, sizeof(packet), 0);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (got < RTP_HEADER_SIZE || (packet[0] >> 6) != 2) continue;
+
+        int pt = packet[1] & 0x7F;
+        uint16_t seq = (uint16_t)((packet[2] << 8) | packet[3]);
+        uint32_t ts = ((uint32_t)packet[4] << 24) | ((uint32_t)packet[5] << 16) |
+                      ((uint32_t)packet[6] << 8) | packet[7];
+        size_t header = RTP_HEADER_SIZE + 4 * (size_t)(packet[0] & 0x0F);
+        if ((size_t)got < header) continue;
+        const uint8_t* payload = packet + header;
+        size_t payload_len = (size_t)got - header;
+
+        if (payload_type < 0) {
+            if (pt != RTP_PT_PCMU && pt != RTP_PT_L16) continue;
+            payload_type = pt;
+            clock_rate = (pt == RTP_PT_PCMU) ? 8000 : CTTS_SAMPLE_RATE;
+            base_ts = ts;
+            max_seq = (uint16_t)(seq - 1);
+            first_arrival = now;
+        } else if (pt != payload_type) {
+            continue;
+        }
+
+        /*
+         * The timestamp becomes a buffer index, so it is only trusted within
+         * bounds: a reordered packet from before the first one would wrap to
+         * ~4.29e9, and a corrupt one could ask for gigabytes of silence
+         */
+        int32_t rel_ts = (int32_t)(ts - base_ts);
+        size_t n = (payload_type == RTP_PT_PCMU) ? payload_len : payload_len / 2;
+        if (rel_ts < 0) {
+            late++;
+            continue;
+        }
+        size_t offset = (size_t)rel_ts;
+        if (offset + n > sample_count + (size_t)RTP_MAX_JUMP_SECONDS * clock_rate) {
+            jumped++;
+            continue;
+        }
+
+        int16_t delta = (int16_t)(seq - max_seq);
+        if (delta > 0) {
+            expected += (size_t)delta;
+            max_seq = seq;
+        } else {
+            reordered++;
+        }
+
+        /* Transit time in timestamp units; its variation is the jitter */
+        double arrival = rtp_ms_between(&first_arrival, &now) * clock_rate / 1000.0;
+        double transit = arrival - (double)rel_ts;
+        if (packets > 0) {
+            double d = fabs(transit - prev_transit);
+            jitter += (d - jitter) / 16.0;
+        }
+        prev_transit = transit;
+        last_arrival = now;
+        packets++;
+
+        if (offset + n > sample_capacity) {
+            size_t cap = sample_capacity ? sample_capacity : clock_rate;
+            while (cap < offset + n) cap *= 2;
+            int16_t* grown = realloc(samples, cap * sizeof(int16_t));
+            if (!grown) {
+                err = CTTS_ERR_OUT_OF_MEMORY;
+                break;
+            }
+            memset(grown + sample_capacity, 0, (cap - sample_capacity) * sizeof(int16_t));
+            samples = grown;
+            sample_capacity = cap;
+        }
+        for (size_t i = 0; i < n; i++) {
+            samples[offset + i] = (payload_type == RTP_PT_PCMU)
+                ? ulaw_to_linear(payload[i])
+                : (int16_t)((payload[2 * i] << 8) | payload[2 * i + 1]);
+        }
+        if (offset + n > sample_count) sample_count = offset + n;
+    }
+    close(sock);
+
+    if (err == CTTS_OK && packets == 0) err = CTTS_ERR_INVALID_FORMAT;
+    if (err == CTTS_OK) {
+        printf("Received %zu packets (%s, %u Hz), %.2f s of audio over %.1f ms\n", packets,
+               payload_type == RTP_PT_PCMU ? "PCMU" : "L16", clock_rate,
+               (double)sample_count / clock_rate, rtp_ms_between(&first_arrival, &last_arrival));
+        printf("  Lost: %zu, reordered: %zu\n",
+               expected > packets - reordered ? expected - (packets - reordered) : 0, reordered);
+        if (late > 0 || jumped > 0) {
+            printf("  Dropped: %zu before the first packet, %zu more than %d s ahead\n",
+                   late, jumped, RTP_MAX_JUMP_SECONDS);
+        }
+        printf("  Interarrival jitter (RFC 3550): %.3f ms\n", jitter * 1000.0 / clock_rate);
+        err = ctts_write_wav(out_path, samples, sample_count, (int)clock_rate);
+        if (err == CTTS_OK) printf("Written to %s\n", out_path);
+    }
+    free(samples);
+    return err;
+}
+
+/* ============================================================================
+ * Main Program (Command Line Interface)
+ * ============================================================================ */
+
+/* Audio collected from an input session, with time to first audio */
+typedef struct {
+    int16_t* samples;
+    size_t count;
+    size_t capacity;
+    struct timespec start;
+    double first_audio_sec;     /* < 0 until the first callback */
+    size_t silence_count;       /* Samples that arrived as silence runs */
+} CliSessionAudio;
+
+/* Make room for count more samples; 0 on allocation failure */
+static int cli_session_reserve(CliSessionAudio* out, size_t count) {
+    if (out->first_audio_sec < 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        out->first_audio_sec = (double)(now.tv_sec - out->start.tv_sec) +
+                               (double)(now.tv_nsec - out->start.tv_nsec) / 1e9;
+    }
+    if (out->count + count > out->capacity) {
+        size_t cap = out->capacity ? out->capacity : CTTS_SAMPLE_RATE;
+        while (cap < out->count + count) cap *= 2;
+        int16_t* grown = realloc(out->samples, cap * sizeof(int16_t));
+        if (!grown) return 0;
+        out->samples = grown;
+        out->capacity = cap;
+    }
+    return 1;
+}
+
+static void cli_session_audio(const int16_t* samples, size_t count, void* user_data) {
+    CliSessionAudio* out = (CliSessionAudio*)user_data;
+    if (!cli_session_reserve(out, count)) return;
+    memcpy(out->samples + out->count, samples, count * sizeof(int16_t));
+    out->count += count;
+}
+
+static void cli_session_silence(size_t count, void* user_data) {
+    CliSessionAudio* out = (CliSessionAudio*)user_data;
+    if (!cli_session_reserve(out, count)) return;
+    memset(out->samples + out->count, 0, count * sizeof(int16_t));
+    out->count += count;
+    out->silence_count += count;
+}
+
+/* Sealed prompts kept by serve-memfd, reused for repeated texts */
+#define MEMFD_CACHE_SLOTS 64
+
+typedef struct {
+    char* text;
+    int fd;
+    uint64_t sample_count;
+    uint64_t last_used;
+} MemfdCacheEntry;
+
+/* Slot for a new entry: a free one, else the least recently used (closed) */
+static MemfdCacheEntry* memfd_cache_victim(MemfdCacheEntry* cache) {
+    MemfdCacheEntry* victim = &cache[0];
+    for (size_t i = 0; i < MEMFD_CACHE_SLOTS && victim->text; i++) {
+        if (!cache[i].text || cache[i].last_used < victim->last_used) victim = &cache[i];
+    }
+    if (victim->text) {
+        free(victim->text);
+        close(victim->fd);
+        victim->text = NULL;
+    }
+    return victim;
+}
+
+/* serve-memfd --warm: keep each warmed prompt as a sealed memfd */
+typedef struct {
+    MemfdCacheEntry* cache;
+    size_t filled;
+} MemfdWarmFill;
+
+static void memfd_cache_warm(const char* text, uint64_t count, const int16_t* samples,
+                             size_t sample_count, void* user_data) {
+    (void)count;
+    MemfdWarmFill* fill = (MemfdWarmFill*)user_data;
+    if (fill->filled >= MEMFD_CACHE_SLOTS) return;
+
+    int fd;
+    char* key = strdup(text);
+    if (!key || samples_to_memfd(samples, sample_count, &fd) != CTTS_OK) {
+        free(key);
+        return;
+    }
+    MemfdCacheEntry* e = memfd_cache_victim(fill->cache);
+    e->text = key;
+    e->fd = fd;
+    e->sample_count = sample_count;
+    e->last_used = 0;
+    fill->filled++;
+}
+
+/* Return a sealed memfd for text, from the cache or freshly synthesized */
+static int memfd_cache_get(MemfdCacheEntry* cache, uint64_t* clock, CTTS* engine,
+                           const char* text, float speed, int* fd,
+                           uint64_t* sample_count, int* hit) {
+    (*clock)++;
+    for (size_t i = 0; i < MEMFD_CACHE_SLOTS; i++) {
+        MemfdCacheEntry* e = &cache[i];
+        if (e->text && strcmp(e->text, text) == 0) {
+            e->last_used = *clock;
+            *fd = e->fd;
+            *sample_count = e->sample_count;
+            *hit = 1;
+            return CTTS_OK;
+        }
+    }
+
+    *hit = 0;
+    size_t count = 0;
+    int err = ctts_synthesize_to_memfd(engine, text, speed, fd, &count);
+    if (err != CTTS_OK) return err;
+
+    char* key = strdup(text);
+    if (key) {
+        MemfdCacheEntry* victim = memfd_cache_victim(cache);
+        victim->text = key;
+        victim->fd = *fd;
+        victim->sample_count = count;
+        victim->last_used = *clock;
+    }
+    *sample_count = count;
+    return key ? CTTS_OK : CTTS_ERR_OUT_OF_MEMORY;
+}
+
+/* Serve one client: each text line is answered with a CTTSMemfdReply + fd */
+static void serve_memfd_client(int client, MemfdCacheEntry* cache, uint64_t* clock,
+                               CTTS* engine, float speed) {
+    char* pending = NULL;
+    size_t pending_len = 0;
+    char chunk[4096];
+    ssize_t got;
+
+    while ((got = read(client, chunk, sizeof(chunk))) > 0) {
+        char* grown = realloc(pending, pending_len + (size_t)got + 1);
+        if (!grown) break;
+        pending = grown;
+        memcpy(pending + pending_len, chunk, (size_t)got);
+        pending_len += (size_t)got;
+        pending[pending_len] = '\0';
+
+        char* line = pending;
+        char* nl;
+        while ((nl = memchr(line, '\n', pending_len - (size_t)(line - pending))) != NULL) {
+            *nl = '\0';
+            if (nl > line && nl[-1] == '\r') nl[-1] = '\0';
+
+            struct timespec t0;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            CTTSMemfdReply reply = {CTTS_OK, CTTS_SAMPLE_RATE, 0};
+            int fd = -1, hit = 0;
+            reply.status = memfd_cache_get(cache, clock, engine, line, speed,
+                                           &fd, &reply.sample_count, &hit);
+            if (reply.status != CTTS_OK && fd >= 0 && !hit) {
+                close(fd);
+                fd = -1;
+            }
+            int sent = ctts_send_fd(client, reply.status == CTTS_OK ? fd : -1,
+                                    &reply, sizeof(reply));
+            fprintf(stderr, "%s: %llu samples, %s, %.1f ms\n",
+                    reply.status == CTTS_OK ? "ok" : ctts_strerror(reply.status),
+                    (unsigned long long)reply.sample_count, hit ? "cached" : "synthesized",
+                    bench_seconds_since(&t0) * 1000.0);
+            if (sent != CTTS_OK) {
+                free(pending);
+                return;
+            }
+            line = nl + 1;
+        }
+
+        pending_len -= (size_t)(line - pending);
+        memmove(pending, line, pending_len + 1);
+    }
+    free(pending);
+}
+
+/* Print mapped and resident size of a database section */
+static void print_mapped(const char* name, size_t mapped, size_t resident) {
+    printf("  %-10s %10.2f MB mapped %10.2f MB resident (%5.1f%%)\n", name,
+           mapped / (1024.0 * 1024.0), resident / (1024.0 * 1024.0),
+           mapped ? 100.0 * resident / mapped : 0.0);
+}
+
+/* Print a database section with its alignment (largest power of two, up to a page) */
+static void print_section(const char* name, size_t offset, size_t bytes, size_t natural) {
+    size_t align = 4096;
+    while (align > 1 && offset % align != 0) align /= 2;
+    printf("  %-8s offset %10zu  size %12zu  (%8.2f KB)  aligned %4zu%s\n", name, offset,
+           bytes, bytes / 1024.0, align, align < natural ? "  MISALIGNED" : "");
+}
+
+static void print_warm_report(const CTTSWarmReport* r) {
+    printf("Warmed %llu of %llu distinct texts in %.2f s%s\n",
+           (unsigned long long)r->texts_warmed, (unsigned long long)r->distinct_texts,
+           r->elapsed_sec,
+           r->budget_exhausted == CTTS_WARM_BUDGET_TIME ? " (time budget reached)" :
+           r->budget_exhausted == CTTS_WARM_BUDGET_MEMORY ? " (memory budget reached)" : "");
+    printf("  Log coverage: %llu of %llu requests (%.1f%%)\n",
+           (unsigned long long)r->requests_covered, (unsigned long long)r->log_requests,
+           r->log_requests ? 100.0 * r->requests_covered / r->log_requests : 0.0);
+    printf("  Units touched: %u of %u\n", r->units_touched, r->unit_count);
+    printf("  Database resident: %.2f MB -> %.2f MB; warmed memory %.2f MB\n",
+           r->db_resident_before / (1024.0 * 1024.0), r->db_resident_after / (1024.0 * 1024.0),
+           r->memory_used / (1024.0 * 1024.0));
+}
+
+static void print_usage(const char* progname) {
+    fprintf(stderr, "CTTS - Concatenative Text-to-Speech Engine\n\n");
+    fprintf(stderr, "Usage:\n");
+    fprintf(stderr, "  Build database:\n");
+    fprintf(stderr, "    %s build <dataset_dir> <output.db>\n\n", progname);
+    fprintf(stderr, "  Build domain subset (units a corpus needs + letter fallbacks):\n");
+    fprintf(stderr, "    %s build <dataset_dir|database.db> <output.db> --subset-from <corpus.txt>\n\n",
+            progname);
+    fprintf(stderr, "  Pull unit pitch toward the voice median (default tolerance 0.06 = ±6%%):\n");
+    fprintf(stderr, "    %s build <dataset_dir|database.db> <output.db> --flatten-f0 [tolerance]\n\n",
+            progname);
+    fprintf(stderr, "  Generate synthetic test dataset:\n");
+    fprintf(stderr, "    %s make-test-voice <output_dir> --units N [--seed S]\n\n", progname);
+    fprintf(stderr, "  Synthesize speech:\n");
+    fprintf(stderr, "    %s synth <database.db> \"text\" <output.wav> [speed]\n\n", progname);
+    fprintf(stderr, "  Synthesize at speed 1.0 without per-unit DSP, written with writev():\n");
+    fprintf(stderr, "    %s synth-spans <database.db> \"text\" <output.wav>\n\n", progname);
+    fprintf(stderr, "  Synthesize spans of text at different speeds in one pass:\n");
+    fprintf(stderr, "    %s synth-speeds <database.db> <output.wav> <speed> \"text\" [<speed> \"text\" ...]\n\n",
+            progname);
+    fprintf(stderr, "  Synthesize SSML (break, prosody rate, say-as):\n");
+    fprintf(stderr, "    %s synth-ssml <database.db> \"<speak>...</speak>\" <output.wav> [speed]\n\n",
+            progname);
+    fprintf(stderr, "  Synthesize text as it arrives on stdin:\n");
+    fprintf(stderr, "    %s synth-stdin <database.db> <output.wav> [speed] [--ssml]\n\n", progname);
+    fprintf(stderr, "  Serve audio as sealed memfds over a Unix socket (one text per line):\n");
+    fprintf(stderr, "    %s serve-memfd <database.db> <socket_path> [speed] [--slow-ms N] [--slow-log file]\n"
+                    "         [--warm requests.log] [--latency-ms T]\n", progname);
+    fprintf(stderr, "    %s fetch-memfd <socket_path> \"text\" <output.wav>\n\n", progname);
+    fprintf(stderr, "  Stream paced RTP over UDP (text, or stdin as it arrives):\n");
+    fprintf(stderr, "    %s stream-rtp <database.db> --dest host:port [--codec pcmu|l16] [--ptime ms]\n"
+                    "         [--lead-ms ms] [--speed S] [\"text\"]\n", progname);
+    fprintf(stderr, "    %s recv-rtp <host:port> <output.wav> [--idle-ms N]\n\n", progname);
+    fprintf(stderr, "  Memory breakdown after a workload (file with one text per line, or text):\n");
+    fprintf(stderr, "    %s mem <database.db> [workload.txt|\"text\"] [speed]\n\n", progname);
+    fprintf(stderr, "  Inspect database layout and lookup cost:\n");
+    fprintf(stderr, "    %s info <database.db>\n\n", progname);
+    fprintf(stderr, "  Warm caches by replaying the most frequent texts of a request log:\n");
+    fprintf(stderr, "    %s warm <database.db> <requests.log> [--top K] [--threads N] [--speed S]\n"
+                    "         [--time-ms T] [--mem-mb M]\n\n", progname);
+    fprintf(stderr, "  Analyze corpus coverage (no audio):\n");
+    fprintf(stderr, "    %s analyze <database.db> <corpus.txt> [threads] [top_n]\n\n", progname);
+    fprintf(stderr, "  Benchmarks:\n");
+    fprintf(stderr, "    %s bench numbers [megabytes]\n", progname);
+    fprintf(stderr, "    %s bench batch <database.db> <workload.txt> [--batch N] [--speed S]\n",
+            progname);
+    fprintf(stderr, "    %s bench stretch <database.db> <workload.txt>\n", progname);
+    fprintf(stderr, "    %s bench silence <database.db> <workload.txt>\n", progname);
+    fprintf(stderr, "    %s bench pitch <database.db> <workload.txt>\n", progname);
+    fprintf(stderr, "    %s bench load <database.db> <workload.txt> [--target-ms T] [--threads N]\n"
+                    "         [--speed S]\n\n", progname);
+    fprintf(stderr, "  Options:\n");
+    fprintf(stderr, "    speed  - Playback speed (0.5 to 2.0, default 1.0)\n");
+}
+
+int main(int argc, char* argv[]) {
     if (argc < 2) {
         print_usage(argv[0]);
         return 1;
     }
 
-    if (strcmp(argv[1], "build") == 0) {
-        if (argc < 4) {
-            fprintf(stderr, "Usage: %s build <dataset_dir> <output.db>\n", argv[0]);
+    if (strcmp(argv[1], "build") == 0) {
+        const char* subset_corpus = NULL;
+        int flatten = 0;
+        float f0_tolerance = 0.06f;
+        int bad_args = (argc < 4);
+        for (int i = 4; i < argc && !bad_args; i++) {
+            if (strcmp(argv[i], "--subset-from") == 0 && i + 1 < argc) {
+                subset_corpus = argv[++i];
+            } else if (strcmp(argv[i], "--flatten-f0") == 0) {
+                flatten = 1;
+                if (i + 1 < argc && argv[i + 1][0] != '-') f0_tolerance = strtof(argv[++i], NULL);
+            } else {
+                bad_args = 1;
+            }
+        }
+        if (bad_args) {
+            fprintf(stderr, "Usage: %s build <dataset_dir> <output.db> [--subset-from corpus.txt] "
+                    "[--flatten-f0 [tolerance]]\n", argv[0]);
+            fprintf(stderr, "       %s build <database.db> <output.db> [--subset-from corpus.txt] "
+                    "[--flatten-f0 [tolerance]]\n", argv[0]);
+            return 1;
+        }
+
+        struct stat src_st;
+        int from_dataset = (stat(argv[2], &src_st) == 0 && S_ISDIR(src_st.st_mode));
+        if (!from_dataset && !subset_corpus && !flatten) {
+            fprintf(stderr, "%s is not a dataset directory\n", argv[2]);
+            return 1;
+        }
+
+        /*
+         * Each stage writes the output when it is the last one, otherwise an
+         * intermediate file next to it: dataset -> .full -> .subset -> output
+         */
+        char full_db[1024], subset_db[1024];
+        if (!from_dataset) {
+            snprintf(full_db, sizeof(full_db), "%s", argv[2]);
+        } else if (subset_corpus || flatten) {
+            snprintf(full_db, sizeof(full_db), "%s.full", argv[3]);
+        } else {
+            snprintf(full_db, sizeof(full_db), "%s", argv[3]);
+        }
+        if (subset_corpus && flatten) {
+            snprintf(subset_db, sizeof(subset_db), "%s.subset", argv[3]);
+        } else {
+            snprintf(subset_db, sizeof(subset_db), "%s", subset_corpus ? argv[3] : full_db);
+        }
+
+        if (from_dataset) {
+            char letters_dir[1024], letters_index[1024];
+            char syllables_dir[1024], syllables_index[1024];
+
+            snprintf(letters_dir, sizeof(letters_dir), "%s/letters/wavs", argv[2]);
+            snprintf(letters_index, sizeof(letters_index), "%s/letters/letters.txt", argv[2]);
+            snprintf(syllables_dir, sizeof(syllables_dir), "%s/syllables/wavs", argv[2]);
+            snprintf(syllables_index, sizeof(syllables_index), "%s/syllables/sillabes.txt", argv[2]);
+
+            int err = ctts_build_database(letters_dir, letters_index,
+                                          syllables_dir, syllables_index,
+                                          full_db);
+            if (err != CTTS_OK) {
+                fprintf(stderr, "Build failed: %s\n", ctts_strerror(err));
+                return 1;
+            }
+        }
+
+        int status = 0;
+        if (subset_corpus) {
+            CTTSSubsetReport report;
+            int err = ctts_subset_database(full_db, subset_corpus, subset_db, 0, &report);
+            if (from_dataset) unlink(full_db);
+            if (err != CTTS_OK) {
+                fprintf(stderr, "Subset failed: %s\n", ctts_strerror(err));
+                return 1;
+            }
+
+            printf("Subset written to %s\n", subset_db);
+            printf("  Units: %u -> %u (%u selected, %u look-ahead, %u fallback letters)\n",
+                   report.units_before, report.units_after, report.units_selected,
+                   report.units_lookahead, report.units_fallback);
+            printf("  Size: %.2f MB -> %.2f MB (%.1f%% smaller)\n",
+                   report.bytes_before / (1024.0 * 1024.0),
+                   report.bytes_after / (1024.0 * 1024.0),
+                   report.bytes_before ?
+                       100.0 * (1.0 - (double)report.bytes_after / report.bytes_before) : 0.0);
+            printf("  Verified: %llu sentences selected identically, %llu differ\n",
+                   (unsigned long long)(report.sentences_checked - report.selection_mismatches),
+                   (unsigned long long)report.selection_mismatches);
+            printf("  Audio: %llu of %llu sampled sentences identical\n",
+                   (unsigned long long)(report.audio_checked - report.audio_mismatches),
+                   (unsigned long long)report.audio_checked);
+            status = (report.selection_mismatches || report.audio_mismatches) ? 1 : 0;
+        }
+
+        if (flatten) {
+            CTTSFlattenReport report;
+            int err = ctts_flatten_pitch(subset_db, argv[3], f0_tolerance, &report);
+            if (subset_corpus || from_dataset) unlink(subset_db);
+            if (err != CTTS_OK) {
+                fprintf(stderr, "Pitch flattening failed: %s\n", ctts_strerror(err));
+                return 1;
+            }
+
+            printf("Pitch flattened into %s\n", argv[3]);
+            printf("  Voice median F0: %.1f Hz, tolerance ±%.0f%%\n", report.voice_f0_hz,
+                   f0_tolerance * 100.0f);
+            printf("  Units: %u (%u voiced), %u shifted by up to %.1f%%\n", report.units,
+                   report.units_voiced, report.units_shifted, report.max_shift * 100.0f);
+            printf("  Outside tolerance: %u before, %u after\n", report.outside_before,
+                   report.outside_after);
+        }
+
+        return status;
+
+    } else if (strcmp(argv[1], "make-test-voice") == 0) {
+        size_t units = 0;
+        uint32_t seed = 1;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "--units") == 0) {
+                units = (size_t)strtoull(argv[i + 1], NULL, 10);
+            } else if (strcmp(argv[i], "--seed") == 0) {
+                seed = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+            }
+        }
+        if (argc < 5 || units == 0) {
+            fprintf(stderr, "Usage: %s make-test-voice <output_dir> --units N [--seed S]\n",
+                    argv[0]);
+            return 1;
+        }
+
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int err = ctts_make_test_voice(argv[2], units, seed);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Failed to generate test voice: %s\n", ctts_strerror(err));
+            return 1;
+        }
+        printf("Generated %zu syllable units in %s (%.1f s)\n", units, argv[2],
+               (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9);
+        printf("Build with: %s build %s <output.db>\n", argv[0], argv[2]);
+        return 0;
+
+    } else if (strcmp(argv[1], "synth") == 0) {
+        if (argc < 5) {
+            fprintf(stderr, "Usage: %s synth <database.db> \"text\" <output.wav> [speed]\n", argv[0]);
+            return 1;
+        }
+
+        float speed = 1.0f;
+        if (argc > 5) {
+            speed = strtof(argv[5], NULL);
+            if (speed < CTTS_MIN_SPEED) speed = CTTS_MIN_SPEED;
+            if (speed > CTTS_MAX_SPEED) speed = CTTS_MAX_SPEED;
+        }
+
+        CTTS* engine = ctts_init(argv[2]);
+        if (!engine) {
+            fprintf(stderr, "Failed to load database: %s\n", argv[2]);
+            return 1;
+        }
+
+        /* Load config from config.yaml if present */
+        ctts_load_config(&engine->config, "config.yaml");
+
+        /* Override speed from config if not specified on command line */
+        if (argc <= 5 && engine->config.default_speed != 1.0f) {
+            speed = engine->config.default_speed;
+        }
+
+        printf("Loaded database with %u units\n", engine->header.unit_count);
+        printf("Config: crossfade=%.1fms (vowel=%.1fms, v2c=%.0f%%), word_pause=%.1fms\n",
+               engine->config.crossfade_ms, engine->config.crossfade_vowel_ms,
+               engine->config.vowel_to_consonant_factor * 100,
+               engine->config.word_pause_ms);
+
+        int16_t* samples;
+        size_t sample_count;
+        int err = ctts_synthesize(engine, argv[3], &samples, &sample_count, speed);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Synthesis failed: %s\n", ctts_strerror(err));
+            ctts_free(engine);
+            return 1;
+        }
+
+        printf("Synthesized %zu samples (%.2f seconds)\n",
+               sample_count, (float)sample_count / CTTS_SAMPLE_RATE);
+        printf("Units found: %u, missing: %u\n",
+               engine->units_found, engine->units_missing);
+
+        err = ctts_write_wav(argv[4], samples, sample_count, CTTS_SAMPLE_RATE);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Failed to write WAV: %s\n", ctts_strerror(err));
+            ctts_free_samples(samples);
+            ctts_free(engine);
+            return 1;
+        }
+
+        printf("Written to %s\n", argv[4]);
+
+        ctts_free_samples(samples);
+        ctts_free(engine);
+        return 0;
+
+    } else if (strcmp(argv[1], "synth-spans") == 0) {
+        if (argc < 5) {
+            fprintf(stderr, "Usage: %s synth-spans <database.db> \"text\" <output.wav>\n", argv[0]);
+            return 1;
+        }
+
+        CTTS* engine = ctts_init(argv[2]);
+        if (!engine) {
+            fprintf(stderr, "Failed to load database: %s\n", argv[2]);
+            return 1;
+        }
+        ctts_load_config(&engine->config, "config.yaml");
+
+        CTTSSpanList spans;
+        int err = ctts_synthesize_spans(engine, argv[3], &spans);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Synthesis failed: %s\n", ctts_strerror(err));
+            ctts_free(engine);
+            return 1;
+        }
+
+        size_t total = spans.sample_count ? spans.sample_count : 1;
+        printf("Synthesized %zu samples (%.2f seconds) in %zu spans\n",
+               spans.sample_count, (float)spans.sample_count / CTTS_SAMPLE_RATE,
+               spans.span_count);
+        printf("  Database references: %zu samples (%.1f%%)\n", spans.referenced_samples,
+               100.0 * spans.referenced_samples / total);
+        printf("  Computed (joins, fades): %zu samples (%.1f%%)\n", spans.owned_samples,
+               100.0 * spans.owned_samples / total);
+        printf("  Silence: %zu samples (%.1f%%)\n", spans.silence_samples,
+               100.0 * spans.silence_samples / total);
+
+        int fd = open(argv[4], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        err = (fd < 0) ? CTTS_ERR_FILE_WRITE : ctts_write_wav_spans(fd, &spans, CTTS_SAMPLE_RATE);
+        if (fd >= 0 && close(fd) != 0 && err == CTTS_OK) err = CTTS_ERR_FILE_WRITE;
+        ctts_free_spans(&spans);
+        ctts_free(engine);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Failed to write WAV: %s\n", ctts_strerror(err));
+            return 1;
+        }
+        printf("Written to %s\n", argv[4]);
+        return 0;
+
+    } else if (strcmp(argv[1], "synth-speeds") == 0) {
+        if (argc < 6 || (argc - 4) % 2 != 0) {
+            fprintf(stderr, "Usage: %s synth-speeds <database.db> <output.wav> <speed> \"text\" "
+                    "[<speed> \"text\" ...]\n", argv[0]);
             return 1;
         }
 
-        char letters_dir[1024], letters_index[1024];
-        char syllables_dir[1024], syllables_index[1024];
+        CTTS* engine = ctts_init(argv[2]);
+        if (!engine) {
+            fprintf(stderr, "Failed to load database: %s\n", argv[2]);
+            return 1;
+        }
+        ctts_load_config(&engine->config, "config.yaml");
 
-        snprintf(letters_dir, sizeof(letters_dir), "%s/letters/wavs", argv[2]);
-        snprintf(letters_index, sizeof(letters_index), "%s/letters/letters.txt", argv[2]);
-        snprintf(syllables_dir, sizeof(syllables_dir), "%s/syllables/wavs", argv[2]);
-        snprintf(syllables_index, sizeof(syllables_index), "%s/syllables/sillabes.txt", argv[2]);
+        size_t span_count = (size_t)(argc - 4) / 2;
+        CTTSSpeedSpan* spans = malloc(span_count * sizeof(CTTSSpeedSpan));
+        if (!spans) {
+            ctts_free(engine);
+            return 1;
+        }
+        for (size_t i = 0; i < span_count; i++) {
+            spans[i].speed = strtof(argv[4 + 2 * i], NULL);
+            spans[i].text = argv[5 + 2 * i];
+        }
 
-        int err = ctts_build_database(letters_dir, letters_index,
-                                      syllables_dir, syllables_index,
-                                      argv[3]);
+        int16_t* samples;
+        size_t sample_count;
+        int err = ctts_synthesize_speeds(engine, spans, span_count, &samples, &sample_count);
+        free(spans);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Synthesis failed: %s\n", ctts_strerror(err));
+            ctts_free(engine);
+            return 1;
+        }
+        printf("Synthesized %zu samples (%.2f seconds) from %zu spans\n", sample_count,
+               (float)sample_count / CTTS_SAMPLE_RATE, span_count);
+        err = ctts_write_wav(argv[3], samples, sample_count, CTTS_SAMPLE_RATE);
+        ctts_free_samples(samples);
+        ctts_free(engine);
         if (err != CTTS_OK) {
-            fprintf(stderr, "Build failed: %s\n", ctts_strerror(err));
+            fprintf(stderr, "Failed to write WAV: %s\n", ctts_strerror(err));
             return 1;
         }
+        printf("Written to %s\n", argv[3]);
         return 0;
 
-    } else if (strcmp(argv[1], "synth") == 0) {
+    } else if (strcmp(argv[1], "synth-ssml") == 0) {
         if (argc < 5) {
-            fprintf(stderr, "Usage: %s synth <database.db> \"text\" <output.wav> [speed]\n", argv[0]);
+            fprintf(stderr, "Usage: %s synth-ssml <database.db> \"<speak>...</speak>\" <output.wav> "
+                    "[speed]\n", argv[0]);
             return 1;
         }
 
-        float speed = 1.0f;
-        if (argc > 5) {
-            speed = strtof(argv[5], NULL);
-            if (speed < CTTS_MIN_SPEED) speed = CTTS_MIN_SPEED;
-            if (speed > CTTS_MAX_SPEED) speed = CTTS_MAX_SPEED;
+        CTTS* engine = ctts_init(argv[2]);
+        if (!engine) {
+            fprintf(stderr, "Failed to load database: %s\n", argv[2]);
+            return 1;
+        }
+        ctts_load_config(&engine->config, "config.yaml");
+        float speed = (argc > 5) ? strtof(argv[5], NULL) : 1.0f;
+
+        int16_t* samples;
+        size_t sample_count;
+        int err = ctts_synthesize_ssml(engine, argv[3], &samples, &sample_count, speed);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Synthesis failed: %s\n", ctts_strerror(err));
+            ctts_free(engine);
+            return 1;
+        }
+        printf("Synthesized %zu samples (%.2f seconds)\n", sample_count,
+               (float)sample_count / CTTS_SAMPLE_RATE);
+        err = ctts_write_wav(argv[4], samples, sample_count, CTTS_SAMPLE_RATE);
+        ctts_free_samples(samples);
+        ctts_free(engine);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Failed to write WAV: %s\n", ctts_strerror(err));
+            return 1;
+        }
+        printf("Written to %s\n", argv[4]);
+        return 0;
+
+    } else if (strcmp(argv[1], "synth-stdin") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "Usage: %s synth-stdin <database.db> <output.wav> [speed] [--ssml]\n",
+                    argv[0]);
+            return 1;
         }
+        int ssml = (strcmp(argv[argc - 1], "--ssml") == 0);
+        if (ssml) argc--;
 
         CTTS* engine = ctts_init(argv[2]);
         if (!engine) {
             fprintf(stderr, "Failed to load database: %s\n", argv[2]);
             return 1;
         }
-
-        /* Load config from config.yaml if present */
         ctts_load_config(&engine->config, "config.yaml");
+        float speed = (argc > 4) ? strtof(argv[4], NULL) : engine->config.default_speed;
 
-        /* Override speed from config if not specified on command line */
-        if (argc <= 5 && engine->config.default_speed != 1.0f) {
-            speed = engine->config.default_speed;
+        CliSessionAudio audio = {NULL, 0, 0, {0, 0}, -1.0, 0};
+        clock_gettime(CLOCK_MONOTONIC, &audio.start);
+        CTTSSession* session = ctts_session_begin(engine, speed, cli_session_audio, &audio);
+        if (!session) {
+            fprintf(stderr, "Failed to start session\n");
+            ctts_free(engine);
+            return 1;
+        }
+        ctts_session_set_silence_callback(session, cli_session_silence);
+
+        /* Feed whatever arrives; the session waits for complete words */
+        char chunk[4096];
+        ssize_t got;
+        int err = CTTS_OK;
+        while (err == CTTS_OK && (got = read(STDIN_FILENO, chunk, sizeof(chunk) - 1)) > 0) {
+            chunk[got] = '\0';
+            err = ssml ? ctts_session_feed_ssml(session, chunk) : ctts_session_feed(session, chunk);
+        }
+        int end_err = ctts_session_end(session);
+        if (err == CTTS_OK) err = end_err;
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Synthesis failed: %s\n", ctts_strerror(err));
+            free(audio.samples);
+            ctts_free(engine);
+            return 1;
         }
 
-        printf("Loaded database with %u units\n", engine->header.unit_count);
-        printf("Config: crossfade=%.1fms (vowel=%.1fms, v2c=%.0f%%), word_pause=%.1fms\n",
-               engine->config.crossfade_ms, engine->config.crossfade_vowel_ms,
-               engine->config.vowel_to_consonant_factor * 100,
-               engine->config.word_pause_ms);
+        printf("Synthesized %zu samples (%.2f seconds), first audio after %.1f ms\n",
+               audio.count, (float)audio.count / CTTS_SAMPLE_RATE,
+               audio.first_audio_sec * 1000.0);
+        printf("Silence carried as runs: %zu samples (%.1f%%)\n", audio.silence_count,
+               audio.count ? 100.0 * audio.silence_count / audio.count : 0.0);
+        err = ctts_write_wav(argv[3], audio.samples, audio.count, CTTS_SAMPLE_RATE);
+        free(audio.samples);
+        ctts_free(engine);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Failed to write WAV: %s\n", ctts_strerror(err));
+            return 1;
+        }
+        printf("Written to %s\n", argv[3]);
+        return 0;
 
-        int16_t* samples;
-        size_t sample_count;
-        int err = ctts_synthesize(engine, argv[3], &samples, &sample_count, speed);
+    } else if (strcmp(argv[1], "serve-memfd") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "Usage: %s serve-memfd <database.db> <socket_path> [speed] "
+                    "[--slow-ms N] [--slow-log file] [--warm requests.log] [--latency-ms T]\n",
+                    argv[0]);
+            return 1;
+        }
+
+        CTTS* engine = ctts_init(argv[2]);
+        if (!engine) {
+            fprintf(stderr, "Failed to load database: %s\n", argv[2]);
+            return 1;
+        }
+        ctts_load_config(&engine->config, "config.yaml");
+        float speed = engine->config.default_speed;
+        double slow_ms = -1.0;
+        const char* slow_log = "ctts-slow.log";
+        const char* warm_log = NULL;
+        double latency_ms = 0.0;
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--warm") == 0 && i + 1 < argc) {
+                warm_log = argv[++i];
+            } else if (strcmp(argv[i], "--latency-ms") == 0 && i + 1 < argc) {
+                latency_ms = strtod(argv[++i], NULL);
+            } else if (strcmp(argv[i], "--slow-ms") == 0 && i + 1 < argc) {
+                slow_ms = strtod(argv[++i], NULL);
+            } else if (strcmp(argv[i], "--slow-log") == 0 && i + 1 < argc) {
+                slow_log = argv[++i];
+            } else {
+                speed = strtof(argv[i], NULL);
+            }
+        }
+
+        /* Probe support before binding the socket */
+        int probe_fd = -1;
+        int err = ctts_synthesize_to_memfd(engine, "", speed, &probe_fd, NULL);
         if (err != CTTS_OK) {
-            fprintf(stderr, "Synthesis failed: %s\n", ctts_strerror(err));
+            fprintf(stderr, "memfd handoff unavailable: %s\n", ctts_strerror(err));
             ctts_free(engine);
             return 1;
         }
+        close(probe_fd);
 
-        printf("Synthesized %zu samples (%.2f seconds)\n",
-               sample_count, (float)sample_count / CTTS_SAMPLE_RATE);
-        printf("Units found: %u, missing: %u\n",
-               engine->units_found, engine->units_missing);
+        /* Slow requests go to a ring, dumped to slow_log on SIGUSR1 */
+        if (slow_ms >= 0 && (ctts_flight_recorder_enable(256, slow_ms) != CTTS_OK ||
+                             ctts_flight_recorder_install_signal(slow_log) != CTTS_OK)) {
+            fprintf(stderr, "Failed to enable flight recorder\n");
+            ctts_free(engine);
+            return 1;
+        }
 
-        err = ctts_write_wav(argv[4], samples, sample_count, CTTS_SAMPLE_RATE);
+        /* Give up quality stages when requests start missing the target */
+        if (latency_ms > 0) ctts_load_control_enable(latency_ms);
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(argv[3]) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", argv[3]);
+            ctts_free(engine);
+            return 1;
+        }
+        strcpy(addr.sun_path, argv[3]);
+        unlink(argv[3]);
+
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+            listen(listener, 16) != 0) {
+            fprintf(stderr, "Failed to listen on %s: %s\n", argv[3], strerror(errno));
+            if (listener >= 0) close(listener);
+            ctts_free(engine);
+            return 1;
+        }
+        printf("Serving %s on %s (speed %.2f)\n", argv[2], argv[3], speed);
+        fflush(stdout);
+
+        MemfdCacheEntry cache[MEMFD_CACHE_SLOTS];
+        memset(cache, 0, sizeof(cache));
+        uint64_t clock = 0;
+
+        /* Prefill the prompt cache with the most frequent past requests */
+        if (warm_log) {
+            MemfdWarmFill fill = {cache, 0};
+            CTTSWarmOptions warm;
+            memset(&warm, 0, sizeof(warm));
+            warm.top_k = MEMFD_CACHE_SLOTS;
+            warm.speed = speed;
+            warm.callback = memfd_cache_warm;
+            warm.user_data = &fill;
+            CTTSWarmReport report;
+            err = ctts_warm_from_log(engine, warm_log, &warm, &report);
+            if (err != CTTS_OK) {
+                fprintf(stderr, "Warming from %s failed: %s\n", warm_log, ctts_strerror(err));
+            } else {
+                print_warm_report(&report);
+                fflush(stdout);
+            }
+        }
+        for (;;) {
+            int client = accept(listener, NULL, NULL);
+            if (client < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            serve_memfd_client(client, cache, &clock, engine, speed);
+            close(client);
+        }
+
+        for (size_t i = 0; i < MEMFD_CACHE_SLOTS; i++) {
+            if (cache[i].text) {
+                free(cache[i].text);
+                close(cache[i].fd);
+            }
+        }
+        close(listener);
+        unlink(argv[3]);
+        ctts_free(engine);
+        return 1;
+
+    } else if (strcmp(argv[1], "fetch-memfd") == 0) {
+        if (argc < 5) {
+            fprintf(stderr, "Usage: %s fetch-memfd <socket_path> \"text\" <output.wav>\n", argv[0]);
+            return 1;
+        }
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, argv[2], sizeof(addr.sun_path) - 1);
+        int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock < 0 || connect(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "Failed to connect to %s: %s\n", argv[2], strerror(errno));
+            if (sock >= 0) close(sock);
+            return 1;
+        }
+
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        size_t text_len = strlen(argv[3]);
+        CTTSMemfdReply reply;
+        int fd = -1;
+        int err = (write(sock, argv[3], text_len) == (ssize_t)text_len &&
+                   write(sock, "\n", 1) == 1) ? CTTS_OK : CTTS_ERR_FILE_WRITE;
+        if (err == CTTS_OK) err = ctts_recv_fd(sock, &fd, &reply, sizeof(reply));
+        if (err == CTTS_OK) err = reply.status;
+        if (err == CTTS_OK && fd < 0) err = CTTS_ERR_INVALID_FORMAT;
+        double elapsed = bench_seconds_since(&t0);
+        close(sock);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Request failed: %s\n", ctts_strerror(err));
+            if (fd >= 0) close(fd);
+            return 1;
+        }
+
+        /* The audio is read straight from the sender's pages */
+        const uint8_t* map;
+        size_t size;
+        err = ctts_map_memfd(fd, reply.sample_count, &map, &size);
+        close(fd);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Failed to map audio: %s\n", ctts_strerror(err));
+            return 1;
+        }
+        printf("Received %llu samples (%.2f seconds) in %.1f ms\n",
+               (unsigned long long)reply.sample_count,
+               (double)reply.sample_count / reply.sample_rate, elapsed * 1000.0);
+
+        err = ctts_write_wav(argv[4], (const int16_t*)(map + CTTS_WAV_HEADER_SIZE),
+                             (size_t)reply.sample_count, (int)reply.sample_rate);
+        munmap((void*)map, size);
         if (err != CTTS_OK) {
             fprintf(stderr, "Failed to write WAV: %s\n", ctts_strerror(err));
-            ctts_free_samples(samples);
+            return 1;
+        }
+        printf("Written to %s\n", argv[4]);
+        return 0;
+
+    } else if (strcmp(argv[1], "stream-rtp") == 0) {
+        const char* dest = NULL;
+        const char* text = NULL;
+        RtpCodec codec = RTP_CODEC_PCMU;
+        double ptime_ms = 20.0;
+        double lead_ms = 40.0;
+        float speed = 0.0f;
+        int bad = argc < 3;
+        for (int i = 3; i < argc && !bad; i++) {
+            if (strcmp(argv[i], "--dest") == 0 && i + 1 < argc) {
+                dest = argv[++i];
+            } else if (strcmp(argv[i], "--codec") == 0 && i + 1 < argc) {
+                i++;
+                if (strcmp(argv[i], "pcmu") == 0) codec = RTP_CODEC_PCMU;
+                else if (strcmp(argv[i], "l16") == 0) codec = RTP_CODEC_L16;
+                else bad = 1;
+            } else if (strcmp(argv[i], "--ptime") == 0 && i + 1 < argc) {
+                ptime_ms = strtod(argv[++i], NULL);
+            } else if (strcmp(argv[i], "--lead-ms") == 0 && i + 1 < argc) {
+                lead_ms = strtod(argv[++i], NULL);
+            } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+                speed = strtof(argv[++i], NULL);
+            } else if (!text && argv[i][0] != '-') {
+                text = argv[i];
+            } else {
+                bad = 1;
+            }
+        }
+        if (bad || !dest || ptime_ms <= 0 || lead_ms < 0) {
+            fprintf(stderr, "Usage: %s stream-rtp <database.db> --dest host:port [--codec pcmu|l16] "
+                    "[--ptime ms] [--lead-ms ms] [--speed S] [\"text\"]\n", argv[0]);
+            fprintf(stderr, "       Without text, synthesizes stdin as it arrives\n");
+            return 1;
+        }
+        int err = stream_rtp(argv[2], dest, codec, ptime_ms, lead_ms, speed, text);
+        if (err != CTTS_OK) fprintf(stderr, "Streaming failed: %s\n", ctts_strerror(err));
+        return err == CTTS_OK ? 0 : 1;
+
+    } else if (strcmp(argv[1], "recv-rtp") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "Usage: %s recv-rtp <host:port> <output.wav> [--idle-ms N]\n", argv[0]);
+            return 1;
+        }
+        double idle_ms = 1000.0;
+        if (argc >= 6 && strcmp(argv[4], "--idle-ms") == 0) idle_ms = strtod(argv[5], NULL);
+        if (idle_ms <= 0) idle_ms = 1000.0;
+        int err = recv_rtp(argv[2], argv[3], idle_ms);
+        if (err != CTTS_OK) fprintf(stderr, "Receive failed: %s\n", ctts_strerror(err));
+        return err == CTTS_OK ? 0 : 1;
+
+    } else if (strcmp(argv[1], "bench") == 0) {
+        if (argc >= 3 && strcmp(argv[2], "numbers") == 0) {
+            double mb = (argc > 3) ? strtod(argv[3], NULL) : 16.0;
+            if (mb <= 0) mb = 16.0;
+            return bench_numbers(mb) == CTTS_OK ? 0 : 1;
+        }
+        if (argc >= 5 && strcmp(argv[2], "load") == 0) {
+            double target_ms = 500.0;
+            int threads = 4;
+            float speed = 1.0f;
+            for (int i = 5; i + 1 < argc; i += 2) {
+                if (strcmp(argv[i], "--target-ms") == 0) target_ms = strtod(argv[i + 1], NULL);
+                else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[i + 1]);
+                else if (strcmp(argv[i], "--speed") == 0) speed = strtof(argv[i + 1], NULL);
+            }
+            if (threads < 1) threads = 1;
+            if (target_ms <= 0) target_ms = 500.0;
+            int err = bench_load(argv[3], argv[4], target_ms, threads, speed);
+            if (err != CTTS_OK) fprintf(stderr, "Load benchmark failed: %s\n", ctts_strerror(err));
+            return err == CTTS_OK ? 0 : 1;
+        }
+        if (argc >= 5 && strcmp(argv[2], "stretch") == 0) {
+            int err = bench_stretch(argv[3], argv[4]);
+            if (err != CTTS_OK) fprintf(stderr, "Stretch benchmark failed: %s\n", ctts_strerror(err));
+            return err == CTTS_OK ? 0 : 1;
+        }
+        if (argc >= 5 && strcmp(argv[2], "silence") == 0) {
+            int err = bench_silence(argv[3], argv[4]);
+            if (err != CTTS_OK) fprintf(stderr, "Silence benchmark failed: %s\n", ctts_strerror(err));
+            return err == CTTS_OK ? 0 : 1;
+        }
+        if (argc >= 5 && strcmp(argv[2], "pitch") == 0) {
+            int err = bench_pitch(argv[3], argv[4]);
+            if (err != CTTS_OK) fprintf(stderr, "Pitch benchmark failed: %s\n", ctts_strerror(err));
+            return err == CTTS_OK ? 0 : 1;
+        }
+        if (argc >= 5 && strcmp(argv[2], "batch") == 0) {
+            size_t batch_size = 64;
+            float speed = 1.0f;
+            for (int i = 5; i + 1 < argc; i += 2) {
+                if (strcmp(argv[i], "--batch") == 0) batch_size = (size_t)atol(argv[i + 1]);
+                else if (strcmp(argv[i], "--speed") == 0) speed = strtof(argv[i + 1], NULL);
+            }
+            if (batch_size < 1) batch_size = 1;
+            int err = bench_batch(argv[3], argv[4], batch_size, speed);
+            if (err != CTTS_OK) fprintf(stderr, "Batch benchmark failed: %s\n", ctts_strerror(err));
+            return err == CTTS_OK ? 0 : 1;
+        }
+        fprintf(stderr, "Usage: %s bench numbers [megabytes]\n", argv[0]);
+        fprintf(stderr, "       %s bench batch <database.db> <workload.txt> [--batch N] [--speed S]\n",
+                argv[0]);
+        fprintf(stderr, "       %s bench stretch <database.db> <workload.txt>\n", argv[0]);
+        fprintf(stderr, "       %s bench silence <database.db> <workload.txt>\n", argv[0]);
+        fprintf(stderr, "       %s bench pitch <database.db> <workload.txt>\n", argv[0]);
+        fprintf(stderr, "       %s bench load <database.db> <workload.txt> [--target-ms T] "
+                "[--threads N] [--speed S]\n", argv[0]);
+        return 1;
+
+    } else if (strcmp(argv[1], "warm") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "Usage: %s warm <database.db> <requests.log> [--top K] [--threads N] "
+                    "[--speed S] [--time-ms T] [--mem-mb M]\n", argv[0]);
+            return 1;
+        }
+
+        CTTS* engine = ctts_init(argv[2]);
+        if (!engine) {
+            fprintf(stderr, "Failed to load database: %s\n", argv[2]);
+            return 1;
+        }
+        ctts_load_config(&engine->config, "config.yaml");
+
+        CTTSWarmOptions warm;
+        memset(&warm, 0, sizeof(warm));
+        warm.speed = engine->config.default_speed;
+        for (int i = 4; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "--top") == 0) {
+                warm.top_k = (size_t)strtoull(argv[i + 1], NULL, 10);
+            } else if (strcmp(argv[i], "--threads") == 0) {
+                warm.num_threads = atoi(argv[i + 1]);
+            } else if (strcmp(argv[i], "--speed") == 0) {
+                warm.speed = strtof(argv[i + 1], NULL);
+            } else if (strcmp(argv[i], "--time-ms") == 0) {
+                warm.time_budget_ms = strtod(argv[i + 1], NULL);
+            } else if (strcmp(argv[i], "--mem-mb") == 0) {
+                warm.memory_budget_bytes = (size_t)(strtod(argv[i + 1], NULL) * 1024.0 * 1024.0);
+            }
+        }
+
+        CTTSWarmReport report;
+        int err = ctts_warm_from_log(engine, argv[3], &warm, &report);
+        ctts_free(engine);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Warming failed: %s\n", ctts_strerror(err));
+            return 1;
+        }
+        print_warm_report(&report);
+        return 0;
+
+    } else if (strcmp(argv[1], "mem") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s mem <database.db> [workload.txt|\"text\"] [speed]\n", argv[0]);
+            return 1;
+        }
+
+        CTTS* engine = ctts_init(argv[2]);
+        if (!engine) {
+            fprintf(stderr, "Failed to load database: %s\n", argv[2]);
+            return 1;
+        }
+        ctts_load_config(&engine->config, "config.yaml");
+        float speed = (argc > 4) ? strtof(argv[4], NULL) : engine->config.default_speed;
+
+        /* Workload: each line of a file, or the argument itself */
+        size_t requests = 0, peak_buffer = 0, peak_stretch = 0;
+        FILE* workload = (argc > 3) ? fopen(argv[3], "r") : NULL;
+        char* line = NULL;
+        size_t line_cap = 0;
+        const char* text = (argc > 3 && !workload) ? argv[3] : NULL;
+        while (text || (workload && getline(&line, &line_cap, workload) != -1)) {
+            if (!text) text = line;
+            int16_t* samples;
+            size_t sample_count;
+            if (ctts_synthesize(engine, text, &samples, &sample_count, speed) == CTTS_OK) {
+                ctts_free_samples(samples);
+                requests++;
+                if (engine->peak_buffer_bytes > peak_buffer) peak_buffer = engine->peak_buffer_bytes;
+                if (engine->peak_stretch_bytes > peak_stretch) peak_stretch = engine->peak_stretch_bytes;
+            }
+            if (text != line) break;
+            text = NULL;
+        }
+        free(line);
+        if (workload) fclose(workload);
+
+        CTTSMemoryReport r;
+        ctts_memory_report(engine, &r);
+        const double kb = 1024.0;
+
+        printf("Memory after %zu requests at speed %.2f\n\n", requests, speed);
+        printf("Voice database %s:\n", argv[2]);
+        print_mapped("total", r.db_mapped_bytes, r.db_resident_bytes);
+        print_mapped("index", r.index_mapped_bytes, r.index_resident_bytes);
+        print_mapped("strings", r.strings_mapped_bytes, r.strings_resident_bytes);
+        print_mapped("audio", r.audio_mapped_bytes, r.audio_resident_bytes);
+
+        printf("\nText frontend:\n");
+        printf("  regex rules    %8zu rules %10.1f KB\n", r.regex_rule_count, r.regex_bytes / kb);
+        printf("  lexicon        %8zu words %10.1f KB\n", r.lexicon_entries, r.lexicon_bytes / kb);
+        printf("  number words   %25.1f KB\n", r.number_cache_bytes / kb);
+
+        printf("\nTables:\n");
+        printf("  LUTs           %25.1f KB\n", r.lut_bytes / kb);
+        printf("  flight ring    %25.1f KB\n", r.flight_recorder_bytes / kb);
+
+        printf("\nPer request (peak over workload):\n");
+        printf("  engine         %25.1f KB\n", r.engine_bytes / kb);
+        printf("  render buffer  %25.1f KB\n", peak_buffer / kb);
+        printf("  time stretch   %25.1f KB\n", peak_stretch / kb);
+
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            printf("\nProcess peak RSS: %.1f MB\n", usage.ru_maxrss / 1024.0);
+        }
+
+        ctts_free(engine);
+        return 0;
+
+    } else if (strcmp(argv[1], "info") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s info <database.db>\n", argv[0]);
+            return 1;
+        }
+
+        CTTS* engine = ctts_init(argv[2]);
+        if (!engine) {
+            fprintf(stderr, "Failed to load database: %s\n", argv[2]);
+            return 1;
+        }
+
+        CTTSDatabaseInfo info;
+        int err = ctts_database_info(engine, &info);
+        ctts_free(engine);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Inspection failed: %s\n", ctts_strerror(err));
+            return 1;
+        }
+
+        printf("Database %s: %zu bytes, %u units\n\n", argv[2], info.file_bytes, info.unit_count);
+        printf("Sections:\n");
+        print_section("header", 0, sizeof(CTTSHeader), 4);
+        print_section("index", info.index_offset, info.index_bytes, 4);
+        print_section("hash", info.hash_offset, info.hash_bytes, 4);
+        print_section("strings", info.strings_offset, info.strings_bytes, 1);
+        print_section("audio", info.audio_offset, info.audio_bytes, sizeof(int16_t));
+
+        printf("\nUnits by character length:\n");
+        for (int c = 0; c <= CTTS_MAX_UNIT_LEN + 1; c++) {
+            if (info.units_by_chars[c] == 0) continue;
+            printf("  %2d%s %8u (%5.1f%%)\n", c, c > CTTS_MAX_UNIT_LEN ? "+" : " ",
+                   info.units_by_chars[c], 100.0 * info.units_by_chars[c] / info.unit_count);
+        }
+
+        /* A uniform hash with chaining expects 1 + a/2 probes per hit */
+        printf("\nHash table: %u slots, %u used, load factor %.3f\n",
+               info.hash_table_size, info.slots_used, info.load_factor);
+        printf("  Chain length histogram:\n");
+        for (int b = 0; b < CTTS_INFO_CHAIN_BINS; b++) {
+            printf("    %d%s %10u\n", b, b == CTTS_INFO_CHAIN_BINS - 1 ? "+" : " ",
+                   info.chain_histogram[b]);
+        }
+        printf("  Probes per hit:  avg %.3f, max %u (uniform hash: %.3f)\n",
+               info.avg_probes_hit, info.max_probes_hit, 1.0 + info.load_factor / 2.0);
+        printf("  Probes per miss: avg %.3f, max %u (%.1f%% hit an empty slot)\n",
+               info.avg_probes_miss, info.max_probes_miss,
+               100.0 * info.chain_histogram[0] / info.hash_table_size);
+
+        printf("\nAudio: %.1f s total\n", info.total_audio_sec);
+        printf("  Unit duration: min %.1f ms, median %.1f ms, mean %.1f ms, max %.1f ms\n",
+               info.min_unit_ms, info.median_unit_ms, info.mean_unit_ms, info.max_unit_ms);
+        printf("  Edge silence: %.1f%% of unit audio\n", info.edge_silence_ratio * 100.0);
+        printf("  Unreferenced audio: %llu samples\n",
+               (unsigned long long)info.unreferenced_samples);
+        if (info.empty_units || info.broken_units || info.unreachable_units) {
+            printf("  WARNING: %u empty, %u out of bounds, %u unreachable units\n",
+                   info.empty_units, info.broken_units, info.unreachable_units);
+        }
+        return (info.broken_units || info.unreachable_units) ? 1 : 0;
+
+    } else if (strcmp(argv[1], "analyze") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "Usage: %s analyze <database.db> <corpus.txt> [threads] [top_n]\n", argv[0]);
+            return 1;
+        }
+
+        int threads = (argc > 4) ? atoi(argv[4]) : 0;
+        size_t top_n = (argc > 5) ? (size_t)atoi(argv[5]) : 20;
+
+        CTTS* engine = ctts_init(argv[2]);
+        if (!engine) {
+            fprintf(stderr, "Failed to load database: %s\n", argv[2]);
+            return 1;
+        }
+
+        CTTSCoverageReport report;
+        int err = ctts_analyze_corpus(engine, argv[3], threads, &report);
+        if (err != CTTS_OK) {
+            fprintf(stderr, "Analysis failed: %s\n", ctts_strerror(err));
             ctts_free(engine);
             return 1;
         }
 
-        printf("Written to %s\n", argv[4]);
+        uint64_t total_units = report.units_found + report.units_missing;
+        double mb = (double)report.bytes / (1024.0 * 1024.0);
+        printf("Corpus: %.2f MB, %llu sentences, %llu words\n", mb,
+               (unsigned long long)report.sentences, (unsigned long long)report.words);
+        printf("Time: %.2f s (%.1f MB/min)\n", report.elapsed_sec,
+               report.elapsed_sec > 0 ? mb * 60.0 / report.elapsed_sec : 0.0);
+        printf("Units found: %llu, missing: %llu (coverage %.2f%%)\n",
+               (unsigned long long)report.units_found,
+               (unsigned long long)report.units_missing,
+               total_units ? 100.0 * report.units_found / total_units : 100.0);
+        printf("Average units per word: %.2f\n",
+               report.words ? (double)total_units / report.words : 0.0);
+
+        /* Rank units by hit count */
+        uint32_t unit_count = engine->header.unit_count;
+        uint32_t unused = 0;
+        for (uint32_t u = 0; u < unit_count; u++) {
+            if (report.unit_hits[u] == 0) unused++;
+        }
+        printf("Units never selected: %u of %u\n", unused, unit_count);
+
+        printf("\nTop units:\n");
+        uint8_t* shown = calloc(unit_count ? unit_count : 1, 1);
+        for (size_t n = 0; shown && n < top_n && n < unit_count; n++) {
+            uint32_t best = UINT32_MAX;
+            for (uint32_t u = 0; u < unit_count; u++) {
+                if (shown[u] || report.unit_hits[u] == 0) continue;
+                if (best == UINT32_MAX || report.unit_hits[u] > report.unit_hits[best]) best = u;
+            }
+            if (best == UINT32_MAX) break;
+            shown[best] = 1;
+            CTTSIndexEntry* entry = &engine->index[best];
+            printf("  %-12.*s %llu\n", (int)entry->string_len,
+                   engine->strings + entry->string_offset,
+                   (unsigned long long)report.unit_hits[best]);
+        }
+        free(shown);
 
-        ctts_free_samples(samples);
+        printf("\nMissing sequences:\n");
+        for (size_t n = 0; n < report.missing_count && n < top_n; n++) {
+            printf("  %-12s %llu\n", report.missing[n].text,
+                   (unsigned long long)report.missing[n].count);
+        }
+
+        ctts_coverage_report_free(&report);
         ctts_free(engine);
         return 0;
 
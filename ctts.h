@@ -41,6 +41,18 @@ extern "C" {
  * Configuration Structure
  * ============================================================================ */
 
+/* Time-scaling algorithm for speed != 1.0 */
+typedef enum {
+    CTTS_STRETCH_WSOLA = 0,     /* Waveform-similarity search per frame (default) */
+    CTTS_STRETCH_PSOLA = 1      /* Pitch-synchronous; WSOLA only in unvoiced regions */
+} CTTSStretchMode;
+
+/* Interpolation of the pitch contour resampler */
+typedef enum {
+    CTTS_PITCH_LINEAR = 0,      /* Two taps (default) */
+    CTTS_PITCH_CUBIC = 1        /* Four-tap Catmull-Rom, less high-frequency loss */
+} CTTSPitchInterp;
+
 typedef struct {
     /* Audio concatenation */
     float crossfade_ms;         /* Crossfade between syllables */
@@ -67,9 +79,11 @@ typedef struct {
     float default_speed;
     float min_speed;
     float max_speed;
+    int stretch_mode;           /* CTTSStretchMode */
 
     /* Prosody limits */
     float max_pitch_change;     /* Maximum pitch change (0.10 = ±10%) */
+    int pitch_interp;           /* CTTSPitchInterp */
 
     /* Debug */
     int print_units;
@@ -146,6 +160,10 @@ typedef struct {
     /* Statistics */
     uint32_t units_found;       /* Units successfully matched */
     uint32_t units_missing;     /* Units not found (fallback) */
+
+    /* Memory high-water marks of the last ctts_synthesize() call */
+    size_t peak_buffer_bytes;   /* Render buffer capacity */
+    size_t peak_stretch_bytes;  /* Time-stretch output and work buffers */
 } CTTS;
 
 /* Synthesis result */
@@ -180,6 +198,98 @@ int ctts_build_database(
     const char* output_file
 );
 
+/*
+ * Generate a deterministic synthetic dataset for scale testing
+ *
+ * Writes letters/letters.txt, letters/wavs/, syllables/sillabes.txt and
+ * syllables/wavs/ under output_dir. Syllable strings come from a
+ * Portuguese-like onset/nucleus/coda grammar (then two-syllable strings);
+ * each is rendered as harmonic tones with a gliding F0 for vowels and
+ * noise bursts for consonants. The same arguments give the same files.
+ *
+ * Parameters:
+ *   output_dir - Dataset directory (created if missing)
+ *   unit_count - Number of syllable units (letters are always written)
+ *   seed       - Seed for durations, F0 and noise
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ */
+int ctts_make_test_voice(const char* output_dir, size_t unit_count, uint32_t seed);
+
+/* Result of subsetting a database for a domain corpus */
+typedef struct {
+    uint32_t units_before;      /* Units in the source database */
+    uint32_t units_after;       /* Units kept */
+    uint32_t units_selected;    /* Kept because the corpus selects them */
+    uint32_t units_lookahead;   /* Kept because look-ahead consults them */
+    uint32_t units_fallback;    /* Kept as single-character fallbacks */
+    uint64_t bytes_before;      /* Source database size */
+    uint64_t bytes_after;       /* Subset database size */
+    uint64_t sentences_checked; /* Corpus sentences re-selected on the subset */
+    uint64_t selection_mismatches; /* Sentences whose unit sequence changed */
+    uint64_t audio_checked;     /* Sentences synthesized on both databases */
+    uint64_t audio_mismatches;  /* Sentences whose audio changed */
+} CTTSSubsetReport;
+
+/*
+ * Write a smaller database holding only the units a domain corpus needs
+ *
+ * Keeps every unit selected for the corpus, every unit the look-ahead
+ * consults while selecting it (so choices cannot change), and all
+ * single-character units as fallbacks for unseen text. The subset is
+ * then checked: the corpus is re-selected on both databases, and the
+ * first sentences are synthesized on both and compared sample by sample.
+ *
+ * Parameters:
+ *   input_db    - Source database
+ *   corpus_file - Domain text, one sentence per line (UTF-8)
+ *   output_db   - Output database file path
+ *   num_threads - Worker threads for selection (0 = number of online CPUs)
+ *   report      - Output: subset statistics and verification results
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ *   Verification mismatches are reported, not treated as errors
+ */
+int ctts_subset_database(const char* input_db, const char* corpus_file,
+                         const char* output_db, int num_threads,
+                         CTTSSubsetReport* report);
+
+/* Result of flattening unit pitch toward the voice median */
+typedef struct {
+    uint32_t units;             /* Units in the database */
+    uint32_t units_voiced;      /* Units with a measurable median F0 */
+    uint32_t units_shifted;     /* Units rewritten with a pitch shift */
+    uint32_t outside_before;    /* Voiced units outside the tolerance band before */
+    uint32_t outside_after;     /* Voiced units outside it after (measured again) */
+    float voice_f0_hz;          /* Median F0 over the voiced units */
+    float max_shift;            /* Largest pitch change applied (0.10 = 10%) */
+} CTTSFlattenReport;
+
+/*
+ * Write a copy of a database with unit pitch pulled toward the voice median
+ *
+ * Measures each unit's median F0 and the median over all voiced units.
+ * Units whose F0 lies outside [median / (1 + tolerance), median * (1 +
+ * tolerance)] are shifted with TD-PSOLA, keeping their duration, by at most
+ * 25%, toward the point halfway between the median and the nearer edge, so
+ * the re-measured pitch lands inside the band. Unvoiced units and units too
+ * short to measure are copied unchanged. Fewer joins then exceed the 15%
+ * jump that triggers boundary pitch smoothing during synthesis.
+ *
+ * Parameters:
+ *   input_db  - Source database
+ *   output_db - Output database file path
+ *   tolerance - Half-width of the band as a ratio (0.06 = ±6%)
+ *   report    - Output: unit counts and shifts
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ */
+int ctts_flatten_pitch(const char* input_db, const char* output_db, float tolerance,
+                       CTTSFlattenReport* report);
+
 /* ============================================================================
  * Synthesis API
  * ============================================================================ */
@@ -217,6 +327,92 @@ int ctts_synthesize(
     float speed
 );
 
+/* A run of text spoken at its own speed */
+typedef struct {
+    const char* text;           /* UTF-8 */
+    float speed;                /* 0.5 to 2.0, 1.0 = normal */
+} CTTSSpeedSpan;
+
+/*
+ * Synthesize consecutive texts at different speeds as one utterance
+ *
+ * The spans are rendered as one text joined by word pauses, so joins,
+ * pauses and intonation are those of a single ctts_synthesize() call (e.g.
+ * a fast disclaimer followed by slowly read digits). The speed contour is
+ * then applied in one time-stretching pass: around each span boundary the
+ * WSOLA hop slides from one speed to the next over about 100 ms instead of
+ * jumping.
+ *
+ * Parameters:
+ *   engine       - Initialized engine
+ *   spans        - span_count texts with their speed factors, in order
+ *   span_count   - Number of spans
+ *   samples      - Output: allocated sample buffer (caller must free with ctts_free_samples)
+ *   sample_count - Output: number of samples
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ */
+int ctts_synthesize_speeds(CTTS* engine, const CTTSSpeedSpan* spans, size_t span_count,
+                           int16_t** samples, size_t* sample_count);
+
+/*
+ * Synthesize a minimal SSML document in one call
+ *
+ * Supported: <speak>, <break time="500ms|2s" strength="...">, <prosody
+ * rate="x-slow|slow|medium|fast|x-fast|N%|+N%|-N%"> (nestable) and
+ * <say-as interpret-as="digits|characters|date" format="dmy|ymd|mdy|dm|md">.
+ * Rate changes are applied in the same stretching pass as
+ * ctts_synthesize_speeds(), breaks replace the word pause at their
+ * position and keep their length after stretching, and say-as content is
+ * verbalized before the text frontend. Other elements are ignored; their
+ * text is spoken. The entities &amp; &lt; &gt; &quot; &apos; are decoded.
+ * The whole document is rendered before returning; for audio as the markup
+ * arrives, use ctts_session_feed_ssml().
+ *
+ * Parameters:
+ *   engine       - Initialized engine
+ *   ssml         - SSML document or fragment (UTF-8)
+ *   samples      - Output: allocated sample buffer (caller must free with ctts_free_samples)
+ *   sample_count - Output: number of samples
+ *   speed        - Base speed factor; prosody rates multiply it
+ *
+ * Returns:
+ *   0 on success, CTTS_ERR_INVALID_FORMAT for an unterminated tag or
+ *   say-as, other negative error codes on failure
+ */
+int ctts_synthesize_ssml(CTTS* engine, const char* ssml, int16_t** samples,
+                         size_t* sample_count, float speed);
+
+/* One text of a batch */
+typedef struct {
+    int16_t* samples;           /* Output, free with ctts_free_samples() (NULL on error) */
+    size_t sample_count;
+    int status;                 /* 0 or negative error code for this text */
+} CTTSBatchItem;
+
+/*
+ * Synthesize many texts, one pipeline stage at a time across the batch
+ *
+ * All texts go through the text frontend first, then unit selection and
+ * concatenation, then time stretching, where identical voiced pieces across
+ * the batch are stretched once. Output is identical to calling ctts_synthesize() on
+ * each text; the batch saves per-call setup and keeps each stage's tables
+ * and code hot for many short prompts.
+ *
+ * Parameters:
+ *   engine  - Initialized engine
+ *   texts   - count input texts (UTF-8)
+ *   count   - Number of texts
+ *   speed   - Speed factor for all texts (0.5 to 2.0, 1.0 = normal)
+ *   results - Output: count items, filled in order
+ *
+ * Returns:
+ *   0 if every text was synthesized, else the first per-text error code
+ */
+int ctts_synthesize_batch(CTTS* engine, const char* const* texts, size_t count,
+                          float speed, CTTSBatchItem* results);
+
 /*
  * Write samples to WAV file
  *
@@ -236,6 +432,353 @@ int ctts_write_wav(
     int sample_rate
 );
 
+/* ============================================================================
+ * Scatter-Gather Output API
+ * ============================================================================ */
+
+/* Piece of output audio, like struct iovec but counted in samples */
+typedef struct {
+    const int16_t* samples;
+    size_t sample_count;
+} CTTSSpan;
+
+/* Output as a list of spans, in playback order */
+typedef struct {
+    CTTSSpan* spans;
+    size_t span_count;
+    size_t sample_count;        /* Total over all spans */
+    size_t referenced_samples;  /* Pointing into the mapped database */
+    size_t owned_samples;       /* Computed here: crossfades and fades */
+    size_t silence_samples;     /* Pointing at a shared block of zeros */
+    void* owned;                /* Storage behind the owned spans */
+} CTTSSpanList;
+
+/*
+ * Synthesize text at speed 1.0 without per-unit DSP, as a list of spans
+ *
+ * Units are joined with the configured crossfades, fades and pauses only:
+ * no RMS normalization, boundary pitch/energy smoothing, word-silence
+ * removal, DC removal or intonation. Untouched unit audio is referenced in
+ * the mapped database instead of copied, so the list stays valid only
+ * while the engine is alive. Emit it with writev() or any streaming sink.
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ *   Caller must free the list with ctts_free_spans()
+ */
+int ctts_synthesize_spans(CTTS* engine, const char* text, CTTSSpanList* spans);
+
+/*
+ * Write a span list to fd as a complete WAV file with writev(), no copying
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ */
+int ctts_write_wav_spans(int fd, const CTTSSpanList* spans, int sample_rate);
+
+/*
+ * Free a span list (the database audio it references is not touched)
+ */
+void ctts_free_spans(CTTSSpanList* spans);
+
+/* ============================================================================
+ * Memfd Audio Handoff API (Linux)
+ * ============================================================================ */
+
+/* Size of the WAV header written by ctts_write_wav and ctts_synthesize_to_memfd */
+#define CTTS_WAV_HEADER_SIZE 44
+
+/*
+ * Synthesize text into a sealed memfd holding a complete WAV file
+ *
+ * The file is sealed against writes, growth and shrinking before it is
+ * returned, so any process holding the fd can mmap it read-only and trust
+ * its contents. PCM samples start at CTTS_WAV_HEADER_SIZE. The same fd may
+ * be passed to many consumers (see ctts_send_fd) without copying the audio.
+ *
+ * Parameters:
+ *   engine       - Initialized engine
+ *   text         - Input text (UTF-8)
+ *   speed        - Speed factor (0.5 to 2.0, 1.0 = normal)
+ *   fd           - Output: sealed memfd, caller must close()
+ *   sample_count - Output: number of samples (may be NULL)
+ *
+ * Returns:
+ *   0 on success, CTTS_ERR_UNSUPPORTED where memfd sealing is unavailable
+ */
+int ctts_synthesize_to_memfd(
+    CTTS* engine,
+    const char* text,
+    float speed,
+    int* fd,
+    size_t* sample_count
+);
+
+/*
+ * Send a file descriptor over a connected Unix domain socket (SCM_RIGHTS)
+ * together with len bytes of data. fd may be -1 to send data only.
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int ctts_send_fd(int socket_fd, int fd, const void* data, size_t len);
+
+/*
+ * Receive exactly len bytes of data and an optional file descriptor sent
+ * with ctts_send_fd. *fd is -1 if no descriptor was attached.
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int ctts_recv_fd(int socket_fd, int* fd, void* data, size_t len);
+
+/*
+ * Map a received audio memfd read-only after checking that it is sealed
+ * against writes, growth and shrinking and that it holds a WAV header plus
+ * sample_count samples. Samples start at *map + CTTS_WAV_HEADER_SIZE;
+ * release with munmap(*map, *size). The fd may be closed once mapped.
+ *
+ * Returns: 0 on success, CTTS_ERR_INVALID_FORMAT for an unsealed or short
+ *          file, negative error code on other failures
+ */
+int ctts_map_memfd(int fd, uint64_t sample_count, const uint8_t** map, size_t* size);
+
+/*
+ * Reply sent by "ctts serve-memfd" for each request line, with the sealed
+ * memfd attached when status is CTTS_OK
+ */
+typedef struct {
+    int32_t status;
+    uint32_t sample_rate;
+    uint64_t sample_count;
+} CTTSMemfdReply;
+
+/* ============================================================================
+ * Memory Accounting API
+ * ============================================================================ */
+
+/* Where an engine's memory goes (bytes unless noted) */
+typedef struct {
+    /* Voice database: mapped vs resident pages (mincore, Linux) */
+    size_t db_mapped_bytes;
+    size_t db_resident_bytes;
+    size_t index_mapped_bytes;      /* Header, index and hash table */
+    size_t index_resident_bytes;
+    size_t strings_mapped_bytes;
+    size_t strings_resident_bytes;
+    size_t audio_mapped_bytes;
+    size_t audio_resident_bytes;
+
+    /* Text frontend (process-wide) */
+    size_t regex_rule_count;
+    size_t regex_bytes;             /* Rule table + compiled regex heap (glibc >= 2.33) */
+    size_t lexicon_entries;
+    size_t lexicon_bytes;
+    size_t number_cache_bytes;      /* Precomputed number words, 0 until first use */
+
+    /* Static tables and diagnostics (process-wide) */
+    size_t lut_bytes;               /* Fade, window and duration tables */
+    size_t flight_recorder_bytes;
+
+    /* Engine and scratch of its last ctts_synthesize() call */
+    size_t engine_bytes;
+    size_t request_buffer_peak_bytes;   /* Render buffer capacity */
+    size_t request_stretch_peak_bytes;  /* Time-stretch output and work buffers */
+} CTTSMemoryReport;
+
+/*
+ * Fill report with the current memory breakdown of engine
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int ctts_memory_report(const CTTS* engine, CTTSMemoryReport* report);
+
+/* ============================================================================
+ * Database Inspection API
+ * ============================================================================ */
+
+#define CTTS_INFO_CHAIN_BINS 8      /* Chain lengths 0..6, and 7 or more */
+
+/* Shape and lookup cost of a loaded database */
+typedef struct {
+    /* Sections (byte offsets and sizes) */
+    size_t file_bytes;
+    size_t index_offset, index_bytes;
+    size_t hash_offset, hash_bytes;
+    size_t strings_offset, strings_bytes;
+    size_t audio_offset, audio_bytes;
+
+    /* Units */
+    uint32_t unit_count;
+    uint32_t units_by_chars[CTTS_MAX_UNIT_LEN + 2];  /* By character count; last = longer */
+    uint32_t broken_units;          /* Text or audio outside its section */
+    uint32_t unreachable_units;     /* Not found through the hash table */
+
+    /* Hash table (probes = index entries visited) */
+    uint32_t hash_table_size;
+    uint32_t slots_used;
+    double load_factor;             /* Units per slot */
+    uint32_t chain_histogram[CTTS_INFO_CHAIN_BINS];  /* Slots by next_hash chain length */
+    uint32_t max_chain;
+    double avg_probes_hit;          /* Looking up each unit once */
+    uint32_t max_probes_hit;
+    double avg_probes_miss;         /* Absent text, uniformly hashed */
+    uint32_t max_probes_miss;
+
+    /* Audio */
+    double total_audio_sec;
+    double min_unit_ms, mean_unit_ms, median_unit_ms, max_unit_ms;
+    uint32_t empty_units;
+    double edge_silence_ratio;      /* Unit audio that is leading/trailing silence */
+    uint64_t unreferenced_samples;  /* Audio not covered by any unit */
+} CTTSDatabaseInfo;
+
+/*
+ * Inspect the layout, hash distribution and audio of a loaded database
+ *
+ * Returns: 0 on success, CTTS_ERR_INVALID_FORMAT if sections are out of bounds
+ */
+int ctts_database_info(const CTTS* engine, CTTSDatabaseInfo* info);
+
+/* ============================================================================
+ * Slow-Request Flight Recorder API
+ * ============================================================================ */
+
+#define CTTS_FLIGHT_TEXT_MAX 160    /* Bytes of input text kept per record */
+
+/* Synthesis stages timed for each request */
+typedef enum {
+    CTTS_STAGE_NORMALIZE,       /* Numbers, lexicon, rules, lowercase */
+    CTTS_STAGE_PROSODY,         /* Prosody analysis */
+    CTTS_STAGE_RENDER,          /* Unit selection and concatenation */
+    CTTS_STAGE_FINISH,          /* Last word and final fade */
+    CTTS_STAGE_STRETCH,         /* Time stretching (0 at speed 1.0) */
+    CTTS_STAGE_COUNT
+} CTTSStage;
+
+/* One slow request */
+typedef struct {
+    uint64_t sequence;          /* Order in which requests were recorded */
+    int64_t timestamp;          /* Wall-clock time (seconds since epoch) */
+    double total_ms;            /* Total synthesis time */
+    float stage_ms[CTTS_STAGE_COUNT];
+    float speed;
+    uint32_t config_fingerprint;  /* Hash of the engine configuration */
+    uint32_t unit_count;        /* Units found + missing */
+    uint64_t output_samples;
+    uint32_t text_len;          /* Full input length in bytes */
+    char text[CTTS_FLIGHT_TEXT_MAX];  /* Truncated input, control chars blanked */
+} CTTSFlightRecord;
+
+/*
+ * Record every ctts_synthesize() call slower than threshold_ms in a ring of
+ * the last `capacity` such requests. Recording is lock-free; requests under
+ * the threshold are not recorded. The ring is allocated on the first call and
+ * kept for the life of the process; later calls only change the threshold.
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int ctts_flight_recorder_enable(size_t capacity, double threshold_ms);
+
+/*
+ * Stop recording (records already captured are kept)
+ */
+void ctts_flight_recorder_disable(void);
+
+/*
+ * Copy up to max_records recorded requests, oldest first
+ *
+ * Returns: number of records copied
+ */
+size_t ctts_flight_recorder_snapshot(CTTSFlightRecord* records, size_t max_records);
+
+/*
+ * Write recorded requests to fd, one "key=value" line per request.
+ * Async-signal-safe.
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int ctts_flight_recorder_dump(int fd);
+
+/*
+ * Append a dump to path whenever the process receives SIGUSR1
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int ctts_flight_recorder_install_signal(const char* path);
+
+/* ============================================================================
+ * Load-Adaptive Quality API
+ * ============================================================================ */
+
+/* Quality levels in the order they are given up; each keeps the savings above it */
+typedef enum {
+    CTTS_QUALITY_FULL,                  /* Every stage */
+    CTTS_QUALITY_NO_BOUNDARY_SMOOTHING, /* No pitch smoothing at unit joins */
+    CTTS_QUALITY_COARSE_WSOLA,          /* WSOLA skips the fine alignment search */
+    CTTS_QUALITY_SIMPLE_INTONATION,     /* Pitch contour only on a phrase's last two words */
+    CTTS_QUALITY_LEVELS
+} CTTSQualityLevel;
+
+#define CTTS_LOAD_EVENTS 16         /* Level changes kept in CTTSLoadStats */
+
+/* One change of quality level */
+typedef struct {
+    uint64_t request;           /* Requests completed when the level changed */
+    int64_t timestamp;          /* Wall-clock time (seconds since epoch) */
+    int from_level;
+    int to_level;
+    double predicted_ms;        /* Latency estimate that triggered the change */
+    uint32_t queue_depth;       /* Requests waiting at the time */
+} CTTSQualityEvent;
+
+typedef struct {
+    int enabled;
+    int level;                  /* Current CTTSQualityLevel */
+    double target_ms;           /* Latency target */
+    double avg_latency_ms;      /* Moving average of ctts_synthesize() time */
+    double avg_rtf;             /* Moving average of synthesis time / audio time */
+    uint32_t queue_depth;       /* Requests waiting outside the engine */
+    uint32_t in_flight;         /* Concurrent ctts_synthesize() calls */
+    uint64_t requests;          /* Requests observed since enabled */
+    uint64_t requests_at_level[CTTS_QUALITY_LEVELS];
+    uint64_t step_downs;
+    uint64_t step_ups;
+    size_t event_count;         /* Valid entries in events, oldest first */
+    CTTSQualityEvent events[CTTS_LOAD_EVENTS];
+} CTTSLoadStats;
+
+/*
+ * Hold a latency target by trading quality for speed under load
+ *
+ * Every ctts_synthesize() call updates moving averages of its latency and
+ * real-time factor. Concurrent calls show up in that latency; requests queued
+ * outside the engine add one average latency each. When this estimate for
+ * the next request exceeds target_ms, rendering steps down one
+ * CTTSQualityLevel; once the estimate stays well under the target it steps
+ * back up. Steps are spaced a few requests apart so each can take effect.
+ * The level applies to every engine in the process, including sessions and
+ * templates.
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int ctts_load_control_enable(double target_ms);
+
+/*
+ * Stop adapting and return to full quality (statistics are kept)
+ */
+void ctts_load_control_disable(void);
+
+/*
+ * Report requests waiting outside the engine (e.g. a server's accept queue)
+ */
+void ctts_load_control_set_queue_depth(uint32_t depth);
+
+/*
+ * Copy the current load statistics and recent level changes
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int ctts_load_control_stats(CTTSLoadStats* stats);
+
 /*
  * Free engine resources
  */
@@ -246,6 +789,249 @@ void ctts_free(CTTS* engine);
  */
 void ctts_free_samples(int16_t* samples);
 
+/* ============================================================================
+ * Prompt Template API
+ * ============================================================================ */
+
+/* Compiled prompt template (opaque) */
+typedef struct CTTSTemplate CTTSTemplate;
+
+/*
+ * Compile a prompt template such as "Seu saldo é de {} reais"
+ *
+ * Each "{...}" marks a slot. The static text around the slots is rendered
+ * once, with the prosody of the whole prompt, and cached at the given speed.
+ *
+ * Parameters:
+ *   engine  - Initialized engine (must outlive the template)
+ *   pattern - Template text (UTF-8)
+ *   speed   - Speed factor (0.5 to 2.0, 1.0 = normal)
+ *
+ * Returns:
+ *   Compiled template on success, NULL on failure
+ */
+CTTSTemplate* ctts_template_compile(CTTS* engine, const char* pattern, float speed);
+
+/*
+ * Render a compiled template
+ *
+ * Only the slot values are synthesized; they are stitched to the cached
+ * static audio with word pauses, or crossfaded when a slot joins mid-word.
+ *
+ * Parameters:
+ *   tpl          - Compiled template
+ *   args         - One text value per slot, in order
+ *   arg_count    - Number of values (must equal the slot count)
+ *   samples      - Output: pointer to allocated sample buffer
+ *   sample_count - Output: number of samples
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ *   Caller must free *samples with ctts_free_samples()
+ */
+int ctts_template_render(CTTSTemplate* tpl, const char* const* args, size_t arg_count,
+                         int16_t** samples, size_t* sample_count);
+
+/*
+ * Get number of slots in a compiled template
+ */
+size_t ctts_template_slot_count(const CTTSTemplate* tpl);
+
+/*
+ * Free a compiled template
+ */
+void ctts_template_free(CTTSTemplate* tpl);
+
+/* ============================================================================
+ * Incremental Input API
+ * ============================================================================ */
+
+/* Streaming input session (opaque) */
+typedef struct CTTSSession CTTSSession;
+
+/* Receives audio as soon as it is final; samples are valid only during the call */
+typedef void (*CTTSAudioCallback)(const int16_t* samples, size_t sample_count,
+                                  void* user_data);
+
+/*
+ * Receives a run of sample_count silent samples in place of zeros. Word and
+ * punctuation pauses are carried as lengths through time stretching, so a
+ * consumer can send nothing (DTX), write a hole or fill zeros cheaply.
+ */
+typedef void (*CTTSSilenceCallback)(size_t sample_count, void* user_data);
+
+/*
+ * Start a session for text that arrives a few tokens at a time
+ *
+ * Parameters:
+ *   engine    - Initialized engine (must outlive the session)
+ *   speed     - Speed factor (0.5 to 2.0, 1.0 = normal)
+ *   callback  - Audio sink, called from ctts_session_feed/ctts_session_end
+ *   user_data - Passed to callback
+ *
+ * Returns:
+ *   Session on success, NULL on failure
+ */
+CTTSSession* ctts_session_begin(CTTS* engine, float speed,
+                                CTTSAudioCallback callback, void* user_data);
+
+/*
+ * Deliver pauses to a silence callback instead of the audio callback
+ *
+ * Without one, silence reaches the audio callback as zero samples. The
+ * session's user_data is passed to both callbacks; NULL restores the default.
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ */
+int ctts_session_set_silence_callback(CTTSSession* session, CTTSSilenceCallback callback);
+
+/*
+ * Append text to the session
+ *
+ * Words (and numbers) are synthesized once they are followed by whitespace.
+ * The most recent word is held back until the next one completes, for unit
+ * look-ahead and final-word intonation, unless it closes a clause
+ * (, ; : . ! ?). Intonation is planned per clause: words of an open clause
+ * get a neutral contour, and the clause type and length are applied to the
+ * words still pending when its punctuation arrives. Intonation and unit
+ * look-ahead therefore depend on how the text arrives: the same text fed
+ * in one chunk or a byte at a time gives the same words with a different
+ * contour, and the output is only deterministic for the same chunking.
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ */
+int ctts_session_feed(CTTSSession* session, const char* chunk);
+
+/*
+ * Append SSML to the session (the subset of ctts_synthesize_ssml())
+ *
+ * Chunks may split tags anywhere; an element acts once it is complete, and
+ * its text is fed like ctts_session_feed() input. A prosody rate change
+ * renders the text before it, closes that word with a word pause and hands
+ * it to the callback at the old speed; later words use the new speed (the
+ * session speed times the rate). A break ends the current word and is
+ * delivered as exactly its length of silence, unstretched. As with
+ * ctts_session_feed(), intonation depends on how the text arrives. Use
+ * either this or ctts_session_feed() for a session, not both.
+ *
+ * Returns:
+ *   0 on success, negative error code on failure (CTTS_ERR_INVALID_FORMAT
+ *   for markup left unterminated is reported by ctts_session_end)
+ */
+int ctts_session_feed_ssml(CTTSSession* session, const char* chunk);
+
+/*
+ * Synthesize any remaining text, apply the final fade-out and free the session
+ *
+ * Returns:
+ *   0 on success, negative error code on failure (the session is freed either way)
+ */
+int ctts_session_end(CTTSSession* session);
+
+/* ============================================================================
+ * Corpus Analysis API
+ * ============================================================================ */
+
+/* Character sequence with no matching unit */
+typedef struct {
+    char* text;                 /* Normalized text (UTF-8) */
+    uint64_t count;             /* Occurrences in corpus */
+} CTTSMissingSequence;
+
+/* Coverage report for a text corpus */
+typedef struct {
+    uint64_t bytes;             /* Corpus size in bytes */
+    uint64_t sentences;         /* Non-empty lines processed */
+    uint64_t words;             /* Words with at least one unit or miss */
+    uint64_t units_found;       /* Units selected */
+    uint64_t units_missing;     /* Characters without a unit */
+    uint64_t* unit_hits;        /* Selections per unit index (unit_count entries) */
+    CTTSMissingSequence* missing; /* Missing sequences, most frequent first */
+    size_t missing_count;
+    double elapsed_sec;         /* Wall-clock analysis time */
+} CTTSCoverageReport;
+
+/*
+ * Run the text frontend and unit selection over a corpus (no audio)
+ *
+ * Parameters:
+ *   engine      - Initialized engine
+ *   corpus_file - Text file, one sentence per line (UTF-8)
+ *   num_threads - Worker threads (0 = number of online CPUs)
+ *   report      - Output: coverage report
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ *   Caller must free the report with ctts_coverage_report_free()
+ */
+int ctts_analyze_corpus(CTTS* engine, const char* corpus_file, int num_threads,
+                        CTTSCoverageReport* report);
+
+/*
+ * Free coverage report contents
+ */
+void ctts_coverage_report_free(CTTSCoverageReport* report);
+
+/* ============================================================================
+ * Cache Warming API
+ * ============================================================================ */
+
+/* Receives each warmed text with its log count and rendered audio */
+typedef void (*CTTSWarmCallback)(const char* text, uint64_t count,
+                                 const int16_t* samples, size_t sample_count,
+                                 void* user_data);
+
+typedef struct {
+    size_t top_k;               /* Most frequent texts to replay (0 = 100) */
+    int num_threads;            /* Worker threads (0 = number of online CPUs) */
+    float speed;                /* Speed to render at (0 = 1.0) */
+    double time_budget_ms;      /* Stop starting new texts after this (0 = none) */
+    size_t memory_budget_bytes; /* Stop once warmed DB pages + delivered audio reach this (0 = none) */
+    CTTSWarmCallback callback;  /* Optional; calls are serialized */
+    void* user_data;
+} CTTSWarmOptions;
+
+#define CTTS_WARM_BUDGET_TIME   1
+#define CTTS_WARM_BUDGET_MEMORY 2
+
+typedef struct {
+    uint64_t log_requests;      /* Texts read from the log */
+    uint64_t distinct_texts;
+    uint64_t texts_warmed;      /* Replayed through the full pipeline */
+    uint64_t requests_covered;  /* Log requests whose text was warmed */
+    uint32_t units_touched;     /* Distinct units selected while warming */
+    uint32_t unit_count;
+    size_t memory_used;         /* Lookup sections + unit audio + delivered audio */
+    size_t db_resident_before;  /* Database bytes resident (mincore) */
+    size_t db_resident_after;
+    int budget_exhausted;       /* 0, CTTS_WARM_BUDGET_TIME or CTTS_WARM_BUDGET_MEMORY */
+    double elapsed_sec;
+} CTTSWarmReport;
+
+/*
+ * Replay the most frequent texts of a request log before serving traffic
+ *
+ * Lines are plain texts (one request per line) or flight recorder dump
+ * lines, whose text="..." field is used; lines starting with '#' are
+ * skipped. The top texts are synthesized on worker threads, which loads
+ * the frontend tables and faults in the database pages they need, and
+ * each result is passed to the callback (for example to fill a prompt
+ * cache). Call from a background thread to warm while serving.
+ *
+ * Parameters:
+ *   engine   - Initialized engine (its statistics are not modified)
+ *   log_file - Request log
+ *   options  - Limits and callback (NULL for defaults)
+ *   report   - Output: coverage of the log and memory warmed
+ *
+ * Returns:
+ *   0 on success, negative error code on failure
+ */
+int ctts_warm_from_log(CTTS* engine, const char* log_file,
+                       const CTTSWarmOptions* options, CTTSWarmReport* report);
+
 /* ============================================================================
  * Configuration API
  * ============================================================================ */
@@ -322,7 +1108,23 @@ int ctts_load_normalization(const char* csv_file);
 char* ctts_apply_normalization(const char* text);
 
 /*
- * Free normalization rules
+ * Load a pronunciation lexicon from CSV and merge it into the current one
+ * Format: word,replacement (one per line, # comments). Words are matched
+ * whole and case-insensitively; a trailing '.' is part of the word, which
+ * is how abbreviations like "dr." are written. Later entries override
+ * earlier ones. Lookup is one hash probe per token, independent of size.
+ * Literal rules in the normalization CSV (\bword\b, \bword\.) are moved
+ * into the lexicon automatically.
+ *
+ * lexicon.csv in the working directory is loaded on first synthesis
+ * unless a lexicon was already loaded.
+ *
+ * Returns: CTTS_OK on success, CTTS_ERR_FILE_NOT_FOUND if the file is missing
+ */
+int ctts_load_lexicon(const char* csv_file);
+
+/*
+ * Free normalization rules and the lexicon
  */
 void ctts_free_normalization(void);
 
@@ -339,6 +1141,7 @@ void ctts_free_normalization(void);
 #define CTTS_ERR_OUT_OF_MEMORY  -6
 #define CTTS_ERR_INVALID_WAV    -7
 #define CTTS_ERR_VERSION        -8
+#define CTTS_ERR_UNSUPPORTED    -9
 
 /*
  * Get error message for error code